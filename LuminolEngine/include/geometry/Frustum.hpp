@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace Geometry{
+
+    /**
+     * The six planes of a view frustum, extracted from a view projection matrix (Gribb & Hartmann).
+     * Each plane is stored as (normal, distance) with a unit normal pointing inside the frustum:
+     * a point p is inside the half space when dot(normal, p) + distance >= 0.
+     */
+    struct Frustum{
+        enum Plane{ LEFT_PLANE, RIGHT_PLANE, BOTTOM_PLANE, TOP_PLANE, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+        glm::vec4 planes[PLANE_COUNT];
+
+        Frustum(const glm::mat4& VP);
+
+        /** True if the axis aligned box given by its center and half size intersects the frustum */
+        bool intersects(const glm::vec3& center, const glm::vec3& extent) const;
+
+        /** True if the axis aligned box is entirely inside the frustum */
+        bool contains(const glm::vec3& center, const glm::vec3& extent) const;
+    };
+}
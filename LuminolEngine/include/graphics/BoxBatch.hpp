@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "graphics/VertexArrayObject.h"
+#include "graphics/VertexBufferObject.h"
+#include "graphics/ShaderProgram.hpp"
+#include "graphics/RenderQueue.hpp"
+#include "geometry/BoundingBox.h"
+
+namespace Graphics{
+
+    /**
+     * Wireframe boxes drawn with a single instanced call.
+     * The unit cube lines are stored once; each box only adds its center, half extent and color to the instance buffers.
+     * Meant to be used with shaders/box.vert and shaders/box.frag.
+     */
+    class BoxBatch{
+        VertexArrayObject _VAO;
+        VertexBufferObject _cubeVBO;
+        VertexBufferObject _cubeIdsVBO;
+        VertexBufferObject _centersVBO;
+        VertexBufferObject _extentsVBO;
+        VertexBufferObject _colorsVBO;
+
+        std::vector<glm::vec3> _centers;
+        std::vector<glm::vec3> _extents;
+        std::vector<glm::vec3> _colors;
+
+        /** False when boxes were added or removed since the last upload */
+        bool _isUploaded;
+
+    public:
+        BoxBatch();
+
+        BoxBatch(const BoxBatch&) = delete;
+        BoxBatch& operator=(const BoxBatch&) = delete;
+
+        /** Add an axis aligned box given its center and half size */
+        void add(const glm::vec3& center, const glm::vec3& extent, const glm::vec3& color = glm::vec3(1));
+
+        /** Add the axis aligned box enclosing a (possibly transformed) bounding box */
+        void add(const Geometry::BoundingBox& box, const glm::vec3& color = glm::vec3(1));
+
+        void clear();
+        size_t size() const;
+
+        /**
+         * Upload the boxes if they changed since the last submit, then queue them as a single debug pass packet.
+         * The MVP uniform of program must already be set. Must be called on the GL thread, and the batch must live until the queue is executed.
+         */
+        void submit(RenderQueue& queue, const ShaderProgram& program, uint8_t state = RENDER_DEPTH_TEST);
+    };
+}
@@ -9,6 +9,7 @@
 #include "graphics/VertexBufferObject.h"
 #include "graphics/VertexArrayObject.h"
 #include "graphics/ShaderProgram.hpp"
+#include "graphics/RenderQueue.hpp"
 #include "geometry/Transformation.h"
 
 namespace Graphics
@@ -16,20 +17,60 @@ namespace Graphics
     class DebugDrawer {
         /**
          * Small helper class for scene debugging.
+         * Draw calls only record primitives: they are grouped by program, primitive type, color and line width / point size,
+         * then submit() uploads every vertex at once and adds one packet per group to a RenderQueue.
          */
+        struct Batch {
+            ShaderProgram* program;
+            GLenum primitive;
+            glm::vec3 color;
+            float size;
+            std::vector<glm::vec3> vertices;
+        };
+
+        /** State of a submitted batch, read when its packet is executed */
+        struct SubmittedBatch {
+            ShaderProgram* program;
+            GLenum primitive;
+            glm::vec3 color;
+            float size;
+        };
+
         VertexArrayObject _VAO;
         VertexBufferObject _verticesVBO;
-        VertexBufferObject _indexesVBO;
         VertexBufferObject _transformVBO;
         std::vector<glm::vec3> _points;
+        std::vector<Batch> _batches;
+        size_t _lastBatch;
+        std::vector<SubmittedBatch> _submitted;
+        RenderQueue _queue;
 
-        static DebugDrawer _drawer;
+        /**
+         * The drawer is built on first use: as a function local static it is destroyed before GLState::global(),
+         * whose storage is constant initialized, so its buffers can still forget themselves there
+         */
+        static DebugDrawer& drawer();
 
         static bool _isInit;
         static void init();
 
+        /** Vertices of the batch matching the given state, created if needed */
+        static std::vector<glm::vec3>& batch(ShaderProgram &program, GLenum primitive, const glm::vec3 &color, float size);
+
+        /** Color and line width / point size of the packet */
+        static void setupBatch(void* submitted);
+
         DebugDrawer();
     public:
+        /**
+         * Add every primitive recorded since the last submit to queue, in the RENDER_PASS_DEBUG pass.
+         * The packets are valid until the next submit. Uniforms like MVP are read from the programs when the queue is executed
+         */
+        static void submit(RenderQueue& queue);
+
+        /** Submit to a queue of the drawer and execute it right away */
+        static void flush();
+
         static void drawRay(const glm::vec3 &point1, const glm::vec3 &point2, ShaderProgram &program, const glm::vec3 &color = glm::vec3(1, 1, 1), float lineWidth = 1);
         static void drawTriangle(const glm::vec3 &point1, const glm::vec3 &point2, const glm::vec3 &point3, ShaderProgram &program, const glm::vec3 &color = glm::vec3(1, 1, 1));
         static void drawPyramid(const glm::mat4 &trans, ShaderProgram &program, float scale = 1, const glm::vec3 &color = glm::vec3(1, 1, 1));
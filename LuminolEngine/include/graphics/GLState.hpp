@@ -0,0 +1,120 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace Graphics{
+
+    /**
+     * Shadow of the GL bindings and enable bits, skipping the calls that would not change anything.
+     * Only holds if every change goes through it: after code calling GL directly (AntTweakBar's TwDraw, another library),
+     * call invalidate() so that the next calls are issued again. Objects must be forgotten when deleted,
+     * or a new object reusing the name would be taken as already bound.
+     * The element array binding belongs to the VAO: it is forgotten whenever the VAO changes.
+     * Calls issued and skipped are counted per frame, see endFrame().
+     */
+    class GLState{
+    public:
+        struct Counters{
+            uint32_t issued;
+            uint32_t skipped;
+        };
+
+        /** Texture units whose bindings are shadowed, the others are always issued */
+        static const int MAX_TEXTURE_UNITS = 32;
+
+    private:
+        enum BufferTarget{
+            ARRAY_BUFFER_TARGET,
+            ELEMENT_ARRAY_BUFFER_TARGET,
+            UNIFORM_BUFFER_TARGET,
+            COPY_WRITE_BUFFER_TARGET,
+            PIXEL_UNPACK_BUFFER_TARGET,
+            BUFFER_TARGET_COUNT
+        };
+
+        enum TextureTarget{
+            TEXTURE_2D_TARGET,
+            TEXTURE_2D_ARRAY_TARGET,
+            TEXTURE_CUBE_MAP_TARGET,
+            TEXTURE_TARGET_COUNT
+        };
+
+        GLuint _program;
+        GLuint _vertexArray;
+        GLuint _buffers[BUFFER_TARGET_COUNT];
+        GLenum _activeTexture;
+        GLuint _textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+        GLenum _polygonMode;
+        std::unordered_map<GLenum, bool> _capabilities;
+
+        Counters _counters;
+        Counters _lastFrameCounters;
+
+        static std::unique_ptr<GLState> _global;
+
+        static int bufferTarget(GLenum target);
+        static int textureTarget(GLenum target);
+
+        /** Count the call and tell whether it must be issued */
+        bool change(GLuint& shadow, GLuint value);
+
+    public:
+        /** Name of no object, shadowing a binding that is not known */
+        static const GLuint UNKNOWN = ~GLuint(0);
+
+        GLState();
+
+        GLState(const GLState&) = delete;
+        GLState& operator=(const GLState&) = delete;
+
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint vertexArray);
+        void bindBuffer(GLenum target, GLuint buffer);
+        /** Always issued: indexed bindings are not shadowed, but they also bind the generic target */
+        void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+        void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+        void activeTexture(GLenum textureUnit);
+        /** Bind on the active texture unit */
+        void bindTexture(GLenum target, GLuint texture);
+        /** Bind on textureUnit (GL_TEXTURE0, ...), changing the active unit only if needed */
+        void bindTexture(GLenum textureUnit, GLenum target, GLuint texture);
+        void enable(GLenum capability);
+        void disable(GLenum capability);
+        void setEnabled(GLenum capability, bool isEnabled);
+        /** For GL_FRONT_AND_BACK */
+        void polygonMode(GLenum mode);
+
+        /** To call right before deleting GL objects still possibly bound */
+        void forgetProgram(GLuint program);
+        void forgetVertexArray(GLuint vertexArray);
+        void forgetBuffer(GLuint buffer);
+        void forgetTexture(GLuint texture);
+
+        /** Forget everything: the state was changed behind our back */
+        void invalidate();
+
+        /** Calls of the current frame */
+        const Counters& counters() const;
+        /** Calls of the last frame ended by endFrame() */
+        const Counters& lastFrameCounters() const;
+        void endFrame();
+
+        /** State of the GL context of the application, created on first use */
+        static GLState& global();
+
+        /**
+         * The global state if it was ever used, nullptr otherwise.
+         * For the destructors of GL objects, which must not create a state once the context may be gone
+         */
+        static GLState* existingGlobal();
+
+        /** endFrame() on the global state if it was ever used */
+        static void endGlobalFrame();
+
+        /** Destroy the global state, once the GL objects that forget themselves there are gone */
+        static void releaseGlobal();
+    };
+}
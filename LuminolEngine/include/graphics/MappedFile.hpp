@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+
+namespace Graphics{
+
+    const uint64_t HASH_BYTES_SEED = 14695981039346656037ULL;
+    const uint64_t HASH_BYTES_PRIME = 1099511628211ULL;
+
+    /** 64 bits FNV-1a of size bytes. Pass the previous result as hash to chain several ranges */
+    uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_BYTES_SEED);
+
+    /** Part of a file content, see writeFileAtomically */
+    struct FileRange{
+        const void* data;
+        size_t size;
+    };
+
+    /**
+     * Write the ranges one after another to a temporary file, then rename it to path:
+     * a reader never maps a partial file. The temporary name is unique per process and thread,
+     * so that concurrent writers of the same path do not mix their content. Returns false on failure.
+     */
+    bool writeFileAtomically(const std::string& path, std::initializer_list<FileRange> ranges);
+
+    /** Size and last modification time of a file, used to tell whether a cache derived from it is still valid */
+    struct FileStamp{
+        uint64_t size;
+        int64_t modificationTime;
+
+        FileStamp(): size(0), modificationTime(0) {}
+
+        bool operator==(const FileStamp& other) const { return size == other.size && modificationTime == other.modificationTime; }
+        bool operator!=(const FileStamp& other) const { return !(*this == other); }
+
+        /** Fill stamp with the current state of path. Returns false if the file does not exist */
+        static bool get(const std::string& path, FileStamp& stamp);
+    };
+
+    /**
+     * Read-only view of a whole file.
+     * The file is memory mapped where the platform allows it, so pages are only read when touched and never copied.
+     * Elsewhere it is read in a buffer owned by the object.
+     */
+    class MappedFile{
+        const char* _data;
+        size_t _size;
+        bool _isOpen;
+#if defined(_WIN32)
+        std::vector<char> _buffer;
+#endif
+
+    public:
+        MappedFile();
+        /** Throws std::runtime_error if the file can't be opened */
+        explicit MappedFile(const std::string& path);
+        MappedFile(MappedFile&& other);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /** Map path, closing the current file first. Returns false if it can't be opened */
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const;
+        const char* data() const;
+        size_t size() const;
+    };
+}
@@ -8,9 +8,10 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <cstdint>
 
 #include "graphics/VertexDescriptor.h"
-#include "graphics/Texture.h"
+#include "graphics/TextureHandler.h"
 // #include "view/CameraFreefly.hpp"
 #include "geometry/BoundingBox.h"
 
@@ -22,8 +23,10 @@ namespace Graphics
         unsigned int _triangleCount; /** Number of triangles in the mesh */
         std::vector<VertexDescriptor> _vertices; /** Vertices attributes (position, normal , uv) */
         std::vector<int> _elementIndex; /** Vertices indexes (vertices drawing order) */
+        std::vector<uint16_t> _shortElementIndex; /** Copy of _elementIndex on 16 bits, filled by optimize() when every index fits */
         Geometry::BoundingBox _boundaries /** Bounding box of the mesh */;
-        std::map<GLenum, Texture*> _textures /** Textures attached to the mesh with a specific binding point (GL_TEXTURE0, GL_TEXTURE1, ...) */;
+        std::map<GLenum, TextureHandle> _textures /** Textures attached to the mesh with a specific binding point (GL_TEXTURE0, GL_TEXTURE1, ...) */;
+        uint32_t _materialFeatures; /** Shader features the material of the mesh needs (see MainShaderFeature) */
     public:
         Mesh();
         Mesh(Mesh&& mesh);
@@ -41,13 +44,21 @@ namespace Graphics
         void setTriangleCount(unsigned int value);
 
         /** Add to _textures with a specified binding point (GL_TEXTURE0, GL_TEXTURE1, ...) */
-        void attachTexture(Graphics::Texture* tex, GLenum textureNumber);
+        void attachTexture(const TextureHandle& tex, GLenum textureNumber);
 
         /** Bind all Textures stored in _textures on their binding point */
         void bindTextures();
 
+        /** Select the shader permutation drawing the mesh, e.g. MAIN_NORMAL_MAP when a normal map is attached */
+        void setMaterialFeatures(uint32_t features);
+        uint32_t getMaterialFeatures() const;
+
         const std::vector<VertexDescriptor>& getVertices() const;
         const std::vector<int>& getElementIndex() const;
+        const std::vector<uint16_t>& getShortElementIndex() const;
+
+        /** GL_UNSIGNED_SHORT if the 16 bits indexes are up to date, GL_UNSIGNED_INT otherwise */
+        GLenum getIndexType() const;
 
         int getVertexCount() const;
         int getTriangleCount() const;
@@ -55,6 +66,12 @@ namespace Graphics
         /** look over _vertices to create a bounding box containing all vertices */
         void computeBoundingBox();
 
+        /**
+         * Reorder triangles for the post-transform vertex cache, then vertices in the order triangles use them (see MeshOptimizer).
+         * Fills the 16 bits indexes when the vertex count allows it, and logs the ACMR before and after.
+         */
+        void optimize();
+
         const Geometry::BoundingBox& getBoundingBox();
 
         /** Static functions to generate simple primitives */
@@ -62,7 +79,11 @@ namespace Graphics
         static Mesh genPlane(float width = 1.f, float height = 1.f, float textureLoop = 1, const glm::vec3 & offset = glm::vec3(0,0,0));
         static Mesh genSphere(int latitudeBands, int longitudeBands, float radius = 1.f, const glm::vec3 & offset = glm::vec3(0,0,0));
 
-        /** Static function to load a mesh using assimp */
+        /**
+         * Load a Wavefront OBJ file.
+         * The first load writes a binary cache next to the file (see MeshCache), which later loads copy without any parsing.
+         * Throws std::runtime_error if the file can't be read or is malformed.
+         */
         static Mesh loadMesh(const std::string& filePath);
     };
 }
@@ -7,13 +7,58 @@
 
 #include "graphics/Mesh.h"
 #include "geometry/Transformation.h"
+#include "geometry/Frustum.hpp"
+#include "graphics/VertexBufferObject.h"
 
 namespace Graphics
 {
+    /**
+     * Instances of a reference mesh.
+     * Positions, rotations and world space bounding boxes are stored as separate arrays (SoA),
+     * so culling streams through contiguous floats and tests 4 instances at once.
+     * Transformation matrices are cached, and only the instances modified since the last upload are sent to the GPU.
+     */
     class MeshInstance {
     private:
+        /** Number of consecutive instances grouped in a cluster for hierarchical culling */
+        static const size_t CLUSTER_SIZE = 256;
+
+        struct Cluster {
+            glm::vec3 center;
+            glm::vec3 extent;
+        };
+
         Mesh* _referenceMesh;
-        std::vector<Geometry::Transformation> _transformations;
+        std::vector<glm::vec3> _positions;
+        std::vector<glm::vec4> _rotations;
+        std::vector<glm::mat4> _matrices;
+        /** Material of each instance in a MaterialArray, as float for an INSTANCE_FLOAT_BUFFER */
+        std::vector<float> _materialLayers;
+        bool _materialLayersDirty;
+
+        /** Bounding box of the reference mesh, as center and half size */
+        glm::vec3 _localCenter, _localExtent;
+
+        /** World space axis aligned bounding boxes, as center and half size, computed when instances are added */
+        std::vector<float> _centerX, _centerY, _centerZ;
+        std::vector<float> _extentX, _extentY, _extentZ;
+
+        bool _hierarchicalCulling;
+        bool _clustersDirty;
+        std::vector<Cluster> _clusters;
+
+        /** Instance ranges [first, second[ modified since the last upload */
+        std::vector<std::pair<size_t, size_t>> _dirtyRanges;
+        /** Number of matrices the GPU buffer was allocated for by the last upload */
+        size_t _uploadedCapacity;
+
+        void insertInstances(size_t index, const Geometry::Transformation* transformations, size_t count);
+        /** Recompute the matrix and world bounding box of an instance from its position and rotation */
+        void updateInstance(size_t index);
+        void markDirty(size_t begin, size_t end);
+        void buildClusters();
+        void cullRange(const Geometry::Frustum& frustum, size_t begin, size_t end,
+                       std::vector<glm::vec3>& visiblePositions, std::vector<glm::vec4>& visibleRotations) const;
     public:
         MeshInstance(Mesh* referenceMesh);
         void addInstance(const Geometry::Transformation &trans);
@@ -24,9 +69,41 @@ namespace Graphics
         void addInstance(float xpos, float ypos, float zpos, float angle = 0, float xrot = 0, float yrot = 0, float zrot = 0);
         const glm::vec3& getPosition(int index);
         const glm::vec4& getRotation(int index);
-        const Geometry::Transformation& getTransformation(int index) const;
+        Geometry::Transformation getTransformation(int index) const;
+        const glm::mat4& getTransformationMatrix(int index) const;
+        void setPosition(int index, const glm::vec3& position);
+        void setRotation(int index, const glm::vec4& rotation);
+        void setTransformation(int index, const Geometry::Transformation& trans);
         Geometry::BoundingBox getBoundingBox(int index) const;
+        void setMaterialLayer(int index, int layer);
+        int getMaterialLayer(int index) const;
         int getInstanceNumber();
+
+        /**
+         * Append the position and rotation of every instance whose bounding box intersects the frustum.
+         * With hierarchical culling, clusters of CLUSTER_SIZE consecutive instances are tested first:
+         * clusters outside the frustum are skipped, clusters inside are accepted without testing their instances.
+         * It pays off for large instance counts (100k+) added with some spatial coherence.
+         */
+        void cull(const Geometry::Frustum& frustum, std::vector<glm::vec3>& visiblePositions, std::vector<glm::vec4>& visibleRotations);
+
+        void setHierarchicalCulling(bool enabled);
+
+        /** Read the bounding box of the reference mesh again, when it was computed or changed after the MeshInstance creation */
+        void updateMeshBounds();
+
+        /**
+         * Send the transformation matrices to an INSTANCE_TRANSFORMATION_BUFFER.
+         * The whole array is uploaded when the buffer has to grow; otherwise only the ranges modified since the last call are.
+         * A MeshInstance is meant to feed a single DYNAMIC_USAGE buffer.
+         */
+        void uploadTransformations(VertexBufferObject& vbo);
+
+        /**
+         * Send the material layers to an INSTANCE_FLOAT_BUFFER (location 7 of main.vert with MAIN_TEXTURE_ARRAY) if they changed.
+         * Instances of different materials of a MaterialArray are then drawn by a single instanced call.
+         */
+        void uploadMaterialLayers(VertexBufferObject& vbo);
     };
 }
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "graphics/VertexDescriptor.h"
+#include "graphics/MappedFile.hpp"
+
+namespace Graphics{
+
+    /** Indexed triangles read from a mesh file */
+    struct MeshData{
+        std::vector<VertexDescriptor> vertices;
+        std::vector<int> indices;
+    };
+
+    /**
+     * Wavefront OBJ parser.
+     * The text is cut in chunks at line boundaries which are parsed in parallel on the ThreadPool,
+     * then (position, texcoord, normal) corners are merged into unique vertices.
+     * Polygons are triangulated as fans, relative (negative) indices are supported,
+     * and smooth normals are generated when the file has none. Materials and groups are ignored.
+     */
+    class ObjParser{
+    public:
+        /** Throws std::runtime_error on malformed faces or out of range indices */
+        static MeshData parse(const char* text, size_t size);
+    };
+
+    /**
+     * Binary copy of a parsed mesh, stored next to its source file.
+     * The cache is memory mapped and its vertices and indices can be handed as is to VertexBufferObject::updateData.
+     * It is only used while the size and modification time of the source match the ones it was written for.
+     */
+    class MeshCache{
+        MappedFile _file;
+        const VertexDescriptor* _vertices;
+        const int* _indices;
+        size_t _vertexCount;
+        size_t _indexCount;
+
+    public:
+        MeshCache();
+
+        /**
+         * Map the cache of sourcePath. Returns false if it does not exist or is out of date.
+         * When the size or modification time of the source changed, its content hash is compared before giving up.
+         */
+        bool open(const std::string& sourcePath);
+
+        const VertexDescriptor* getVertices() const;
+        size_t getVertexCount() const;
+        const int* getIndices() const;
+        size_t getIndexCount() const;
+
+        static std::string cachePath(const std::string& sourcePath);
+
+        /** Write the cache of sourcePath, whose content hashes to sourceHash (see hashBytes). Returns false if it can't be written */
+        static bool write(const std::string& sourcePath, uint64_t sourceHash, const std::vector<VertexDescriptor>& vertices,
+                          const std::vector<int>& indices);
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "graphics/VertexDescriptor.h"
+
+namespace Graphics{
+
+    /**
+     * Reordering of indexed triangle lists for the GPU.
+     * The triangles are reordered first so that consecutive triangles share their vertices while they are still in the post-transform cache,
+     * then the vertices are reordered in the order the triangles use them, so vertex fetches read memory forward.
+     */
+    class MeshOptimizer{
+    public:
+        /** Size of the simulated post-transform vertex cache */
+        static const unsigned int DEFAULT_CACHE_SIZE = 32;
+
+        /** Reorder the triangles of indices with Tom Forsyth's linear-speed vertex cache optimisation */
+        static void optimizeVertexCache(std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+        /** Reorder vertices by first use in indices, and rewrite indices accordingly. Vertices no triangle uses are removed */
+        static void optimizeVertexFetch(std::vector<VertexDescriptor>& vertices, std::vector<int>& indices);
+
+        /** Average number of vertices transformed per triangle with a FIFO cache of cacheSize entries: 3 at worst, about 0.5 at best */
+        static float computeACMR(const std::vector<int>& indices, size_t vertexCount, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+    };
+}
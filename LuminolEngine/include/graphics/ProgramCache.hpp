@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Graphics{
+
+    /** One stage of a program: its type (GL_VERTEX_SHADER, ...) and its GLSL code */
+    struct ShaderSource{
+        GLenum type;
+        const char* code;
+    };
+
+    /**
+     * On-disk cache of linked programs (ARB_get_program_binary).
+     * Programs are keyed by a hash of their stages and of the driver strings: a driver update or an edited shader is a miss.
+     * A binary the driver refuses is a miss too, the program is then compiled and saved again.
+     * Creating the cache also asks the driver to compile shaders on its own threads (KHR_parallel_shader_compile),
+     * so programs built from sources can be linked later (see ShaderProgram).
+     */
+    class ProgramCache{
+        std::string _directory;
+        uint64_t _driverHash;
+        bool _isSupported;
+        bool _isDirectoryCreated;
+
+        static std::unique_ptr<ProgramCache> _global;
+
+        std::string cachePath(uint64_t key) const;
+
+    public:
+        static const char* const DEFAULT_DIRECTORY;
+
+        /** Requires a GL context */
+        explicit ProgramCache(const std::string& directory = DEFAULT_DIRECTORY);
+
+        ProgramCache(const ProgramCache&) = delete;
+        ProgramCache& operator=(const ProgramCache&) = delete;
+
+        /** Key of a program made of sources for the current driver */
+        uint64_t key(const std::vector<ShaderSource>& sources) const;
+
+        /** Link program from the cached binary of key. Returns false on a miss, leaving program untouched */
+        bool load(GLuint program, uint64_t key);
+        /** Save the binary of program, linked successfully with prepare() called before. Returns false if it was not written */
+        bool save(GLuint program, uint64_t key);
+
+        /** To call before glLinkProgram for the binary to be retrievable by save() */
+        void prepare(GLuint program) const;
+
+        bool isSupported() const;
+
+        /** Whether the completion of compiles and links can be polled without blocking (GL_COMPLETION_STATUS_KHR) */
+        static bool isParallelCompileSupported();
+
+        /** Shared cache in DEFAULT_DIRECTORY, created on first use */
+        static ProgramCache& global();
+
+        /** Destroy the shared cache. Its driver hash is recomputed if global() is called again */
+        static void releaseGlobal();
+    };
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Graphics{
+
+    /** Passes in execution order, the most significant bits of the sort key */
+    enum RenderPass : uint8_t{
+        RENDER_PASS_OPAQUE      = 0,    /** Sorted front to back */
+        RENDER_PASS_DEBUG       = 1,    /** Helpers drawn over the scene: DebugDrawer */
+        RENDER_PASS_TRANSPARENT = 2     /** Sorted back to front */
+    };
+
+    /** Fixed function state of a packet, applied through GLState */
+    enum RenderStateFlag : uint8_t{
+        RENDER_DEPTH_TEST   = 1 << 0,
+        RENDER_BLEND        = 1 << 1,   /** With the blend function currently set */
+        RENDER_WIREFRAME    = 1 << 2
+    };
+
+    /**
+     * One draw call with everything needed to issue it.
+     * Built by the renderers, possibly on worker threads: filling a packet does not touch GL.
+     * setup is called on the GL thread once the program and VAO are bound, for what differs between packets
+     * sharing them (uniforms, textures, instance attribute offsets). setupData must live until the queue is executed.
+     */
+    struct RenderPacket{
+        uint64_t key = 0;               /** See RenderQueue::makeKey */
+        GLuint program = 0;
+        GLuint vertexArray = 0;
+        GLenum primitive = GL_TRIANGLES;
+        GLenum indexType = 0;           /** GL_UNSIGNED_INT, GL_UNSIGNED_SHORT..., or 0 for glDrawArrays */
+        GLintptr first = 0;             /** First vertex, or byte offset of the first index */
+        GLsizei count = 0;
+        GLsizei instanceCount = 1;
+        GLint baseVertex = 0;
+        uint8_t state = RENDER_DEPTH_TEST;
+        void (*setup)(void* data) = nullptr;
+        void* setupData = nullptr;
+    };
+
+    /**
+     * Draw packets gathered during the frame, then sorted by key and issued in that order.
+     * The key orders by pass, then program, render state, material and depth, so that consecutive packets mostly
+     * share their state and GLState skips the calls setting it again.
+     * submit() may be called from any thread. execute() must be called on the thread owning the GL context;
+     * packets submitted while it runs are kept for the next execution.
+     */
+    class RenderQueue{
+        struct SortEntry{
+            uint64_t key;
+            uint32_t index;
+        };
+
+        mutable std::mutex _mutex;
+        std::vector<RenderPacket> _packets;
+        std::vector<RenderPacket> _executed;
+        std::vector<SortEntry> _entries;
+        std::vector<SortEntry> _sorted;
+
+        /** Stable radix sort of _entries by key, 8 bits per pass. Passes over a byte shared by every key are skipped */
+        void sortEntries();
+
+    public:
+        /** Bits of the key: pass 4, program 16, state 4, material 16, depth 24 */
+        static const int PASS_SHIFT = 60;
+        static const int PROGRAM_SHIFT = 44;
+        static const int STATE_SHIFT = 40;
+        static const int MATERIAL_SHIFT = 24;
+
+        RenderQueue() = default;
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        /**
+         * Sort key of a packet. material is any id grouping the packets binding the same textures.
+         * depth is the distance to the camera divided by the far plane, clamped to [0, 1].
+         * Only the low bits of program and material are kept: a collision costs a state change, not a wrong draw.
+         */
+        static uint64_t makeKey(RenderPass pass, GLuint program, uint8_t state, uint32_t material, float depth);
+
+        void submit(const RenderPacket& packet);
+        /** Take the lock once for all the packets, e.g. those built by a worker thread */
+        void submit(const RenderPacket* packets, size_t count);
+
+        /** Sort and issue every packet submitted so far, then forget them. Leaves no VAO bound */
+        void execute();
+
+        /** Packets waiting for execute() */
+        size_t size() const;
+        void clear();
+    };
+}
@@ -19,6 +19,7 @@ namespace Graphics
         std::vector<glm::vec3> _visiblePositions;
         std::vector<glm::vec4> _visibleRotations;
         std::string _currentInstance;
+        MeshInstance* _currentMeshInstance = nullptr; /** Cached _meshInstances[_currentInstance] */
     public:
         void addMeshInstance(MeshInstance *instance, const std::string& name);
 
@@ -26,6 +27,10 @@ namespace Graphics
 
         MeshInstance* getInstance();
 
+        /** Cull the current instance once and fill both visible positions and visible rotations */
+        void computeVisibleInstances(const glm::mat4 & VP);
+
+        /** Both run computeVisibleInstances: when both arrays are needed, call it once and use the getters */
         const std::vector<glm::vec3>& computeVisiblePositions(const glm::mat4 & VP);
         const std::vector<glm::vec4>& computeVisibleRotations(const glm::mat4 & VP);
 
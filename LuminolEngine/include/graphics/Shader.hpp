@@ -8,17 +8,28 @@ namespace Graphics{
 
     /**
      * Shader OpenGL wrapper.
+     * The source is read at construction but only compiled when a program needs it: programs found in the ProgramCache never compile it.
+     * compile() does not wait for the driver, checkCompile() does.
+     * defines (e.g. "#define NORMAL_MAP\n") are inserted after the #version line, see ShaderPermutations.
      */
     class Shader{
         GLuint _idShader;
         GLenum _type;
         std::string _path;
+        std::string _defines;
+        std::string _source;
+
+        void load();
+
     public:
-        Shader(GLenum type, const std::string& path);
+        Shader(GLenum type, const std::string& path, const std::string& defines = "");
         ~Shader();
 
         std::string getPath() const;
-        GLuint id() const;
+        const std::string& source() const;
+        GLenum type() const;
+        GLuint id() const;          /** 0 until compiled */
+        bool isCompiled() const;
         void compile();
         void checkCompile() const;
         void changeProperties(GLenum type, const std::string& path);
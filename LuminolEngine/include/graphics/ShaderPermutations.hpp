@@ -0,0 +1,56 @@
+#pragma once
+
+#include "graphics/ShaderProgram.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Graphics{
+
+    /** Features of shaders/main.vert and shaders/main.frag, combined in a bitmask */
+    enum MainShaderFeature : uint32_t{
+        MAIN_PACKED_VERTEX  = 1 << 0,   /** COMPACT_VERTEX or PACKED_VERTEX buffers, with octahedral normals */
+        MAIN_INSTANCED      = 1 << 1,   /** Placed by the instance matrices of a MeshInstance */
+        MAIN_TEXTURE_ARRAY  = 1 << 2,   /** Textures of a MaterialArray, selected by the instance material layer */
+        MAIN_NORMAL_MAP     = 1 << 3,   /** Normal perturbed by the NormalMap texture */
+        MAIN_SPECULAR_MAP   = 1 << 4    /** Specular intensity read from the Specular texture */
+    };
+
+    /** Macros of the MainShaderFeature bits, in bit order */
+    const std::vector<std::string>& mainShaderFeatureNames();
+
+    /**
+     * Variants of the same shader files, each compiled with a set of feature macros #defined.
+     * Disabled features are removed by the preprocessor instead of being branched over at run time.
+     * A variant is compiled the first time its feature bitmask is requested, then kept.
+     * Variants differ by their source, so each gets its own entry in the ProgramCache.
+     */
+    class ShaderPermutations{
+        std::string _vertexPath;
+        std::string _geometryPath;
+        std::string _fragmentPath;
+        std::vector<std::string> _featureNames;
+        std::unordered_map<uint32_t, std::unique_ptr<ShaderProgram>> _programs;
+
+    public:
+        /** featureNames[i] is the macro #defined for the bit 1 << i */
+        ShaderPermutations(const std::string& vertexPath, const std::string& geometryPath, const std::string& fragmentPath,
+                           const std::vector<std::string>& featureNames);
+
+        ShaderPermutations(const ShaderPermutations&) = delete;
+        ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+        /** Program of features, compiled on first request. Throws std::invalid_argument for bits without a feature name */
+        ShaderProgram& program(uint32_t features);
+
+        /** Start compiling the programs of features ahead of their first use, so that the driver builds them together */
+        void prepare(const std::vector<uint32_t>& features);
+
+        /** The #define lines of features */
+        std::string defines(uint32_t features) const;
+
+        size_t programCount() const;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "graphics/Shader.hpp"
+#include "graphics/UniformKey.hpp"
 #include <GL/gl.h>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
@@ -9,12 +10,46 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <unordered_map>
 
 namespace Graphics{
 
+    inline void setProgramUniform(GLuint program, GLint location, float v){ glProgramUniform1f(program, location, v); }
+    inline void setProgramUniform(GLuint program, GLint location, int v){ glProgramUniform1i(program, location, v); }
+    inline void setProgramUniform(GLuint program, GLint location, const glm::ivec2& v){ glProgramUniform2iv(program, location, 1, glm::value_ptr(v)); }
+    inline void setProgramUniform(GLuint program, GLint location, const glm::vec2& v){ glProgramUniform2fv(program, location, 1, glm::value_ptr(v)); }
+    inline void setProgramUniform(GLuint program, GLint location, const glm::vec3& v){ glProgramUniform3fv(program, location, 1, glm::value_ptr(v)); }
+    inline void setProgramUniform(GLuint program, GLint location, const glm::mat3& v){ glProgramUniformMatrix3fv(program, location, 1, 0, glm::value_ptr(v)); }
+    inline void setProgramUniform(GLuint program, GLint location, const glm::mat4& v){ glProgramUniformMatrix4fv(program, location, 1, 0, glm::value_ptr(v)); }
+    inline void setProgramUniform(GLuint program, GLint location, const std::vector<glm::vec3>& v){
+        glProgramUniform3fv(program, location, static_cast<GLsizei>(v.size()), reinterpret_cast<const float*>(v.data()));
+    }
+
+    /**
+     * Location of a uniform of a program, resolved once: set() is a single glProgramUniform* call.
+     * A uniform the program does not use has the location -1, whose updates GL ignores.
+     */
+    template<typename T>
+    class Uniform{
+        GLuint _programId;
+        GLint _location;
+
+    public:
+        Uniform(): _programId(0), _location(-1) {}
+        Uniform(GLuint programId, GLint location): _programId(programId), _location(location) {}
+
+        void set(const T& v) const { setProgramUniform(_programId, _location, v); }
+
+        bool isActive() const { return _location != -1; }
+        GLint location() const { return _location; }
+    };
+
     /**
      * Shader Program wrapper.
      * In order to prevent delete side effects of shared shader between ShaderProgram, each shader is a shared_ptr.
+     * The locations of the active uniforms are listed once linked, by name hash: updates never query the driver.
+     * Programs are read from the ProgramCache when possible. Otherwise the link is only checked on first use (see link()),
+     * so that drivers compiling in the background (KHR_parallel_shader_compile) build several programs at once.
      */
 
     class ShaderProgram {
@@ -22,31 +57,49 @@ namespace Graphics{
         std::shared_ptr<Shader> _vertexShader;
         std::shared_ptr<Shader> _geometryShader;
         std::shared_ptr<Shader> _fragShader;
+        uint64_t _cacheKey;
+        mutable bool _isLinked;                                         /** Link checked and uniforms listed */
+        mutable std::unordered_map<uint64_t, GLint> _uniformLocations;  /** By UniformKey hash */
         void compile();
         void checkLinkErrors() const;
+        void cacheUniformLocations() const;
+        std::vector<Shader*> stages() const;
 
     public:
-        ShaderProgram(const std::string& vShader, const std::string& gShader, const std::string& fShader);
+        /** defines are inserted in every stage, see Shader */
+        ShaderProgram(const std::string& vShader, const std::string& gShader, const std::string& fShader, const std::string& defines = "");
         ShaderProgram(const std::shared_ptr<Shader>& vShader, const std::shared_ptr<Shader>& fShader);
         ShaderProgram(const std::shared_ptr<Shader>& vShader, const std::string& fShader);
         ShaderProgram(const std::string& vShader            , const std::shared_ptr<Shader>& fShader);
         ~ShaderProgram();
 
+        /** Whether link() would not wait. Always true without KHR_parallel_shader_compile */
+        bool isReady() const;
+        /** Wait for the link and check it, throws std::runtime_error if a shader does not compile or link. Done by every use of the program */
+        void link() const;
+
         GLuint id() const;
         const std::shared_ptr<Shader> vShader() const;
         const std::shared_ptr<Shader> gShader() const;
         const std::shared_ptr<Shader> fShader() const;
 
-        void updateUniform(const std::string& uniformName, float v);
-        void updateUniform(const std::string& uniformName, int v);
-        void updateUniform(const std::string& uniformName, const glm::ivec2 & v);
-        void updateUniform(const std::string& uniformName, const glm::vec2 & v);
-        void updateUniform(const std::string& uniformName, const glm::vec3 & v);
-        void updateUniform(const std::string& uniformName, const glm::mat3 & v);
-        void updateUniform(const std::string& uniformName, const glm::mat4 & v);
-        void updateUniform(const std::string &uniformName, const std::vector<glm::vec3> &v);
+        /** Location of a uniform, -1 if the program does not use it */
+        GLint uniformLocation(const UniformKey& key) const;
+
+        /** Handle to update a uniform without any lookup, e.g. program.uniform<glm::mat4>(UBO_keys::MVP).set(mvp) */
+        template<typename T>
+        Uniform<T> uniform(const UniformKey& key) const { return Uniform<T>(_programId, uniformLocation(key)); }
+
+        void updateUniform(const UniformKey& key, float v);
+        void updateUniform(const UniformKey& key, int v);
+        void updateUniform(const UniformKey& key, const glm::ivec2 & v);
+        void updateUniform(const UniformKey& key, const glm::vec2 & v);
+        void updateUniform(const UniformKey& key, const glm::vec3 & v);
+        void updateUniform(const UniformKey& key, const glm::mat3 & v);
+        void updateUniform(const UniformKey& key, const glm::mat4 & v);
+        void updateUniform(const UniformKey& key, const std::vector<glm::vec3> &v);
 
-        void updateBindingPointUBO(const std::string &uniformName, GLuint uboBindingPoint);
+        void updateBindingPointUBO(const UniformKey& key, GLuint uboBindingPoint);
         void useProgram() const;
 
     };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <memory>
+
+namespace Graphics{
+
+    /**
+     * Ring buffer for data rewritten every frame.
+     * The buffer is split in FRAME_COUNT regions: uploads of a frame are packed one after another in the current region,
+     * and endFrame() fences it and moves to the next one, waiting for the GPU to be done with it first.
+     * The storage is mapped once for all with ARB_buffer_storage, or mapped unsynchronized for each upload otherwise:
+     * since the fences already guarantee the GPU does not read the range, the driver never has to copy or wait.
+     */
+    class StreamingBuffer{
+    public:
+        static const int FRAME_COUNT = 3;
+        static const GLsizeiptr DEFAULT_FRAME_SIZE = 8 << 20;
+        static const GLsizeiptr DEFAULT_ALIGNMENT = 16;
+
+        /** Place of an upload. buffer is 0 when it did not fit in the current frame region */
+        struct Allocation{
+            GLuint buffer;
+            GLintptr offset;
+        };
+
+    private:
+        GLuint _glId;
+        GLsizeiptr _frameSize;
+        int _currentFrame;
+        GLintptr _head;
+        bool _isPersistent;
+        char* _mapped;
+        GLsync _fences[FRAME_COUNT];
+        bool _overflowReported;
+
+        static std::unique_ptr<StreamingBuffer> _global;
+
+    public:
+        explicit StreamingBuffer(GLsizeiptr frameSize = DEFAULT_FRAME_SIZE);
+        ~StreamingBuffer();
+
+        StreamingBuffer(const StreamingBuffer&) = delete;
+        StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+        /** Copy size bytes at an offset multiple of alignment in the current frame region */
+        Allocation upload(const void* data, GLsizeiptr size, GLsizeiptr alignment = DEFAULT_ALIGNMENT);
+
+        /** To call once the frame draws are issued: the data uploaded since the last call must not be used anymore */
+        void endFrame();
+
+        GLuint glId() const;
+
+        /** Buffer shared by the engine, created on first use. Needs a current GL context */
+        static StreamingBuffer& global();
+
+        /** endFrame() on the global buffer if it was ever used */
+        static void endGlobalFrame();
+
+        /** Destroy the global buffer. To call while its GL context is still alive, before the GLState one */
+        static void releaseGlobal();
+    };
+
+    /** Wait until the GPU passed fence, then delete it and reset it to 0. Does nothing if fence is 0 */
+    void waitAndDeleteFence(GLsync& fence);
+}
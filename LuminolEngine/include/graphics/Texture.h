@@ -8,11 +8,15 @@
 #include <GL/glew.h>
 #include <string>
 #include <cstdlib>
+#include <memory>
 
 #include "stb_image.h"
 
 namespace Graphics
 {
+    class TextureCache;
+    class TgaImage;
+
     /**
      * Util struct when generating GL texture.
      */
@@ -85,10 +89,15 @@ namespace Graphics
         TextureType _type;
         TexParams _texParams;
         std::string _path      = "";
+        int _levelCount         = 1;
+        std::unique_ptr<TgaImage> _tgaImage;    /** Set instead of _data for TGA files, until genGlTex() uploads it */
 
         void setTextureParameters(TextureType type);    /** Update texParams according type and call genGlTex */
         void genGlTex();                                /** Generate GL texture based on _texParams. FBO are handled by _params: see TexParams::depth|rgba */
-        void loadImage(const std::string &filePath);    /** Load a given image. Update _data, _bitDepth, _width, _height **/
+        void genGlTex(const void* pixels);              /** Same as genGlTex() with pixels instead of _data */
+        void loadImage(const std::string &filePath);    /** Load a given image. Update _data (or _tgaImage), _bitDepth, _width, _height **/
+        bool loadCache(const std::string &filePath);    /** Upload the prebaked mip chain of a given image, see TextureCache. Returns false if it can't be decoded */
+        void updateLevelCount();                        /** Levels allocated by genGlTex() */
 
     public:
         Texture(const Texture& texture);
@@ -100,10 +109,27 @@ namespace Graphics
         Texture(int width, int height, TexParams texParams);            /** Custom fbo constructor*/
         ~Texture();
 
-        void bind();                            /** Just call glBindTexture() */
-        void bind(GLenum textureBindingIndex);  /** set glActiveTexture to textureBindingIndex before calling glBindTexture() */
+        void bind();                            /** Bind on the active texture unit, through GLState */
+        void bind(GLenum textureBindingIndex);  /** Bind on textureBindingIndex, through GLState */
         void unbind();
 
+        /** Recreate the GL texture at a new size. pixels may be null, or an offset in the bound GL_PIXEL_UNPACK_BUFFER */
+        void setImage(int width, int height, const void* pixels);
+
+        /** Recreate the GL texture with storage for levelCount mip levels of internalFormat, to be filled by setLevel */
+        void setLevels(GLenum internalFormat, int width, int height, int levelCount);
+        /** Upload a whole mip level. compressedSize is 0 for GL_RGB data, else the size of the block compressed data */
+        void setLevel(int level, const void* pixels, GLsizei compressedSize = 0);
+        void setBaseLevel(int level);           /** Finest level sampled, for levels uploaded from the smallest one */
+        /** setLevels() then setLevel() with the levels of cache from firstLevel, read directly from the mapped file */
+        void loadLevels(const TextureCache& cache, int firstLevel = 0);
+
+        /** Estimated GPU memory of all the allocated levels, in bytes */
+        size_t memorySize() const;
+        /** Estimated GPU memory of one mip level, in bytes */
+        size_t levelMemorySize(int level) const;
+        int levelCount() const;
+
         GLuint& glId();
         GLuint glId() const;
         int width();
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#include "graphics/TextureCache.hpp"
+
+namespace Graphics{
+
+    /**
+     * GL_TEXTURE_2D_ARRAY of same sized, same format images, each with its full mip chain.
+     * Layers are filled from TextureCaches, so they are uploaded already mipmapped and compressed.
+     * Shaders select the layer per instance: objects with different textures share one bind, and one draw when they share a mesh.
+     */
+    class TextureArray{
+        GLuint _glId;
+        int _width;
+        int _height;
+        int _levelCount;
+        int _capacity;
+        int _layerCount;
+        TextureCompression _compression;
+
+    public:
+        TextureArray(int width, int height, int capacity, TextureCompression compression = COMPRESSION_NONE);
+        TextureArray(TextureArray&& other);
+        ~TextureArray();
+
+        TextureArray(const TextureArray&) = delete;
+        TextureArray& operator=(const TextureArray&) = delete;
+
+        /** Whether the image of cache can be a layer: same size and compression */
+        bool isCompatible(const TextureCache& cache) const;
+
+        /** Append the image of cache and return its layer. Throws std::runtime_error if it is not compatible or the array is full */
+        int addLayer(const TextureCache& cache);
+        /** Load the cache of path (building it if needed) and append it. Throws std::runtime_error if it can't be read */
+        int addLayer(const std::string& path);
+
+        void bind(GLenum textureBindingIndex);
+        void unbind();
+
+        GLuint glId() const;
+        int layerCount() const;
+        int capacity() const;
+        TextureCompression compression() const;
+    };
+
+    /**
+     * One TextureArray per texture binding point of a material (e.g. diffuse, specular, normal map).
+     * The textures of a material are stored at the same layer in every array, so a single per instance layer selects them all.
+     */
+    class MaterialArray{
+    public:
+        struct Binding{
+            GLenum textureBindingIndex; /** GL_TEXTURE0, GL_TEXTURE1, ... */
+            TextureCompression compression;
+        };
+
+    private:
+        std::vector<Binding> _bindings;
+        std::vector<TextureArray> _arrays;
+        int _materialCount;
+
+    public:
+        MaterialArray(int width, int height, int capacity, const std::vector<Binding>& bindings);
+
+        /** Add a material given one texture path per binding, in the bindings order. Returns its layer */
+        int addMaterial(const std::vector<std::string>& paths);
+
+        /** Bind every array on its binding point */
+        void bind();
+
+        int materialCount() const;
+        TextureArray& array(size_t binding);
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "graphics/MappedFile.hpp"
+#include "graphics/TextureCompressor.hpp"
+
+namespace Graphics{
+
+    /**
+     * Full mip chain of an image, pre-generated and encoded in its GPU format, stored next to its source file.
+     * The cache is memory mapped and each level can be handed as is to glTexSubImage2D / glCompressedTexSubImage2D.
+     * It is used while the size and modification time of the source match the ones it was written for,
+     * or when they changed but the content hash still matches (copied or touched files).
+     */
+    class TextureCache{
+    public:
+        struct Level{
+            int width;
+            int height;
+            const unsigned char* data;
+            size_t size;
+        };
+
+    private:
+        MappedFile _file;
+        std::vector<unsigned char> _memory;     /** Built cache which could not be written */
+        TextureCompression _compression;
+        std::vector<Level> _levels;
+
+        /** Read the level table of a cache file image. Returns false if it is not a valid cache of compression */
+        bool parse(const unsigned char* data, size_t size, TextureCompression compression);
+
+    public:
+        TextureCache();
+
+        TextureCache(const TextureCache&) = delete;
+        TextureCache& operator=(const TextureCache&) = delete;
+
+        /** Map the cache of sourcePath. Returns false if it does not exist, is out of date or holds another compression */
+        bool open(const std::string& sourcePath, TextureCompression compression);
+
+        /**
+         * Decode sourcePath, generate its mip chain, encode it and write the cache.
+         * The levels stay available if the cache can't be written. Returns false if the source can't be decoded
+         */
+        bool build(const std::string& sourcePath, TextureCompression compression);
+
+        /** open(), or build() if there is no valid cache */
+        bool load(const std::string& sourcePath, TextureCompression compression);
+
+        TextureCompression compression() const;
+        int width() const;
+        int height() const;
+        int levelCount() const;
+        const Level& level(int index) const;
+
+        static std::string cachePath(const std::string& sourcePath);
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+#include <cstddef>
+
+namespace Graphics{
+
+    /** GPU block compression of a texture. Every format works on 4x4 pixel blocks */
+    enum TextureCompression{
+        COMPRESSION_NONE,   /** GL_RGB8, 3 bytes per pixel */
+        COMPRESSION_BC1,    /** RGB colors (diffuse maps), 8 bytes per block */
+        COMPRESSION_BC4,    /** Single channel (specular or height maps) kept in red, 8 bytes per block */
+        COMPRESSION_BC5     /** Two channels (normal maps): x and y kept in red and green, shaders rebuild z. 16 bytes per block */
+    };
+
+    /**
+     * CPU side encoders for the block compressed formats and mip chain generation, from 8 bits RGB images.
+     * Blocks are encoded independently, on the ThreadPool.
+     * The encoders fit the endpoints on the principal axis of each block: quality is close to the offline tools at a fraction of their cost.
+     */
+    class TextureCompressor{
+    public:
+        /** Encode a rgb image (3 bytes per pixel, no row padding) */
+        static std::vector<unsigned char> compress(const unsigned char* rgb, int width, int height, TextureCompression compression);
+
+        /** Half size image, each pixel averaging a 2x2 block. Normal maps are renormalized after filtering */
+        static std::vector<unsigned char> downsample(const unsigned char* rgb, int width, int height, bool normalMap);
+
+        /** Bytes of an encoded image */
+        static size_t imageSize(int width, int height, TextureCompression compression);
+
+        /** Number of levels of a full mip chain down to 1x1 */
+        static int levelCount(int width, int height);
+
+        static GLenum internalFormat(TextureCompression compression);
+
+        /** Whether the current GL context can sample the format */
+        static bool isSupported(TextureCompression compression);
+    };
+}
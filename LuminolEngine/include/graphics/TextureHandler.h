@@ -6,23 +6,121 @@
 #define LUMINOLGL_TEXTUREHANDLER_H
 
 #include "graphics/Texture.h"
+#include "graphics/TextureLoader.hpp"
 
 #include <unordered_map>
+#include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 namespace Graphics
 {
+    class TextureHandler;
 
+    /**
+     * Reference counted access to a texture of a TextureHandler.
+     * The texture of a file is released when its last handle is destroyed. Handles must not outlive their handler.
+     */
+    class TextureHandle {
+    private:
+        TextureHandler* _handler;
+        int _index;
+
+        friend class TextureHandler;
+        TextureHandle(TextureHandler* handler, int index);
+
+    public:
+        TextureHandle();
+        TextureHandle(const TextureHandle& handle);
+        TextureHandle(TextureHandle&& handle);
+        TextureHandle& operator=(TextureHandle handle);
+        ~TextureHandle();
+
+        bool isValid() const;
 
+        /** Bind on textureBindingIndex, marking the texture as used for the eviction */
+        void bind(GLenum textureBindingIndex) const;
+
+        Texture& texture() const;
+    };
+
+    /**
+     * Owner of the textures of the engine.
+     * Files are loaded once whatever the number of load() calls, asynchronously (see TextureLoader), and shared through TextureHandles.
+     * The GPU memory of every texture is tracked: above the budget, update() evicts the least recently bound file textures,
+     * first dropping their finest mip level, then replacing them with their placeholder. They are reloaded when bound again
+     * and the budget allows it. Textures given with add() are never evicted.
+     */
     class TextureHandler {
     private:
-        std::unordered_map<std::string, Texture> _map;
+        struct Entry{
+            std::unique_ptr<Texture> texture;   /** Allocated aside: the address stays valid when _entries grows */
+            std::string key;
+            std::string path;                   /** Empty for textures given with add() */
+            TextureCompression compression;
+            glm::u8vec3 placeholder;
+            int refCount;
+            uint64_t lastBound;                 /** Frame of the last bind */
+            int firstLevel;                     /** First cache level held by the texture, 0 when it is complete */
+            bool isUnloaded;                    /** Only the placeholder is left */
+            size_t completeSize;                /** Memory of the complete texture, 0 until it is known */
+            size_t pendingSize;                 /** Memory once its pending reload is uploaded */
+        };
+
+        std::vector<Entry> _entries;
+        std::vector<int> _freeEntries;
+        std::unordered_map<std::string, int> _indices;
+        TextureLoader _loader;
+        size_t _memoryBudget;
+        size_t _memoryUsage;
+        uint64_t _frame;
+        bool _overBudgetReported;
+
+        friend class TextureHandle;
+        void retain(int index);
+        void release(int index);
+        void bind(int index, GLenum textureBindingIndex);
+
+        int insert(std::unique_ptr<Texture> texture, const std::string& key);
+        /**
+         * Drop the finest mip level of a file texture, reloading the others in the background,
+         * or unload it when it is small enough. Return the memory freed once done
+         */
+        size_t evict(Entry& entry);
+
     public:
+        /** Textures smaller than this are unloaded instead of losing a level */
+        static const int MIN_EVICTED_SIZE = 64;
+
         TextureHandler();
-        void add(const Texture& texture, const std::string & textureName);
-        void add(Texture&& texture, const std::string & textureName);
+        ~TextureHandler();
+
+        TextureHandler(const TextureHandler&) = delete;
+        TextureHandler& operator=(const TextureHandler&) = delete;
+
+        /** Texture of a file, loaded asynchronously on first request. The placeholder color is shown until it is ready */
+        TextureHandle load(const std::string& path, TextureCompression compression = COMPRESSION_NONE,
+                           const glm::u8vec3& placeholder = glm::u8vec3(128, 128, 128));
+
+        /**
+         * Keep a texture built elsewhere (framebuffer attachments, generated textures) under a name.
+         * A texture already known under that name is replaced: its handles then refer to the new one
+         */
+        TextureHandle add(Texture&& texture, const std::string & textureName);
+
+        /** Throw std::out_of_range for unknown names. Textures of files are named after their path */
         const Texture& operator[](const std::string& textureName) const;
         Texture& operator[](const std::string& textureName);
+
+        /** Upload the loaded textures and enforce the memory budget. To call once per frame with the GL context current */
+        void update();
+
+        /** Bytes of GPU memory above which textures are evicted, 0 for no limit */
+        void setMemoryBudget(size_t bytes);
+        size_t memoryUsage() const;
+
+        TextureLoader& loader();
     };
 }
 
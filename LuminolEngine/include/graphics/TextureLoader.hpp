@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "graphics/Texture.h"
+#include "graphics/TextureCache.hpp"
+
+namespace Graphics{
+
+    /**
+     * Loads image files without blocking the main thread.
+     * load() turns the texture into a 1x1 placeholder right away and reads the file through its TextureCache on the ThreadPool,
+     * decoding and encoding the mip chain only the first time the file is seen.
+     * update(), called once per frame from the GL thread, streams the levels through the StreamingBuffer
+     * (bound as GL_PIXEL_UNPACK_BUFFER) from the smallest to the largest, so that a frame uploads about uploadBudget bytes at most.
+     * The texture samples the finest level uploaded so far: it sharpens over a few frames instead of popping in.
+     */
+    class TextureLoader{
+    public:
+        static const size_t DEFAULT_UPLOAD_BUDGET = 4 << 20;
+
+    private:
+        struct Request{
+            Texture* texture;
+            std::string path;
+            std::chrono::steady_clock::time_point start;
+            std::future<std::unique_ptr<TextureCache>> decoded;
+            std::unique_ptr<TextureCache> cache;
+            int firstLevel;     /** Finest cache level uploaded, it becomes the level 0 of the texture */
+            int nextLevel;      /** Next level to upload, below firstLevel once done */
+        };
+
+        std::deque<Request> _decoding;
+        std::deque<Request> _uploading;
+        size_t _uploadBudget;
+
+        /** Upload the next level of the request, return its size */
+        size_t uploadLevel(Request& request);
+
+    public:
+        explicit TextureLoader(size_t uploadBudget = DEFAULT_UPLOAD_BUDGET);
+
+        TextureLoader(const TextureLoader&) = delete;
+        TextureLoader& operator=(const TextureLoader&) = delete;
+
+        /**
+         * Start loading path into texture, which must stay at the same address until the load completes.
+         * The placeholder color is shown meanwhile, and kept if the file can not be decoded.
+         * The compression falls back to COMPRESSION_NONE when the GL context does not support it.
+         */
+        void load(Texture& texture, const std::string& path, TextureCompression compression = COMPRESSION_NONE,
+                  const glm::u8vec3& placeholder = glm::u8vec3(128, 128, 128));
+
+        /**
+         * Same as load() but the texture keeps its current content until the new one is uploaded.
+         * The cache levels finer than firstLevel are skipped, to get a lighter texture
+         */
+        void reload(Texture& texture, const std::string& path, TextureCompression compression = COMPRESSION_NONE, int firstLevel = 0);
+
+        /** Forget the pending load of texture, which can then be destroyed */
+        void cancel(const Texture& texture);
+
+        bool isPending(const Texture& texture) const;
+
+        /** Collect the decoded images and upload up to the budget. To call once per frame with the GL context current */
+        void update();
+
+        /** Block until every pending texture is uploaded, ignoring the budget */
+        void finish();
+
+        /** Textures still decoding or uploading */
+        size_t pendingCount() const;
+
+        void setUploadBudget(size_t bytes);
+    };
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#include "graphics/MappedFile.hpp"
+
+namespace Graphics{
+
+    /**
+     * Truevision TGA reader (uncompressed or RLE, 8 bits grey, 24 bits BGR or 32 bits BGRA) keeping the pixels in their file order.
+     * Pixels are given top row first like stb_image does, in the channel order of the file: GL_BGR / GL_BGRA uploads need no swizzling.
+     * An uncompressed file whose rows are stored top first is not copied at all, pixels() points in the memory mapping.
+     * Other files are decoded (RLE) or flipped in parallel, by blocks of rows.
+     */
+    class TgaImage{
+        MappedFile _file;
+        std::vector<unsigned char> _decoded;
+        const unsigned char* _pixels;
+        int _width;
+        int _height;
+        int _channels;
+
+    public:
+        TgaImage();
+
+        TgaImage(const TgaImage&) = delete;
+        TgaImage& operator=(const TgaImage&) = delete;
+
+        /** Map and read path. Returns false if it can't be opened or is not a supported TGA */
+        bool open(const std::string& path);
+
+        /** Read a TGA file already in memory, which must outlive the image. Returns false if it is not a supported TGA */
+        bool parse(const char* data, size_t size);
+
+        const unsigned char* pixels() const;
+        int width() const;
+        int height() const;
+        int channels() const;
+
+        /** Whether pixels() points in the file mapping */
+        bool isZeroCopy() const;
+
+        /** Pixel format for glTexImage2D: GL_RED, GL_BGR or GL_BGRA */
+        GLenum format() const;
+
+        /** Copy the image as 3 channels RGB, top row first (what stbi_load returns when asked for 3 channels) */
+        void copyRgb(unsigned char* rgb) const;
+
+        /** Whether path has the .tga extension */
+        static bool isTga(const std::string& path);
+    };
+}
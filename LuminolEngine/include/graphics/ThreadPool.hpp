@@ -0,0 +1,61 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace Graphics{
+
+    /**
+     * Fixed size pool of worker threads.
+     * Tasks are consumed in FIFO order. parallelFor splits a range in chunks shared between the workers and the calling thread,
+     * so it can safely be called from a task running on the pool.
+     */
+    class ThreadPool{
+        std::vector<std::thread> _workers;
+        std::queue<std::function<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stop;
+
+        void workerLoop();
+        void push(std::function<void()>&& task);
+
+    public:
+        ThreadPool(unsigned int threadCount = defaultThreadCount());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        unsigned int size() const;
+
+        /** Run task on a worker thread. The returned future holds its result */
+        template<typename F>
+        std::future<typename std::result_of<F()>::type> enqueue(F&& task);
+
+        /** Call func(chunkBegin, chunkEnd) on sub ranges of [begin, end[ holding at least grainSize elements. Blocks until every chunk is done */
+        void parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& func);
+
+        /** Hardware concurrency minus the calling thread, at least 1 */
+        static unsigned int defaultThreadCount();
+
+        /** Pool shared by the engine, created on first use */
+        static ThreadPool& global();
+    };
+
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> ThreadPool::enqueue(F&& task){
+        typedef typename std::result_of<F()>::type ResultType;
+
+        auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(task));
+        std::future<ResultType> result = packagedTask->get_future();
+        push([packagedTask](){ (*packagedTask)(); });
+        return result;
+    }
+}
@@ -8,18 +8,25 @@ namespace Graphics{
      * Uniform buffer object wrapper.
      * As we are limited in number of binding point on GPU, one UBO could be re-used for other purposes with other objects.
      * That's why this class is data uncorrelated.
+     * A streamed UBO, for blocks rewritten every frame (camera, lights), does not map its own buffer: each update is copied in
+     * the StreamingBuffer at a GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT multiple and that range is bound, so the CPU never waits
+     * for the GPU to be done with the previous data.
      */
     class UBO{
         GLuint _bufferId;
         GLuint _bindingPointIndex;
         int _sizeBuffer;
+        bool _isStreamed;
         void reserveBuffer(int size);
     public:
-        UBO(GLuint bindingPointIndex, int sizeBuffer=0);
+        UBO(GLuint bindingPointIndex, int sizeBuffer=0, bool isStreamed=false);
         ~UBO();
 
         void updateBuffer(const GLvoid* data, int sizeofObject);
         GLuint bindingPoint() const;
+        bool isStreamed() const;
+
+        /** GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, queried once */
+        static GLint offsetAlignment();
     };
 }
-
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "graphics/MappedFile.hpp"
+#include <cstdint>
+#include <string>
+
+namespace Graphics{
+
+    constexpr uint64_t hashUniformNameFrom(const char* name, uint64_t hash){
+        return *name ? hashUniformNameFrom(name + 1, (hash ^ static_cast<unsigned char>(*name)) * HASH_BYTES_PRIME) : hash;
+    }
+
+    /** hashBytes of a null terminated name, usable in constant expressions */
+    constexpr uint64_t hashUniformName(const char* name){
+        return hashUniformNameFrom(name, HASH_BYTES_SEED);
+    }
+
+    /** Same hash over the first length characters of name */
+    inline uint64_t hashUniformName(const char* name, size_t length){
+        return hashBytes(name, length);
+    }
+
+    /**
+     * Name of a uniform (or uniform block) with its hash.
+     * Keys built from literals are hashed at compile time (see UBO_keys), keys built from a std::string when used.
+     * The name is not copied: a key must not outlive the string it was built from.
+     */
+    struct UniformKey{
+        const char* name;
+        uint64_t hash;
+
+        constexpr UniformKey(const char* uniformName): name(uniformName), hash(hashUniformName(uniformName)) {}
+        UniformKey(const std::string& uniformName): name(uniformName.c_str()), hash(hashUniformName(uniformName.c_str(), uniformName.size())) {}
+    };
+}
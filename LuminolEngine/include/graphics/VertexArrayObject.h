@@ -17,6 +17,7 @@ namespace Graphics
     private:
         GLuint _glId;
         std::vector<VertexBufferObject*> _vbos;
+        std::vector<unsigned int> _vboGenerations; /** streamGeneration() of each VBO when its attributes were last pointed */
         bool _isInGPU;
 
     public:
@@ -28,6 +29,7 @@ namespace Graphics
         void addVBO(VertexBufferObject* vbo);
         void initGL();
         void init();
+        /** Bind the VAO, pointing again the attributes of the streamed VBOs that moved since the last bind */
         void bind();
         GLuint glId();
         const std::vector<VertexBufferObject*>& vbos() const;
@@ -7,22 +7,41 @@
 
 #include <GL/glew.h>
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "graphics/VertexDescriptor.h"
+#include "graphics/VertexFormat.hpp"
 
 namespace Graphics
 {
     enum DataType{
         VERTEX_DESCRIPTOR,
+        COMPACT_VERTEX,                 /** VertexDescriptor attributes packed in 20 bytes, see VertexFormat.hpp */
+        PACKED_VERTEX,                  /** VertexDescriptor attributes packed in 16 bytes, see VertexFormat.hpp */
         VEC3,
         VEC2,
         FLOAT,
         INT,
         ELEMENT_ARRAY_BUFFER,
         INSTANCE_BUFFER,                /** to store instance position or rotation or whatever you want */
+        INSTANCE_FLOAT_BUFFER,          /** to store one float per instance, like a scale */
         INSTANCE_TRANSFORMATION_BUFFER  /** to store transformations matrix */
     };
 
+    /** How often the data of a VertexBufferObject changes */
+    enum BufferUsage{
+        STATIC_USAGE,   /** Rarely updated: each update reallocates the storage with glBufferData */
+        DYNAMIC_USAGE,  /** Updated now and then: storage is reallocated only when the data grows */
+        STREAM_USAGE,   /** Rewritten every frame: data is copied in the StreamingBuffer and attributes point at its offset there */
+        IMMUTABLE_USAGE /** Uploaded once: immutable storage when ARB_buffer_storage is there, later updates can't grow it */
+    };
+
+    /**
+     * GPU buffer with the attribute layout of its DataType.
+     * A STREAM_USAGE buffer moves inside the StreamingBuffer at each update: the VertexArrayObjects using it point their
+     * attributes again when bound, and code setting attributes by hand must add offset().
+     * Element array buffers can't be streamed and are handled as DYNAMIC_USAGE.
+     */
     class VertexBufferObject {
     private:
         GLuint _glId;
@@ -30,31 +49,55 @@ namespace Graphics
         GLenum _target;
         GLuint _attribArray;
         bool _isInGPU;
-        void initVboVertexDescriptor();
+        BufferUsage _usage;
+        GLsizeiptr _capacity;           /** Bytes allocated in _glId */
+        GLuint _streamBuffer;           /** StreamingBuffer holding the data of a STREAM_USAGE buffer, 0 if it is in _glId */
+        GLintptr _streamOffset;
+        unsigned int _streamGeneration; /** Incremented each time the data moves */
+        void upload(const void* data, GLsizeiptr size);
+        const GLvoid* attribOffset(size_t offset) const;
+        /** Interleaved attributes described by VertexFormat<Vertex> */
+        template<typename Vertex>
+        void initVboFormat();
         void initVboVec3();
         void initVboVec2();
         void initVboFloat();
         void initVboInt();
         void initVboInstanceVec3();
+        void initVboInstanceFloat();
         void initVboInstanceMat4();
     public:
-        VertexBufferObject(DataType dataType, GLuint attribArray = 0, bool initGL = true);
+        VertexBufferObject(DataType dataType, GLuint attribArray = 0, bool initGL = true, BufferUsage usage = STATIC_USAGE);
         VertexBufferObject(VertexBufferObject&& other);
         VertexBufferObject(const VertexBufferObject& other);
         ~VertexBufferObject();
 
         GLuint glId();
+        /** Byte offset of the data in the buffer currently bound by bind() */
+        GLintptr offset() const;
+        unsigned int streamGeneration() const;
 
         /** Should not be used directly but inside VAO.init() */
         void init();
         void initGL();
         void bind();
         void updateData(const std::vector<VertexDescriptor>& data);
+        void updateData(const std::vector<CompactVertex>& data);
+        void updateData(const std::vector<PackedVertex>& data);
         void updateData(const std::vector<glm::vec3>& data);
         void updateData(const std::vector<glm::vec2>& data);
         void updateData(const std::vector<float>& data);
         void updateData(const std::vector<int>& data);
+        /** 16 bits indexes, for ELEMENT_ARRAY_BUFFER */
+        void updateData(const std::vector<uint16_t>& data);
         void updateData(const std::vector<glm::mat4>& data);
+        /** Overwrite data[first, first + count[ in the existing storage, which must already hold data.size() elements */
+        void updateData(const std::vector<glm::mat4>& data, size_t first, size_t count);
+        /** Same as the vector overloads, for data not stored in a std::vector (e.g. a mapped MeshCache) */
+        void updateData(const VertexDescriptor* data, size_t count);
+        void updateData(const int* data, size_t count);
+        void updateData(const glm::vec3* data, size_t count);
+        void updateData(const float* data, size_t count);
         void setAttribArray(GLuint value);
         static void unbindAll();
     };
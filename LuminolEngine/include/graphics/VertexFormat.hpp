@@ -0,0 +1,79 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "graphics/VertexDescriptor.h"
+
+namespace Graphics{
+
+    /** Layout of one attribute inside an interleaved vertex, as given to glVertexAttribPointer */
+    struct VertexAttribute{
+        GLuint location;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+
+    /**
+     * Attribute layout of a vertex type: attributes holds attributeCount entries and the stride is sizeof(Vertex).
+     * Every format keeps the VertexDescriptor locations (position 0, normal 1, texcoord 2), so a single VAO setup fits them all.
+     * Normals of packed formats are octahedral encoded: shaders must decode them (see decodeOctahedral in main.vert, MAIN_PACKED_VERTEX).
+     */
+    template<typename Vertex>
+    struct VertexFormat;
+
+    /** 20 bytes: float position, octahedral normal in 2x16 bits, half float texcoord */
+    struct CompactVertex{
+        glm::vec3 position;
+        glm::i16vec2 normal;
+        glm::u16vec2 texcoord;
+
+        CompactVertex(){}
+        explicit CompactVertex(const VertexDescriptor& vertex);
+    };
+
+    /** 16 bytes: half float position (w = 1 keeps the attribute 4 bytes aligned), octahedral normal in 2x16 bits, half float texcoord */
+    struct PackedVertex{
+        glm::u16vec4 position;
+        glm::i16vec2 normal;
+        glm::u16vec2 texcoord;
+
+        PackedVertex(){}
+        explicit PackedVertex(const VertexDescriptor& vertex);
+    };
+
+    template<>
+    struct VertexFormat<VertexDescriptor>{
+        static const VertexAttribute attributes[];
+        static const size_t attributeCount;
+    };
+
+    template<>
+    struct VertexFormat<CompactVertex>{
+        static const VertexAttribute attributes[];
+        static const size_t attributeCount;
+    };
+
+    template<>
+    struct VertexFormat<PackedVertex>{
+        static const VertexAttribute attributes[];
+        static const size_t attributeCount;
+    };
+
+    /** Unit vector to the octahedral map, as signed normalized 16 bits integers */
+    glm::i16vec2 packOctahedral(const glm::vec3& normal);
+    glm::vec3 unpackOctahedral(const glm::i16vec2& packed);
+
+    uint16_t packHalf(float value);
+    float unpackHalf(uint16_t value);
+
+    /** Convert VertexDescriptors to a packed format */
+    template<typename Vertex>
+    std::vector<Vertex> packVertices(const std::vector<VertexDescriptor>& vertices){
+        return std::vector<Vertex>(vertices.begin(), vertices.end());
+    }
+}
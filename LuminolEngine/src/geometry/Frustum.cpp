@@ -0,0 +1,41 @@
+#include "geometry/Frustum.hpp"
+
+using namespace Geometry;
+
+Frustum::Frustum(const glm::mat4& VP) {
+    // Rows of the matrix (glm is column major)
+    glm::vec4 row0(VP[0][0], VP[1][0], VP[2][0], VP[3][0]);
+    glm::vec4 row1(VP[0][1], VP[1][1], VP[2][1], VP[3][1]);
+    glm::vec4 row2(VP[0][2], VP[1][2], VP[2][2], VP[3][2]);
+    glm::vec4 row3(VP[0][3], VP[1][3], VP[2][3], VP[3][3]);
+
+    planes[LEFT_PLANE] = row3 + row0;
+    planes[RIGHT_PLANE] = row3 - row0;
+    planes[BOTTOM_PLANE] = row3 + row1;
+    planes[TOP_PLANE] = row3 - row1;
+    planes[NEAR_PLANE] = row3 + row2;
+    planes[FAR_PLANE] = row3 - row2;
+
+    for(glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const glm::vec3& center, const glm::vec3& extent) const {
+    for(const glm::vec4& plane : planes){
+        glm::vec3 normal(plane);
+        float radius = glm::dot(glm::abs(normal), extent);
+        if(glm::dot(normal, center) + plane.w + radius < 0)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::contains(const glm::vec3& center, const glm::vec3& extent) const {
+    for(const glm::vec4& plane : planes){
+        glm::vec3 normal(plane);
+        float radius = glm::dot(glm::abs(normal), extent);
+        if(glm::dot(normal, center) + plane.w - radius < 0)
+            return false;
+    }
+    return true;
+}
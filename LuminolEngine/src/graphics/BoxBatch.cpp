@@ -0,0 +1,100 @@
+#include "graphics/BoxBatch.hpp"
+#include <glm/common.hpp>
+
+using namespace Graphics;
+
+BoxBatch::BoxBatch():
+    _cubeVBO(VEC3, 0, true, IMMUTABLE_USAGE),
+    _cubeIdsVBO(ELEMENT_ARRAY_BUFFER, 0, true, IMMUTABLE_USAGE),
+    _centersVBO(INSTANCE_BUFFER, 1, true, DYNAMIC_USAGE),
+    _extentsVBO(INSTANCE_BUFFER, 2, true, DYNAMIC_USAGE),
+    _colorsVBO(INSTANCE_BUFFER, 3, true, DYNAMIC_USAGE),
+    _isUploaded(true)
+{
+    // Corners of the [-1, 1] cube and its 12 edges
+    std::vector<glm::vec3> corners = {
+        glm::vec3(-1, -1, -1), glm::vec3(1, -1, -1), glm::vec3(1, 1, -1), glm::vec3(-1, 1, -1),
+        glm::vec3(-1, -1,  1), glm::vec3(1, -1,  1), glm::vec3(1, 1,  1), glm::vec3(-1, 1,  1)
+    };
+    std::vector<int> edges = {
+        0, 1, 1, 2, 2, 3, 3, 0,
+        4, 5, 5, 6, 6, 7, 7, 4,
+        0, 4, 1, 5, 2, 6, 3, 7
+    };
+
+    _VAO.addVBO(&_cubeVBO);
+    _VAO.addVBO(&_cubeIdsVBO);
+    _VAO.addVBO(&_centersVBO);
+    _VAO.addVBO(&_extentsVBO);
+    _VAO.addVBO(&_colorsVBO);
+    _VAO.init();
+
+    // The VAO is still bound: it records the element array buffer
+    _cubeVBO.updateData(corners);
+    _cubeIdsVBO.updateData(edges);
+
+    VertexArrayObject::unbindAll();
+    VertexBufferObject::unbindAll();
+}
+
+void BoxBatch::add(const glm::vec3& center, const glm::vec3& extent, const glm::vec3& color) {
+    _centers.push_back(center);
+    _extents.push_back(extent);
+    _colors.push_back(color);
+    _isUploaded = false;
+}
+
+void BoxBatch::add(const Geometry::BoundingBox& box, const glm::vec3& color) {
+    const std::vector<glm::vec3>& points = box.getVector();
+    if(points.empty())
+        return;
+
+    glm::vec3 min = points[0];
+    glm::vec3 max = points[0];
+    for(const glm::vec3& p : points){
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    add(0.5f * (min + max), 0.5f * (max - min), color);
+}
+
+void BoxBatch::clear() {
+    if(_centers.empty())
+        return;
+
+    _centers.clear();
+    _extents.clear();
+    _colors.clear();
+    _isUploaded = false;
+}
+
+size_t BoxBatch::size() const {
+    return _centers.size();
+}
+
+void BoxBatch::submit(RenderQueue& queue, const ShaderProgram& program, uint8_t state) {
+    if(_centers.empty())
+        return;
+
+    if(!_isUploaded){
+        _centersVBO.updateData(_centers);
+        _extentsVBO.updateData(_extents);
+        _colorsVBO.updateData(_colors);
+        _isUploaded = true;
+    }
+
+    // The packet names the program directly: it must be linked before execute()
+    program.link();
+
+    RenderPacket packet;
+    packet.program = program.id();
+    packet.key = RenderQueue::makeKey(RENDER_PASS_DEBUG, packet.program, state, 0, 0.f);
+    packet.vertexArray = _VAO.glId();
+    packet.primitive = GL_LINES;
+    packet.indexType = GL_UNSIGNED_INT;
+    packet.count = 24;
+    packet.instanceCount = static_cast<GLsizei>(_centers.size());
+    packet.state = state;
+    queue.submit(packet);
+}
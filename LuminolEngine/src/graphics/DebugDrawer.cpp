@@ -6,25 +6,28 @@
 #include <glog/logging.h>
 #include <graphics/UBO_keys.hpp>
 #include <glm/gtx/transform.hpp>
+#include <algorithm>
 
 namespace Graphics
 {
     bool DebugDrawer::_isInit = false;
-    DebugDrawer DebugDrawer::_drawer;
+
+    DebugDrawer& DebugDrawer::drawer() {
+        static DebugDrawer drawer;
+        return drawer;
+    }
 
     void DebugDrawer::init() {
         if(_isInit) return;
         _isInit = true;
 
-        _drawer._VAO.addVBO(&_drawer._verticesVBO);
-        _drawer._VAO.addVBO(&_drawer._indexesVBO);
-        _drawer._VAO.addVBO(&_drawer._transformVBO);
-        _drawer._VAO.init();
-        std::vector<int> ids = {0,1,2};
+        DebugDrawer& d = drawer();
+        d._VAO.addVBO(&d._verticesVBO);
+        d._VAO.addVBO(&d._transformVBO);
+        d._VAO.init();
         std::vector<glm::mat4> trans = {glm::mat4()};
 
-        _drawer._indexesVBO.updateData(ids);
-        _drawer._transformVBO.updateData(trans);
+        d._transformVBO.updateData(trans);
 
         Graphics::VertexArrayObject::unbindAll();
         Graphics::VertexBufferObject::unbindAll();
@@ -32,62 +35,115 @@ namespace Graphics
 
     DebugDrawer::DebugDrawer() :
             _VAO(false),
-            _verticesVBO(Graphics::VEC3, 0, false),
-            _indexesVBO(Graphics::ELEMENT_ARRAY_BUFFER, 0, false),
-            _transformVBO(Graphics::INSTANCE_TRANSFORMATION_BUFFER, 1, false)
+            _verticesVBO(Graphics::VEC3, 0, false, Graphics::STREAM_USAGE),
+            _transformVBO(Graphics::INSTANCE_TRANSFORMATION_BUFFER, 1, false),
+            _lastBatch(0)
     { }
 
-    void DebugDrawer::drawRay(const glm::vec3 &point1, const glm::vec3 &point2, ShaderProgram &program, const glm::vec3 &color, float lineWidth) {
+    std::vector<glm::vec3>& DebugDrawer::batch(ShaderProgram &program, GLenum primitive, const glm::vec3 &color, float size) {
+        std::vector<Batch>& batches = drawer()._batches;
+
+        // Consecutive calls usually share the same state
+        if(drawer()._lastBatch < batches.size()){
+            Batch& last = batches[drawer()._lastBatch];
+            if(last.program == &program && last.primitive == primitive && last.color == color && last.size == size)
+                return last.vertices;
+        }
+
+        for(size_t i = 0; i < batches.size(); ++i){
+            Batch& b = batches[i];
+            if(b.program == &program && b.primitive == primitive && b.color == color && b.size == size){
+                drawer()._lastBatch = i;
+                return b.vertices;
+            }
+        }
+
+        batches.push_back(Batch{&program, primitive, color, size, std::vector<glm::vec3>()});
+        drawer()._lastBatch = batches.size() - 1;
+        return batches.back().vertices;
+    }
+
+    void DebugDrawer::submit(RenderQueue &queue) {
         if(!_isInit) init();
 
-        _drawer._points.clear();
-        _drawer._points.push_back(point1);
-        _drawer._points.push_back(point2);
-        _drawer._verticesVBO.updateData(_drawer._points);
+        // Gather every batch in a single array, uploaded with one call
+        std::vector<glm::vec3>& points = drawer()._points;
+        points.clear();
+        for(const Batch& b : drawer()._batches)
+            points.insert(points.end(), b.vertices.begin(), b.vertices.end());
 
-        program.useProgram();
-        program.updateUniform(UBO_keys::DEBUG_COLOR, color);
+        if(points.empty()) return;
 
-        glLineWidth(lineWidth);
+        // Written in the StreamingBuffer: binding the VAO points the vertex attribute at the new data
+        drawer()._verticesVBO.updateData(points);
+        drawer()._VAO.bind();
+        Graphics::VertexArrayObject::unbindAll();
+        Graphics::VertexBufferObject::unbindAll();
 
-        _drawer._VAO.bind();
-        glDrawElements(GL_LINES, 2, GL_UNSIGNED_INT, (void*)0);
+        // The packets point to copies of the batch states: batches may be added before the queue is executed
+        std::vector<SubmittedBatch>& submitted = drawer()._submitted;
+        submitted.clear();
+        for(const Batch& b : drawer()._batches){
+            if(!b.vertices.empty())
+                submitted.push_back(SubmittedBatch{b.program, b.primitive, b.color, b.size});
+        }
+
+        GLint first = 0;
+        size_t index = 0;
+        for(Batch& b : drawer()._batches){
+            if(b.vertices.empty()) continue;
+
+            RenderPacket packet;
+            packet.program = b.program->id();
+            packet.key = RenderQueue::makeKey(RENDER_PASS_DEBUG, packet.program, RENDER_DEPTH_TEST, 0, 0.f);
+            packet.vertexArray = drawer()._VAO.glId();
+            packet.primitive = b.primitive;
+            packet.first = first;
+            packet.count = b.vertices.size();
+            packet.setup = &DebugDrawer::setupBatch;
+            packet.setupData = &submitted[index++];
+            queue.submit(packet);
+            first += b.vertices.size();
+
+            // Keep the batch and its capacity for the next frame
+            b.vertices.clear();
+        }
     }
 
-    void DebugDrawer::drawTriangle(const glm::vec3 &point1, const glm::vec3 &point2, const glm::vec3 &point3, ShaderProgram &program, const glm::vec3 &color) {
-        if(!_isInit) init();
-
-        _drawer._points.clear();
-        _drawer._points.push_back(point1);
-        _drawer._points.push_back(point2);
-        _drawer._points.push_back(point3);
-        _drawer._verticesVBO.updateData(_drawer._points);
+    void DebugDrawer::setupBatch(void *submitted) {
+        const SubmittedBatch& b = *static_cast<SubmittedBatch*>(submitted);
 
-        program.useProgram();
-        program.updateUniform(UBO_keys::DEBUG_COLOR, color);
+        b.program->updateUniform(UBO_keys::DEBUG_COLOR, b.color);
 
-        _drawer._VAO.bind();
-        glDrawElements(GL_TRIANGLE_STRIP, 3, GL_UNSIGNED_INT, (void*)0);
+        if(b.primitive == GL_LINES)
+            glLineWidth(b.size);
+        else if(b.primitive == GL_POINTS)
+            glPointSize(b.size);
     }
 
-    void DebugDrawer::drawPoint(const glm::vec3 &point, ShaderProgram &program, const glm::vec3 &color, float pointSize) {
-        if(!_isInit) init();
+    void DebugDrawer::flush() {
+        submit(drawer()._queue);
+        drawer()._queue.execute();
+    }
 
-        glPointSize(pointSize);
+    void DebugDrawer::drawRay(const glm::vec3 &point1, const glm::vec3 &point2, ShaderProgram &program, const glm::vec3 &color, float lineWidth) {
+        std::vector<glm::vec3>& vertices = batch(program, GL_LINES, color, lineWidth);
+        vertices.push_back(point1);
+        vertices.push_back(point2);
+    }
 
-        _drawer._points.clear();
-        _drawer._points.push_back(point);
-        _drawer._verticesVBO.updateData(_drawer._points);
+    void DebugDrawer::drawTriangle(const glm::vec3 &point1, const glm::vec3 &point2, const glm::vec3 &point3, ShaderProgram &program, const glm::vec3 &color) {
+        std::vector<glm::vec3>& vertices = batch(program, GL_TRIANGLES, color, 0);
+        vertices.push_back(point1);
+        vertices.push_back(point2);
+        vertices.push_back(point3);
+    }
 
-        program.useProgram();
-        program.updateUniform(UBO_keys::DEBUG_COLOR, color);
-        _drawer._VAO.bind();
-        glDrawElements(GL_POINTS, 1, GL_UNSIGNED_INT, (void*)0);
+    void DebugDrawer::drawPoint(const glm::vec3 &point, ShaderProgram &program, const glm::vec3 &color, float pointSize) {
+        batch(program, GL_POINTS, color, pointSize).push_back(point);
     }
 
     void DebugDrawer::drawPyramid(const glm::mat4 &trans, ShaderProgram &program, float scale, const glm::vec3 &color) {
-        if(!_isInit) init();
-
         glm::vec3 xAxis = glm::vec3(trans * glm::vec4(1,0,0,0));
         glm::vec3 yAxis = glm::vec3(trans * glm::vec4(0,1,0,0));
         glm::vec3 zAxis = glm::vec3(trans * glm::vec4(0,0,1,0));
@@ -124,8 +180,6 @@ namespace Graphics
 
 
     void DebugDrawer::drawCube(const glm::mat4 &trans, ShaderProgram &program, float scale, const glm::vec3 &color) {
-        if(!_isInit) init();
-
         std::vector<glm::vec3> cube;
 
         glm::vec3 origin = glm::vec3(trans *  glm::vec4(0,0,0,1));
@@ -158,10 +212,6 @@ namespace Graphics
     }
 
     void DebugDrawer::drawAxis(const glm::mat4 &trans, ShaderProgram &program, float scale, float lineWidth) {
-        if(!_isInit) init();
-
-        glLineWidth(lineWidth);
-
         glm::vec3 xAxis = glm::vec3(trans * glm::vec4(1,0,0,0));
         glm::vec3 yAxis = glm::vec3(trans * glm::vec4(0,1,0,0));
         glm::vec3 zAxis = glm::vec3(trans * glm::vec4(0,0,1,0));
@@ -174,8 +224,6 @@ namespace Graphics
     }
 
     void DebugDrawer::drawTranslateAxis(const glm::mat4 &trans, ShaderProgram &program, float scale, float lineWidth) {
-        if(!_isInit) init();
-
         drawAxis(trans, program, scale, lineWidth);
 
         drawPyramid(trans * glm::rotate(glm::radians(-90.f), glm::vec3(0, 0, 1)), program, scale, glm::vec3(1,0,0));
@@ -192,8 +240,6 @@ namespace Graphics
     }
 
     void DebugDrawer::drawRotationAxis(const glm::mat4 &trans, ShaderProgram &program, float scale, float lineWidth) {
-        if(!_isInit) init();
-
         drawAxis(trans, program, scale, lineWidth);
     }
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "graphics/GLState.hpp"
+
+using namespace Graphics;
+
+const GLuint GLState::UNKNOWN;
+
+std::unique_ptr<GLState> GLState::_global;
+
+GLState::GLState() {
+    invalidate();
+    _counters.issued = _counters.skipped = 0;
+    _lastFrameCounters = _counters;
+}
+
+int GLState::bufferTarget(GLenum target) {
+    switch(target){
+        case GL_ARRAY_BUFFER: return ARRAY_BUFFER_TARGET;
+        case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY_BUFFER_TARGET;
+        case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER_TARGET;
+        case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER_TARGET;
+        case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER_TARGET;
+        default: return -1;
+    }
+}
+
+int GLState::textureTarget(GLenum target) {
+    switch(target){
+        case GL_TEXTURE_2D: return TEXTURE_2D_TARGET;
+        case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY_TARGET;
+        case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP_TARGET;
+        default: return -1;
+    }
+}
+
+bool GLState::change(GLuint &shadow, GLuint value) {
+    if(shadow == value){
+        ++_counters.skipped;
+        return false;
+    }
+    shadow = value;
+    ++_counters.issued;
+    return true;
+}
+
+void GLState::useProgram(GLuint program) {
+    if(change(_program, program))
+        glUseProgram(program);
+}
+
+void GLState::bindVertexArray(GLuint vertexArray) {
+    if(change(_vertexArray, vertexArray)){
+        glBindVertexArray(vertexArray);
+        _buffers[ELEMENT_ARRAY_BUFFER_TARGET] = UNKNOWN;
+    }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer) {
+    int index = bufferTarget(target);
+    if(index < 0){
+        ++_counters.issued;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if(change(_buffers[index], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    ++_counters.issued;
+    glBindBufferBase(target, index, buffer);
+
+    int shadow = bufferTarget(target);
+    if(shadow >= 0)
+        _buffers[shadow] = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    ++_counters.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+
+    int shadow = bufferTarget(target);
+    if(shadow >= 0)
+        _buffers[shadow] = buffer;
+}
+
+void GLState::activeTexture(GLenum textureUnit) {
+    if(change(_activeTexture, textureUnit))
+        glActiveTexture(textureUnit);
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture) {
+    int unit = _activeTexture == UNKNOWN ? -1 : static_cast<int>(_activeTexture - GL_TEXTURE0);
+    int index = textureTarget(target);
+    if(unit < 0 || unit >= MAX_TEXTURE_UNITS || index < 0){
+        ++_counters.issued;
+        glBindTexture(target, texture);
+        return;
+    }
+    if(change(_textures[unit][index], texture))
+        glBindTexture(target, texture);
+}
+
+void GLState::bindTexture(GLenum textureUnit, GLenum target, GLuint texture) {
+    // Already bound there: the active unit does not need to change either
+    int unit = static_cast<int>(textureUnit - GL_TEXTURE0);
+    int index = textureTarget(target);
+    if(unit >= 0 && unit < MAX_TEXTURE_UNITS && index >= 0 && _textures[unit][index] == texture){
+        ++_counters.skipped;
+        return;
+    }
+
+    activeTexture(textureUnit);
+    bindTexture(target, texture);
+}
+
+void GLState::enable(GLenum capability) {
+    setEnabled(capability, true);
+}
+
+void GLState::disable(GLenum capability) {
+    setEnabled(capability, false);
+}
+
+void GLState::setEnabled(GLenum capability, bool isEnabled) {
+    auto it = _capabilities.find(capability);
+    if(it != _capabilities.end() && it->second == isEnabled){
+        ++_counters.skipped;
+        return;
+    }
+
+    _capabilities[capability] = isEnabled;
+    ++_counters.issued;
+    if(isEnabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::polygonMode(GLenum mode) {
+    if(change(_polygonMode, mode))
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLState::forgetProgram(GLuint program) {
+    if(_program == program)
+        _program = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(GLuint vertexArray) {
+    if(_vertexArray == vertexArray){
+        _vertexArray = UNKNOWN;
+        _buffers[ELEMENT_ARRAY_BUFFER_TARGET] = UNKNOWN;
+    }
+}
+
+void GLState::forgetBuffer(GLuint buffer) {
+    for(int i = 0; i < BUFFER_TARGET_COUNT; ++i){
+        if(_buffers[i] == buffer)
+            _buffers[i] = UNKNOWN;
+    }
+}
+
+void GLState::forgetTexture(GLuint texture) {
+    for(int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit){
+        for(int i = 0; i < TEXTURE_TARGET_COUNT; ++i){
+            if(_textures[unit][i] == texture)
+                _textures[unit][i] = UNKNOWN;
+        }
+    }
+}
+
+void GLState::invalidate() {
+    _program = UNKNOWN;
+    _vertexArray = UNKNOWN;
+    for(int i = 0; i < BUFFER_TARGET_COUNT; ++i)
+        _buffers[i] = UNKNOWN;
+    _activeTexture = UNKNOWN;
+    for(int unit = 0; unit < MAX_TEXTURE_UNITS; ++unit){
+        for(int i = 0; i < TEXTURE_TARGET_COUNT; ++i)
+            _textures[unit][i] = UNKNOWN;
+    }
+    _polygonMode = UNKNOWN;
+    _capabilities.clear();
+}
+
+const GLState::Counters &GLState::counters() const {
+    return _counters;
+}
+
+const GLState::Counters &GLState::lastFrameCounters() const {
+    return _lastFrameCounters;
+}
+
+void GLState::endFrame() {
+    _lastFrameCounters = _counters;
+    _counters.issued = _counters.skipped = 0;
+}
+
+GLState &GLState::global() {
+    if(!_global)
+        _global.reset(new GLState());
+    return *_global;
+}
+
+GLState *GLState::existingGlobal() {
+    return _global.get();
+}
+
+void GLState::endGlobalFrame() {
+    if(_global)
+        _global->endFrame();
+}
+
+void GLState::releaseGlobal() {
+    _global.reset();
+}
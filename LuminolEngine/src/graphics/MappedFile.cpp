@@ -0,0 +1,155 @@
+#include "graphics/MappedFile.hpp"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace Graphics;
+
+uint64_t Graphics::hashBytes(const void *data, size_t size, uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * HASH_BYTES_PRIME;
+    return hash;
+}
+
+bool Graphics::writeFileAtomically(const std::string &path, std::initializer_list<FileRange> ranges) {
+#if defined(_WIN32)
+    long processId = _getpid();
+#else
+    long processId = getpid();
+#endif
+    size_t threadId = std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::string temporaryPath = path + "." + std::to_string(processId) + "-" + std::to_string(threadId) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        for(const FileRange& range : ranges)
+            file.write(static_cast<const char*>(range.data), range.size);
+        if(!file){
+            file.close();
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if(std::rename(temporaryPath.c_str(), path.c_str()) != 0){
+        // Windows does not replace an existing file
+        std::remove(path.c_str());
+        if(std::rename(temporaryPath.c_str(), path.c_str()) != 0){
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileStamp::get(const std::string &path, FileStamp &stamp) {
+    struct stat status;
+    if(stat(path.c_str(), &status) != 0)
+        return false;
+
+    stamp.size = status.st_size;
+    stamp.modificationTime = status.st_mtime;
+    return true;
+}
+
+MappedFile::MappedFile(): _data(nullptr), _size(0), _isOpen(false) {}
+
+MappedFile::MappedFile(const std::string &path): MappedFile() {
+    if(!open(path))
+        throw std::runtime_error("Unable to open " + path);
+}
+
+MappedFile::MappedFile(MappedFile &&other): _data(other._data), _size(other._size), _isOpen(other._isOpen) {
+#if defined(_WIN32)
+    _buffer = std::move(other._buffer);
+#endif
+    other._data = nullptr;
+    other._size = 0;
+    other._isOpen = false;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+#if defined(_WIN32)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+        return false;
+
+    _buffer.resize(file.tellg());
+    file.seekg(0);
+    if(!file.read(_buffer.data(), _buffer.size()))
+        return false;
+
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat status;
+    if(fstat(fd, &status) != 0){
+        ::close(fd);
+        return false;
+    }
+
+    // mmap refuses empty mappings: an empty file is open but has no data
+    if(status.st_size > 0){
+        void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(address == MAP_FAILED){
+            ::close(fd);
+            return false;
+        }
+        // Files are mostly read from start to end
+        madvise(address, status.st_size, MADV_SEQUENTIAL);
+        _data = static_cast<const char*>(address);
+    }
+    _size = status.st_size;
+
+    // The mapping keeps its own reference on the file
+    ::close(fd);
+#endif
+    _isOpen = true;
+    return true;
+}
+
+void MappedFile::close() {
+#if defined(_WIN32)
+    std::vector<char>().swap(_buffer);
+#else
+    if(_data)
+        munmap(const_cast<char*>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _isOpen = false;
+}
+
+bool MappedFile::isOpen() const {
+    return _isOpen;
+}
+
+const char *MappedFile::data() const {
+    return _data;
+}
+
+size_t MappedFile::size() const {
+    return _size;
+}
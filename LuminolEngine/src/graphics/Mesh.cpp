@@ -3,32 +3,48 @@
 //
 
 #include <glm/gtc/constants.hpp>
+#include <chrono>
+#include <glog/logging.h>
 #include "graphics/Mesh.h"
+#include "graphics/MeshLoader.hpp"
+#include "graphics/MeshOptimizer.hpp"
+#include <limits>
 
 namespace Graphics
 {
 
-    Mesh::Mesh() : _vertexCount(0), _triangleCount(0) { }
+    Mesh::Mesh() : _vertexCount(0), _triangleCount(0), _materialFeatures(0) { }
 
     Mesh::Mesh(Mesh &&mesh) :
             _vertexCount(mesh._vertexCount),
             _triangleCount(mesh._triangleCount),
             _vertices(std::move(mesh._vertices)),
             _elementIndex(std::move(mesh._elementIndex)),
-            _textures(std::move(mesh._textures))
+            _shortElementIndex(std::move(mesh._shortElementIndex)),
+            _boundaries(mesh._boundaries),
+            _textures(std::move(mesh._textures)),
+            _materialFeatures(mesh._materialFeatures)
     {
     }
 
-    void Mesh::attachTexture(Graphics::Texture* tex, GLenum textureNumber) {
+    void Mesh::attachTexture(const TextureHandle& tex, GLenum textureNumber) {
         _textures.insert({textureNumber, tex});
     }
 
     void Mesh::bindTextures() {
         for(auto& tex : _textures){
-            tex.second->bind(tex.first);
+            tex.second.bind(tex.first);
         }
     }
 
+    void Mesh::setMaterialFeatures(uint32_t features) {
+        _materialFeatures = features;
+    }
+
+    uint32_t Mesh::getMaterialFeatures() const {
+        return _materialFeatures;
+    }
+
     const std::vector<VertexDescriptor> &Mesh::getVertices() const {
         return _vertices;
     }
@@ -39,6 +55,14 @@ namespace Graphics
     }
 
 
+    const std::vector<uint16_t> &Mesh::getShortElementIndex() const {
+        return _shortElementIndex;
+    }
+
+    GLenum Mesh::getIndexType() const {
+        return !_elementIndex.empty() && _shortElementIndex.size() == _elementIndex.size() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
     int Mesh::getVertexCount() const {
         return _vertexCount;
     }
@@ -51,6 +75,20 @@ namespace Graphics
         _boundaries.compute(_vertices);
     }
 
+    void Mesh::optimize() {
+        float acmrBefore = MeshOptimizer::computeACMR(_elementIndex, _vertices.size());
+
+        MeshOptimizer::optimizeVertexCache(_elementIndex, _vertices.size());
+        MeshOptimizer::optimizeVertexFetch(_vertices, _elementIndex);
+
+        LOG(INFO) << "Mesh optimized: " << _vertices.size() << " vertices, ACMR " << acmrBefore
+                  << " -> " << MeshOptimizer::computeACMR(_elementIndex, _vertices.size());
+
+        _shortElementIndex.clear();
+        if(_vertices.size() <= size_t(std::numeric_limits<uint16_t>::max()) + 1)
+            _shortElementIndex.assign(_elementIndex.begin(), _elementIndex.end());
+    }
+
     Mesh Mesh::genCube() {
         Mesh mesh;
 
@@ -175,9 +213,9 @@ namespace Graphics
         mesh.addVertices(sphereVertices);
         mesh.addElementIndexes(sphereIds);
 
-        mesh._vertexCount = latitudeBands * longitudeBands * 6;
-        mesh._triangleCount = mesh._vertexCount * 2;
+        mesh.setTriangleCount(latitudeBands * longitudeBands * 2);
 
+        mesh.optimize();
         mesh.computeBoundingBox();
 
         return mesh;
@@ -205,7 +243,36 @@ namespace Graphics
 
     Mesh Mesh::loadMesh(const std::string &filePath) {
         Mesh mesh;
-        //TODO: load model with assimp
+        auto start = std::chrono::steady_clock::now();
+
+        MeshCache cache;
+        bool fromCache = cache.open(filePath);
+        if(fromCache){
+            // The cache holds the optimized mesh: only the 16 bits indexes are rebuilt
+            mesh._vertices.assign(cache.getVertices(), cache.getVertices() + cache.getVertexCount());
+            mesh._elementIndex.assign(cache.getIndices(), cache.getIndices() + cache.getIndexCount());
+            if(mesh._vertices.size() <= size_t(std::numeric_limits<uint16_t>::max()) + 1)
+                mesh._shortElementIndex.assign(mesh._elementIndex.begin(), mesh._elementIndex.end());
+        }
+        else{
+            MappedFile file(filePath);
+            MeshData data = ObjParser::parse(file.data(), file.size());
+            mesh._vertices = std::move(data.vertices);
+            mesh._elementIndex = std::move(data.indices);
+
+            mesh.optimize();
+
+            if(!MeshCache::write(filePath, hashBytes(file.data(), file.size()), mesh._vertices, mesh._elementIndex))
+                LOG(WARNING) << "Unable to write the mesh cache " << MeshCache::cachePath(filePath);
+        }
+
+        mesh.setTriangleCount(mesh._elementIndex.size() / 3);
+        mesh.computeBoundingBox();
+
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        LOG(INFO) << filePath << ": " << mesh._triangleCount << " triangles loaded from " << (fromCache ? "cache" : "OBJ")
+                  << " in " << duration.count() << " ms";
+
         return mesh;
     }
 
@@ -4,31 +4,130 @@
 
 #include "graphics/MeshInstance.h"
 #include "graphics/utils.h"
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace Graphics
 {
 
-    MeshInstance::MeshInstance(Mesh *referenceMesh) : _referenceMesh(referenceMesh) { }
+    /** Dirty ranges closer than this are uploaded together: one bigger copy costs less than another call */
+    static const size_t DIRTY_RANGE_MERGE_GAP = 16;
+
+    MeshInstance::MeshInstance(Mesh *referenceMesh) :
+        _referenceMesh(referenceMesh), _materialLayersDirty(false), _hierarchicalCulling(false), _clustersDirty(true), _uploadedCapacity(0) {
+        updateMeshBounds();
+    }
+
+    void MeshInstance::updateMeshBounds() {
+        const std::vector<glm::vec3>& points = _referenceMesh->getBoundingBox().getVector();
+        glm::vec3 localMin(0), localMax(0);
+        if(!points.empty()){
+            localMin = localMax = points[0];
+            for(auto& point : points){
+                localMin = glm::min(localMin, point);
+                localMax = glm::max(localMax, point);
+            }
+        }
+        _localCenter = 0.5f * (localMin + localMax);
+        _localExtent = 0.5f * (localMax - localMin);
+
+        for(size_t i = 0; i < _positions.size(); ++i)
+            updateInstance(i);
+        _clustersDirty = true;
+    }
+
+    void MeshInstance::insertInstances(size_t index, const Geometry::Transformation *transformations, size_t count) {
+        std::vector<glm::vec3> positions(count);
+        std::vector<glm::vec4> rotations(count);
+        for(size_t i = 0; i < count; ++i){
+            positions[i] = transformations[i].position;
+            rotations[i] = transformations[i].rotation;
+        }
+
+        _positions.insert(_positions.begin() + index, positions.begin(), positions.end());
+        _rotations.insert(_rotations.begin() + index, rotations.begin(), rotations.end());
+        _matrices.insert(_matrices.begin() + index, count, glm::mat4());
+        _materialLayers.insert(_materialLayers.begin() + index, count, 0.f);
+        _materialLayersDirty = true;
+        _centerX.insert(_centerX.begin() + index, count, 0.f);
+        _centerY.insert(_centerY.begin() + index, count, 0.f);
+        _centerZ.insert(_centerZ.begin() + index, count, 0.f);
+        _extentX.insert(_extentX.begin() + index, count, 0.f);
+        _extentY.insert(_extentY.begin() + index, count, 0.f);
+        _extentZ.insert(_extentZ.begin() + index, count, 0.f);
+
+        for(size_t i = index; i < index + count; ++i)
+            updateInstance(i);
+
+        // Following instances are shifted
+        markDirty(index, _positions.size());
+    }
+
+    void MeshInstance::updateInstance(size_t index) {
+        glm::mat4& matrix = _matrices[index];
+        matrix = Geometry::Transformation(_positions[index], _rotations[index]).getTransformationMatrix();
+
+        // Arvo: the world box of a transformed box is centered on the transformed center,
+        // each half size component being the sum of the local half sizes weighted by the absolute matrix coefficients
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(_localCenter, 1));
+        glm::vec3 extent;
+        for(int row = 0; row < 3; ++row)
+            extent[row] = std::abs(matrix[0][row]) * _localExtent.x + std::abs(matrix[1][row]) * _localExtent.y + std::abs(matrix[2][row]) * _localExtent.z;
+
+        _centerX[index] = center.x; _centerY[index] = center.y; _centerZ[index] = center.z;
+        _extentX[index] = extent.x; _extentY[index] = extent.y; _extentZ[index] = extent.z;
+    }
+
+    void MeshInstance::markDirty(size_t begin, size_t end) {
+        if(begin >= end)
+            return;
+
+        // Animating an instance usually touches it, or its neighbour, once per frame: extend the last range when possible
+        if(!_dirtyRanges.empty()){
+            std::pair<size_t, size_t>& last = _dirtyRanges.back();
+            if(begin <= last.second + DIRTY_RANGE_MERGE_GAP && end + DIRTY_RANGE_MERGE_GAP >= last.first){
+                last.first = std::min(last.first, begin);
+                last.second = std::max(last.second, end);
+                _clustersDirty = true;
+                return;
+            }
+        }
+
+        _dirtyRanges.push_back(std::make_pair(begin, end));
+        _clustersDirty = true;
+    }
 
     void MeshInstance::addInstance(const Geometry::Transformation &trans) {
-        _transformations.push_back(trans);
+        insertInstances(_positions.size(), &trans, 1);
     }
 
     void MeshInstance::addInstance(const std::vector<Geometry::Transformation> &transformations) {
-        _transformations.insert(_transformations.begin(), transformations.begin(), transformations.end());
+        insertInstances(0, transformations.data(), transformations.size());
     }
 
     void MeshInstance::addInstance(const std::vector<glm::vec3> &positions, const std::vector<glm::vec4> &rotations) {
         if(positions.size() != rotations.size())
             throw std::runtime_error("MeshInstance::addInstance : Trying to load position and rotation vector with different size");
 
+        std::vector<Geometry::Transformation> transformations;
+        transformations.reserve(positions.size());
         for(size_t i = 0; i < positions.size(); ++i)
-            _transformations.push_back(Geometry::Transformation(positions[i], rotations[i]));
+            transformations.push_back(Geometry::Transformation(positions[i], rotations[i]));
+
+        insertInstances(_positions.size(), transformations.data(), transformations.size());
     }
 
     void MeshInstance::addInstance(const std::vector<glm::vec3> &positions) {
+        std::vector<Geometry::Transformation> transformations;
+        transformations.reserve(positions.size());
         for(auto& position : positions)
-            _transformations.push_back(Geometry::Transformation(position));
+            transformations.push_back(Geometry::Transformation(position));
+
+        insertInstances(_positions.size(), transformations.data(), transformations.size());
     }
 
     void MeshInstance::addInstance(const glm::vec3 &position, const glm::vec4 &rotation) {
@@ -41,22 +140,203 @@ namespace Graphics
 
 
     const glm::vec3 &MeshInstance::getPosition(int index) {
-        return _transformations.at(index).position;
+        return _positions.at(index);
     }
 
     const glm::vec4 &MeshInstance::getRotation(int index) {
-        return _transformations.at(index).rotation;
+        return _rotations.at(index);
     }
 
     int MeshInstance::getInstanceNumber() {
-        return _transformations.size();
+        return _positions.size();
+    }
+
+    Geometry::Transformation MeshInstance::getTransformation(int index) const {
+        return Geometry::Transformation(_positions.at(index), _rotations.at(index));
+    }
+
+    const glm::mat4 &MeshInstance::getTransformationMatrix(int index) const {
+        return _matrices.at(index);
+    }
+
+    void MeshInstance::setPosition(int index, const glm::vec3 &position) {
+        _positions.at(index) = position;
+        updateInstance(index);
+        markDirty(index, index + 1);
+    }
+
+    void MeshInstance::setRotation(int index, const glm::vec4 &rotation) {
+        _rotations.at(index) = rotation;
+        updateInstance(index);
+        markDirty(index, index + 1);
     }
 
-    const Geometry::Transformation &MeshInstance::getTransformation(int index) const {
-        return _transformations.at(index);
+    void MeshInstance::setTransformation(int index, const Geometry::Transformation &trans) {
+        _positions.at(index) = trans.position;
+        _rotations[index] = trans.rotation;
+        updateInstance(index);
+        markDirty(index, index + 1);
     }
 
     Geometry::BoundingBox MeshInstance::getBoundingBox(int index) const {
-        return _transformations.at(index).getTransformationMatrix() * _referenceMesh->getBoundingBox();
+        return _matrices.at(index) * _referenceMesh->getBoundingBox();
+    }
+
+    void MeshInstance::setMaterialLayer(int index, int layer) {
+        _materialLayers.at(index) = static_cast<float>(layer);
+        _materialLayersDirty = true;
+    }
+
+    int MeshInstance::getMaterialLayer(int index) const {
+        return static_cast<int>(_materialLayers.at(index));
+    }
+
+    void MeshInstance::uploadMaterialLayers(VertexBufferObject &vbo) {
+        if(!_materialLayersDirty)
+            return;
+        vbo.updateData(_materialLayers);
+        _materialLayersDirty = false;
+    }
+
+    void MeshInstance::uploadTransformations(VertexBufferObject &vbo) {
+        if(_matrices.size() > _uploadedCapacity){
+            vbo.updateData(_matrices);
+            _uploadedCapacity = _matrices.size();
+            _dirtyRanges.clear();
+            return;
+        }
+
+        if(_dirtyRanges.empty())
+            return;
+
+        // Merge overlapping or close ranges so each byte is sent once, with as few calls as possible
+        std::sort(_dirtyRanges.begin(), _dirtyRanges.end());
+
+        size_t begin = _dirtyRanges[0].first;
+        size_t end = _dirtyRanges[0].second;
+        for(size_t r = 1; r <= _dirtyRanges.size(); ++r){
+            if(r < _dirtyRanges.size() && _dirtyRanges[r].first <= end + DIRTY_RANGE_MERGE_GAP){
+                end = std::max(end, _dirtyRanges[r].second);
+                continue;
+            }
+
+            end = std::min(end, _matrices.size());
+            if(begin < end)
+                vbo.updateData(_matrices, begin, end - begin);
+
+            if(r < _dirtyRanges.size()){
+                begin = _dirtyRanges[r].first;
+                end = _dirtyRanges[r].second;
+            }
+        }
+
+        _dirtyRanges.clear();
+    }
+
+    void MeshInstance::setHierarchicalCulling(bool enabled) {
+        _hierarchicalCulling = enabled;
+    }
+
+    void MeshInstance::buildClusters() {
+        _clusters.clear();
+
+        for(size_t begin = 0; begin < _positions.size(); begin += CLUSTER_SIZE){
+            size_t end = std::min(begin + CLUSTER_SIZE, _positions.size());
+
+            glm::vec3 min(_centerX[begin] - _extentX[begin], _centerY[begin] - _extentY[begin], _centerZ[begin] - _extentZ[begin]);
+            glm::vec3 max(_centerX[begin] + _extentX[begin], _centerY[begin] + _extentY[begin], _centerZ[begin] + _extentZ[begin]);
+            for(size_t i = begin + 1; i < end; ++i){
+                min = glm::min(min, glm::vec3(_centerX[i] - _extentX[i], _centerY[i] - _extentY[i], _centerZ[i] - _extentZ[i]));
+                max = glm::max(max, glm::vec3(_centerX[i] + _extentX[i], _centerY[i] + _extentY[i], _centerZ[i] + _extentZ[i]));
+            }
+
+            _clusters.push_back(Cluster{0.5f * (min + max), 0.5f * (max - min)});
+        }
+
+        _clustersDirty = false;
+    }
+
+    void MeshInstance::cull(const Geometry::Frustum &frustum, std::vector<glm::vec3> &visiblePositions, std::vector<glm::vec4> &visibleRotations) {
+        if(!_hierarchicalCulling){
+            cullRange(frustum, 0, _positions.size(), visiblePositions, visibleRotations);
+            return;
+        }
+
+        if(_clustersDirty)
+            buildClusters();
+
+        for(size_t c = 0; c < _clusters.size(); ++c){
+            const Cluster& cluster = _clusters[c];
+            if(!frustum.intersects(cluster.center, cluster.extent))
+                continue;
+
+            size_t begin = c * CLUSTER_SIZE;
+            size_t end = std::min(begin + CLUSTER_SIZE, _positions.size());
+
+            if(frustum.contains(cluster.center, cluster.extent)){
+                visiblePositions.insert(visiblePositions.end(), _positions.begin() + begin, _positions.begin() + end);
+                visibleRotations.insert(visibleRotations.end(), _rotations.begin() + begin, _rotations.begin() + end);
+            }
+            else
+                cullRange(frustum, begin, end, visiblePositions, visibleRotations);
+        }
+    }
+
+    void MeshInstance::cullRange(const Geometry::Frustum &frustum, size_t begin, size_t end,
+                                 std::vector<glm::vec3> &visiblePositions, std::vector<glm::vec4> &visibleRotations) const {
+        // A box is outside when it lies entirely behind one of the planes:
+        // dot(n, center) + d + dot(|n|, extent) < 0
+        size_t i = begin;
+
+#if defined(__SSE2__)
+        __m128 planeX[Geometry::Frustum::PLANE_COUNT], planeY[Geometry::Frustum::PLANE_COUNT], planeZ[Geometry::Frustum::PLANE_COUNT];
+        __m128 planeW[Geometry::Frustum::PLANE_COUNT];
+        __m128 absPlaneX[Geometry::Frustum::PLANE_COUNT], absPlaneY[Geometry::Frustum::PLANE_COUNT], absPlaneZ[Geometry::Frustum::PLANE_COUNT];
+        for(int p = 0; p < Geometry::Frustum::PLANE_COUNT; ++p){
+            const glm::vec4& plane = frustum.planes[p];
+            planeX[p] = _mm_set1_ps(plane.x);
+            planeY[p] = _mm_set1_ps(plane.y);
+            planeZ[p] = _mm_set1_ps(plane.z);
+            planeW[p] = _mm_set1_ps(plane.w);
+            absPlaneX[p] = _mm_set1_ps(std::abs(plane.x));
+            absPlaneY[p] = _mm_set1_ps(std::abs(plane.y));
+            absPlaneZ[p] = _mm_set1_ps(std::abs(plane.z));
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        // 4 instances per iteration
+        for(; i + 4 <= end; i += 4){
+            __m128 cx = _mm_loadu_ps(&_centerX[i]);
+            __m128 cy = _mm_loadu_ps(&_centerY[i]);
+            __m128 cz = _mm_loadu_ps(&_centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&_extentX[i]);
+            __m128 ey = _mm_loadu_ps(&_extentY[i]);
+            __m128 ez = _mm_loadu_ps(&_extentZ[i]);
+
+            __m128 visible = _mm_cmpeq_ps(zero, zero);
+            for(int p = 0; p < Geometry::Frustum::PLANE_COUNT; ++p){
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], ex), _mm_mul_ps(absPlaneY[p], ey)),
+                                           _mm_mul_ps(absPlaneZ[p], ez));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+            }
+
+            int mask = _mm_movemask_ps(visible);
+            for(int k = 0; k < 4; ++k){
+                if(mask & (1 << k)){
+                    visiblePositions.push_back(_positions[i + k]);
+                    visibleRotations.push_back(_rotations[i + k]);
+                }
+            }
+        }
+#endif
+
+        for(; i < end; ++i){
+            if(frustum.intersects(glm::vec3(_centerX[i], _centerY[i], _centerZ[i]), glm::vec3(_extentX[i], _extentY[i], _extentZ[i]))){
+                visiblePositions.push_back(_positions[i]);
+                visibleRotations.push_back(_rotations[i]);
+            }
+        }
     }
-}
\ No newline at end of file
+}
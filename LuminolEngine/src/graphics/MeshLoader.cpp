@@ -0,0 +1,531 @@
+#include "graphics/MeshLoader.hpp"
+#include "graphics/ThreadPool.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace Graphics;
+
+namespace {
+
+    /** Below this size a chunk is not worth a task */
+    const size_t MIN_CHUNK_SIZE = 1 << 20;
+    /** Vertices built per task */
+    const int VERTEX_GRAIN = 4096;
+
+    /** Index of a missing texcoord or normal */
+    const int NO_INDEX = -1;
+
+    struct ObjCorner{
+        int position, texcoord, normal;
+
+        bool operator==(const ObjCorner& other) const {
+            return position == other.position && texcoord == other.texcoord && normal == other.normal;
+        }
+    };
+
+    enum RelativeBits{
+        RELATIVE_POSITION = 1,
+        RELATIVE_TEXCOORD = 2,
+        RELATIVE_NORMAL = 4
+    };
+
+    /** Corner with indices counted from the end of its chunk, to be offset by the sizes of the previous chunks */
+    struct ObjRelativeCorner{
+        size_t corner;
+        int mask;
+    };
+
+    /** What a single task reads from its part of the file */
+    struct ObjChunk{
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texcoords;
+        std::vector<glm::vec3> normals;
+        std::vector<ObjCorner> corners; /** Three per triangle */
+        std::vector<ObjRelativeCorner> relativeCorners;
+        std::string error; /** Exceptions can't leave a worker thread: the first error is kept and thrown by the caller */
+    };
+
+    inline bool isBlank(char c){
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool isDigit(char c){
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline const char* skipBlanks(const char* p, const char* end){
+        while(p < end && isBlank(*p))
+            ++p;
+        return p;
+    }
+
+    inline const char* skipLine(const char* p, const char* end){
+        const char* newLine = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return newLine ? newLine + 1 : end;
+    }
+
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /** Locale independent strtof, precise enough for vertex attributes. Returns nullptr if no number starts at p */
+    const char* parseFloat(const char* p, const char* end, float& value){
+        p = skipBlanks(p, end);
+
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+')){
+            negative = *p == '-';
+            ++p;
+        }
+
+        // Digits past the precision of the mantissa only move the exponent
+        const uint64_t mantissaLimit = 100000000000000000ull;
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        bool hasDigits = false;
+
+        for(; p < end && isDigit(*p); ++p){
+            hasDigits = true;
+            if(mantissa < mantissaLimit)
+                mantissa = mantissa * 10 + (*p - '0');
+            else
+                ++exponent;
+        }
+
+        if(p < end && *p == '.'){
+            for(++p; p < end && isDigit(*p); ++p){
+                hasDigits = true;
+                if(mantissa < mantissaLimit){
+                    mantissa = mantissa * 10 + (*p - '0');
+                    --exponent;
+                }
+            }
+        }
+
+        if(!hasDigits)
+            return nullptr;
+
+        if(p < end && (*p == 'e' || *p == 'E')){
+            const char* q = p + 1;
+            bool negativeExponent = false;
+            if(q < end && (*q == '-' || *q == '+')){
+                negativeExponent = *q == '-';
+                ++q;
+            }
+
+            if(q < end && isDigit(*q)){
+                int e = 0;
+                for(; q < end && isDigit(*q); ++q)
+                    e = std::min(e * 10 + (*q - '0'), 1000);
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if(exponent < 0)
+            result = -exponent <= 22 ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+        else if(exponent > 0)
+            result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    /** Parse a signed integer. Returns nullptr if no integer starts at p */
+    const char* parseIndex(const char* p, const char* end, int& value){
+        bool negative = false;
+        if(p < end && *p == '-'){
+            negative = true;
+            ++p;
+        }
+
+        if(p >= end || !isDigit(*p))
+            return nullptr;
+
+        int result = 0;
+        for(; p < end && isDigit(*p); ++p)
+            result = result * 10 + (*p - '0');
+
+        value = negative ? -result : result;
+        return p;
+    }
+
+    /** Parse "p", "p/t", "p//n" or "p/t/n". Missing indices are left to 0, which OBJ never uses */
+    const char* parseCorner(const char* p, const char* end, int (&raw)[3]){
+        raw[0] = raw[1] = raw[2] = 0;
+
+        p = parseIndex(p, end, raw[0]);
+        if(!p || p >= end || *p != '/')
+            return p;
+
+        ++p;
+        if(p < end && *p != '/'){
+            p = parseIndex(p, end, raw[1]);
+            if(!p)
+                return nullptr;
+        }
+
+        if(p < end && *p == '/'){
+            p = parseIndex(p + 1, end, raw[2]);
+        }
+        return p;
+    }
+
+    /** 1-based OBJ index to a 0-based one. Relative indices are kept relative to the chunk and flagged in mask */
+    inline int resolveIndex(int raw, size_t chunkCount, int bit, int& mask){
+        if(raw > 0)
+            return raw - 1;
+        if(raw < 0){
+            mask |= bit;
+            return static_cast<int>(chunkCount) + raw;
+        }
+        return NO_INDEX;
+    }
+
+    template<typename T, int N>
+    const char* parseVector(const char* p, const char* end, std::vector<T>& values){
+        T value;
+        for(int i = 0; i < N; ++i){
+            p = parseFloat(p, end, value[i]);
+            if(!p)
+                return nullptr;
+        }
+        values.push_back(value);
+        return p;
+    }
+
+    void parseChunk(const char* p, const char* end, ObjChunk& chunk){
+        std::vector<ObjCorner> polygon;
+        std::vector<int> polygonMasks;
+
+        while(p < end){
+            p = skipBlanks(p, end);
+
+            if(end - p > 2 && p[0] == 'v'){
+                const char* ok = p;
+                if(isBlank(p[1]))
+                    ok = parseVector<glm::vec3, 3>(p + 2, end, chunk.positions);
+                else if(p[1] == 't' && isBlank(p[2]))
+                    ok = parseVector<glm::vec2, 2>(p + 3, end, chunk.texcoords);
+                else if(p[1] == 'n' && isBlank(p[2]))
+                    ok = parseVector<glm::vec3, 3>(p + 3, end, chunk.normals);
+
+                if(!ok){
+                    chunk.error = "malformed vertex attribute";
+                    return;
+                }
+            }
+            else if(end - p > 1 && p[0] == 'f' && isBlank(p[1])){
+                polygon.clear();
+                polygonMasks.clear();
+
+                for(p = skipBlanks(p + 2, end); p < end && *p != '\n' && *p != '\r' && *p != '#'; p = skipBlanks(p, end)){
+                    int raw[3];
+                    p = parseCorner(p, end, raw);
+                    if(!p || raw[0] == 0){
+                        chunk.error = "malformed face";
+                        return;
+                    }
+
+                    int mask = 0;
+                    ObjCorner corner;
+                    corner.position = resolveIndex(raw[0], chunk.positions.size(), RELATIVE_POSITION, mask);
+                    corner.texcoord = resolveIndex(raw[1], chunk.texcoords.size(), RELATIVE_TEXCOORD, mask);
+                    corner.normal = resolveIndex(raw[2], chunk.normals.size(), RELATIVE_NORMAL, mask);
+                    polygon.push_back(corner);
+                    polygonMasks.push_back(mask);
+                }
+
+                // Fan triangulation
+                for(size_t i = 2; i < polygon.size(); ++i){
+                    const size_t triangle[3] = {0, i - 1, i};
+                    for(size_t corner : triangle){
+                        if(polygonMasks[corner])
+                            chunk.relativeCorners.push_back({chunk.corners.size(), polygonMasks[corner]});
+                        chunk.corners.push_back(polygon[corner]);
+                    }
+                }
+
+                if(p >= end)
+                    break;
+            }
+
+            p = skipLine(p, end);
+        }
+    }
+
+    inline size_t hashCorner(const ObjCorner& corner){
+        uint64_t h = static_cast<uint32_t>(corner.position) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint32_t>(corner.texcoord) * 0xC2B2AE3D27D4EB4Full;
+        h ^= static_cast<uint32_t>(corner.normal) * 0x165667B19E3779F9ull;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+
+    inline bool isInRange(int index, size_t count, bool optional){
+        return (optional && index == NO_INDEX) || (index >= 0 && static_cast<size_t>(index) < count);
+    }
+
+    const char MESH_CACHE_MAGIC[4] = {'L', 'M', 'S', 'H'};
+    const uint32_t MESH_CACHE_VERSION = 2;
+
+    /** Followed by the vertices then the indexes. sourceHash lets a touched but unchanged OBJ keep its cache */
+    struct MeshCacheHeader{
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceModificationTime;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t sourceHash;
+    };
+
+    static_assert(sizeof(MeshCacheHeader) == 48, "MeshCacheHeader must not be padded");
+    static_assert(sizeof(VertexDescriptor) == 8 * sizeof(float), "VertexDescriptor is written as is in the mesh cache");
+}
+
+MeshData ObjParser::parse(const char *text, size_t size) {
+    ThreadPool& pool = ThreadPool::global();
+
+    // A few chunks per thread so that a slow one does not hold the others; boundaries are moved to the next line start
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / MIN_CHUNK_SIZE, (pool.size() + 1) * 4));
+    std::vector<size_t> bounds(chunkCount + 1, size);
+    bounds[0] = 0;
+    for(size_t c = 1; c < chunkCount; ++c){
+        size_t bound = std::max(bounds[c - 1], size * c / chunkCount);
+        while(bound < size && bound > 0 && text[bound - 1] != '\n')
+            ++bound;
+        bounds[c] = bound;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    pool.parallelFor(0, chunkCount, 1, [&](int first, int last){
+        for(int c = first; c < last; ++c)
+            parseChunk(text + bounds[c], text + bounds[c + 1], chunks[c]);
+    });
+
+    for(auto& chunk : chunks){
+        if(!chunk.error.empty())
+            throw std::runtime_error("OBJ: " + chunk.error);
+    }
+
+    // Place of each chunk in the whole file arrays
+    std::vector<size_t> positionOffsets(chunkCount + 1, 0), texcoordOffsets(chunkCount + 1, 0);
+    std::vector<size_t> normalOffsets(chunkCount + 1, 0), cornerOffsets(chunkCount + 1, 0);
+    for(size_t c = 0; c < chunkCount; ++c){
+        positionOffsets[c + 1] = positionOffsets[c] + chunks[c].positions.size();
+        texcoordOffsets[c + 1] = texcoordOffsets[c] + chunks[c].texcoords.size();
+        normalOffsets[c + 1] = normalOffsets[c] + chunks[c].normals.size();
+        cornerOffsets[c + 1] = cornerOffsets[c] + chunks[c].corners.size();
+    }
+
+    std::vector<glm::vec3> positions(positionOffsets[chunkCount]);
+    std::vector<glm::vec2> texcoords(texcoordOffsets[chunkCount]);
+    std::vector<glm::vec3> normals(normalOffsets[chunkCount]);
+    std::vector<ObjCorner> corners(cornerOffsets[chunkCount]);
+
+    pool.parallelFor(0, chunkCount, 1, [&](int first, int last){
+        for(int c = first; c < last; ++c){
+            ObjChunk& chunk = chunks[c];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[c]);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + texcoordOffsets[c]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffsets[c]);
+
+            for(auto& relative : chunk.relativeCorners){
+                ObjCorner& corner = chunk.corners[relative.corner];
+                if(relative.mask & RELATIVE_POSITION)
+                    corner.position += positionOffsets[c];
+                if(relative.mask & RELATIVE_TEXCOORD)
+                    corner.texcoord += texcoordOffsets[c];
+                if(relative.mask & RELATIVE_NORMAL)
+                    corner.normal += normalOffsets[c];
+            }
+
+            for(auto& corner : chunk.corners){
+                if(!isInRange(corner.position, positions.size(), false)
+                   || !isInRange(corner.texcoord, texcoords.size(), true)
+                   || !isInRange(corner.normal, normals.size(), true)){
+                    chunk.error = "face index out of range";
+                    break;
+                }
+            }
+
+            std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + cornerOffsets[c]);
+        }
+    });
+
+    for(auto& chunk : chunks){
+        if(!chunk.error.empty())
+            throw std::runtime_error("OBJ: " + chunk.error);
+    }
+    std::vector<ObjChunk>().swap(chunks);
+
+    MeshData data;
+    data.indices.resize(corners.size());
+
+    // Corners sharing the same attributes become a single vertex
+    std::vector<ObjCorner> uniqueCorners;
+    if(texcoords.empty() && normals.empty()){
+        uniqueCorners.resize(positions.size());
+        for(size_t i = 0; i < positions.size(); ++i)
+            uniqueCorners[i] = {static_cast<int>(i), NO_INDEX, NO_INDEX};
+        for(size_t i = 0; i < corners.size(); ++i)
+            data.indices[i] = corners[i].position;
+    }
+    else{
+        // Open addressing, at most half full
+        size_t capacity = 1;
+        while(capacity < 2 * corners.size())
+            capacity <<= 1;
+        const size_t mask = capacity - 1;
+        std::vector<int> table(capacity, -1);
+
+        uniqueCorners.reserve(corners.size() / 4);
+        for(size_t i = 0; i < corners.size(); ++i){
+            const ObjCorner& corner = corners[i];
+            size_t slot = hashCorner(corner) & mask;
+            while(table[slot] != -1 && !(uniqueCorners[table[slot]] == corner))
+                slot = (slot + 1) & mask;
+
+            if(table[slot] == -1){
+                table[slot] = static_cast<int>(uniqueCorners.size());
+                uniqueCorners.push_back(corner);
+            }
+            data.indices[i] = table[slot];
+        }
+    }
+
+    // Missing normals are smoothed over the triangles sharing a position, whatever their texcoords
+    std::vector<glm::vec3> generatedNormals;
+    bool needsNormals = std::any_of(uniqueCorners.begin(), uniqueCorners.end(), [](const ObjCorner& corner){ return corner.normal == NO_INDEX; });
+    if(needsNormals){
+        generatedNormals.assign(positions.size(), glm::vec3(0.f));
+        for(size_t i = 0; i + 2 < corners.size(); i += 3){
+            const glm::vec3& a = positions[corners[i].position];
+            const glm::vec3& b = positions[corners[i + 1].position];
+            const glm::vec3& c = positions[corners[i + 2].position];
+            // Not normalized: larger triangles weigh more
+            glm::vec3 faceNormal = glm::cross(b - a, c - a);
+            generatedNormals[corners[i].position] += faceNormal;
+            generatedNormals[corners[i + 1].position] += faceNormal;
+            generatedNormals[corners[i + 2].position] += faceNormal;
+        }
+    }
+
+    data.vertices.resize(uniqueCorners.size());
+    pool.parallelFor(0, uniqueCorners.size(), VERTEX_GRAIN, [&](int first, int last){
+        for(int v = first; v < last; ++v){
+            const ObjCorner& corner = uniqueCorners[v];
+            VertexDescriptor& vertex = data.vertices[v];
+            vertex.position = positions[corner.position];
+            vertex.texcoord = corner.texcoord != NO_INDEX ? texcoords[corner.texcoord] : glm::vec2(0.f);
+
+            if(corner.normal != NO_INDEX){
+                vertex.normal = normals[corner.normal];
+            }
+            else{
+                const glm::vec3& sum = generatedNormals[corner.position];
+                float length = glm::length(sum);
+                vertex.normal = length > 0.f ? sum / length : glm::vec3(0.f, 1.f, 0.f);
+            }
+        }
+    });
+
+    return data;
+}
+
+MeshCache::MeshCache(): _vertices(nullptr), _indices(nullptr), _vertexCount(0), _indexCount(0) {}
+
+bool MeshCache::open(const std::string &sourcePath) {
+    _file.close();
+    _vertices = nullptr;
+    _indices = nullptr;
+    _vertexCount = _indexCount = 0;
+
+    FileStamp sourceStamp;
+    if(!FileStamp::get(sourcePath, sourceStamp) || !_file.open(cachePath(sourcePath)))
+        return false;
+
+    MeshCacheHeader header;
+    if(_file.size() < sizeof(header)){
+        _file.close();
+        return false;
+    }
+    std::memcpy(&header, _file.data(), sizeof(header));
+
+    size_t expectedSize = sizeof(header) + header.vertexCount * sizeof(VertexDescriptor) + header.indexCount * sizeof(int);
+    if(std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != MESH_CACHE_VERSION
+       || _file.size() != expectedSize){
+        _file.close();
+        return false;
+    }
+
+    // The modification time only has a one second resolution: on any stamp change the content decides
+    if(header.sourceSize != sourceStamp.size || header.sourceModificationTime != sourceStamp.modificationTime){
+        MappedFile source;
+        if(!source.open(sourcePath) || hashBytes(source.data(), source.size()) != header.sourceHash){
+            _file.close();
+            return false;
+        }
+
+        // Store the new stamp so that the next start does not hash again
+        std::fstream file(cachePath(sourcePath), std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offsetof(MeshCacheHeader, sourceSize));
+        file.write(reinterpret_cast<const char*>(&sourceStamp.size), sizeof(sourceStamp.size));
+        file.write(reinterpret_cast<const char*>(&sourceStamp.modificationTime), sizeof(sourceStamp.modificationTime));
+    }
+
+    _vertexCount = header.vertexCount;
+    _indexCount = header.indexCount;
+    _vertices = reinterpret_cast<const VertexDescriptor*>(_file.data() + sizeof(header));
+    _indices = reinterpret_cast<const int*>(_file.data() + sizeof(header) + _vertexCount * sizeof(VertexDescriptor));
+    return true;
+}
+
+const VertexDescriptor *MeshCache::getVertices() const {
+    return _vertices;
+}
+
+size_t MeshCache::getVertexCount() const {
+    return _vertexCount;
+}
+
+const int *MeshCache::getIndices() const {
+    return _indices;
+}
+
+size_t MeshCache::getIndexCount() const {
+    return _indexCount;
+}
+
+std::string MeshCache::cachePath(const std::string &sourcePath) {
+    return sourcePath + ".lmesh";
+}
+
+bool MeshCache::write(const std::string &sourcePath, uint64_t sourceHash, const std::vector<VertexDescriptor> &vertices,
+                      const std::vector<int> &indices) {
+    FileStamp sourceStamp;
+    if(!FileStamp::get(sourcePath, sourceStamp))
+        return false;
+
+    MeshCacheHeader header;
+    std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.sourceSize = sourceStamp.size;
+    header.sourceModificationTime = sourceStamp.modificationTime;
+    header.vertexCount = vertices.size();
+    header.indexCount = indices.size();
+    header.sourceHash = sourceHash;
+
+    return writeFileAtomically(cachePath(sourcePath), {{&header, sizeof(header)},
+                                                        {vertices.data(), vertices.size() * sizeof(VertexDescriptor)},
+                                                        {indices.data(), indices.size() * sizeof(int)}});
+}
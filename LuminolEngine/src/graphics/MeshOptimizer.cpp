@@ -0,0 +1,194 @@
+#include "graphics/MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace Graphics;
+
+namespace {
+
+    // Forsyth's tuning: https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+    const unsigned int MAX_CACHE_SIZE = 64;
+    const unsigned int MAX_VALENCE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    /** Score of a vertex from its position in the simulated LRU cache and the number of triangles still using it, as tables */
+    struct VertexScores{
+        float cache[MAX_CACHE_SIZE + 3];
+        float valence[MAX_VALENCE + 1];
+
+        explicit VertexScores(unsigned int cacheSize){
+            for(unsigned int position = 0; position < cacheSize + 3; ++position){
+                // The three vertices of the last triangle get the same score, so that its triangle neighbours are not favoured over others
+                if(position < 3)
+                    cache[position] = LAST_TRIANGLE_SCORE;
+                else if(position < cacheSize)
+                    cache[position] = std::pow(1.f - float(position - 3) / float(cacheSize - 3), CACHE_DECAY_POWER);
+                else
+                    cache[position] = 0.f;
+            }
+
+            // Vertices with few triangles left are boosted, to get rid of them and avoid leaving lone triangles behind
+            valence[0] = -1.f;
+            for(unsigned int count = 1; count <= MAX_VALENCE; ++count)
+                valence[count] = VALENCE_BOOST_SCALE * std::pow(float(count), -VALENCE_BOOST_POWER);
+        }
+
+        float get(int cachePosition, int remainingTriangles) const {
+            if(remainingTriangles == 0)
+                return -1.f;
+            float score = valence[std::min<unsigned int>(remainingTriangles, MAX_VALENCE)];
+            return cachePosition >= 0 ? score + cache[cachePosition] : score;
+        }
+    };
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<int> &indices, size_t vertexCount, unsigned int cacheSize) {
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+        return;
+
+    cacheSize = std::max(4u, std::min(cacheSize, MAX_CACHE_SIZE));
+    const VertexScores scores(cacheSize);
+
+    // Triangles using each vertex. The first remainingTriangles[v] entries of a vertex are the ones not emitted yet
+    std::vector<int> remainingTriangles(vertexCount, 0);
+    for(int index : indices)
+        ++remainingTriangles[index];
+
+    std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+    for(size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(size_t t = 0; t < triangleCount; ++t){
+        for(int k = 0; k < 3; ++k)
+            adjacency[fill[indices[3 * t + k]]++] = t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = scores.get(-1, remainingTriangles[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for(size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+
+    std::vector<int> cache, newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    std::vector<int> result;
+    result.reserve(indices.size());
+
+    int best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t scanCursor = 0;
+
+    while(true){
+        // No triangle left around the cache: restart from the first one not emitted, as Forsyth's full rescan would rarely do better
+        if(best < 0){
+            while(scanCursor < triangleCount && emitted[scanCursor])
+                ++scanCursor;
+            if(scanCursor == triangleCount)
+                break;
+            best = scanCursor;
+        }
+
+        emitted[best] = true;
+        const int* triangle = &indices[3 * best];
+
+        newCache.clear();
+        for(int k = 0; k < 3; ++k){
+            int v = triangle[k];
+            result.push_back(v);
+
+            int* first = &adjacency[adjacencyOffsets[v]];
+            int* last = first + remainingTriangles[v];
+            std::iter_swap(std::find(first, last, best), last - 1);
+            --remainingTriangles[v];
+
+            if(std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        for(int v : cache){
+            if(std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        // Update the scores of the vertices in the cache or pushed out of it, and of their remaining triangles
+        for(size_t i = 0; i < newCache.size(); ++i){
+            int v = newCache[i];
+            cachePosition[v] = i < cacheSize ? i : -1;
+
+            float score = scores.get(cachePosition[v], remainingTriangles[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for(int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remainingTriangles[v]; ++a)
+                triangleScore[adjacency[a]] += delta;
+        }
+
+        if(newCache.size() > cacheSize)
+            newCache.resize(cacheSize);
+
+        best = -1;
+        float bestScore = -1.f;
+        for(int v : newCache){
+            for(int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remainingTriangles[v]; ++a){
+                int t = adjacency[a];
+                if(triangleScore[t] > bestScore){
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        cache.swap(newCache);
+    }
+
+    // Trailing indices of an incomplete triangle are kept
+    result.insert(result.end(), indices.begin() + 3 * triangleCount, indices.end());
+    indices.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<VertexDescriptor> &vertices, std::vector<int> &indices) {
+    std::vector<int> remap(vertices.size(), -1);
+    std::vector<VertexDescriptor> reordered;
+    reordered.reserve(vertices.size());
+
+    for(int& index : indices){
+        if(remap[index] < 0){
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+}
+
+float MeshOptimizer::computeACMR(const std::vector<int> &indices, size_t vertexCount, unsigned int cacheSize) {
+    const size_t triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+        return 0.f;
+
+    // A vertex is in the FIFO if fewer than cacheSize vertices were loaded since its own load
+    std::vector<unsigned int> loadTime(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+
+    for(int index : indices){
+        if(time - loadTime[index] > cacheSize){
+            loadTime[index] = time++;
+            ++misses;
+        }
+    }
+
+    return float(misses) / float(triangleCount);
+}
@@ -0,0 +1,178 @@
+#include "graphics/ProgramCache.hpp"
+#include "graphics/MappedFile.hpp"
+#include <cstdio>
+#include <cstring>
+#include <glog/logging.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+using namespace Graphics;
+
+namespace {
+
+    const char PROGRAM_CACHE_MAGIC[4] = {'L', 'P', 'R', 'G'};
+    const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    struct ProgramCacheHeader{
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binarySize;
+    };
+
+    uint64_t hashGlString(GLenum name, uint64_t hash){
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        if(!value)
+            return hash;
+        // The terminating null separates the strings
+        return hashBytes(value, std::strlen(value) + 1, hash);
+    }
+
+    bool makeDirectory(const std::string& path){
+#if defined(_WIN32)
+        int status = _mkdir(path.c_str());
+#else
+        int status = mkdir(path.c_str(), 0755);
+#endif
+        struct stat info;
+        return status == 0 || (stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR));
+    }
+}
+
+const char* const ProgramCache::DEFAULT_DIRECTORY = "shader_cache";
+
+std::unique_ptr<ProgramCache> ProgramCache::_global;
+
+ProgramCache::ProgramCache(const std::string &directory):
+    _directory(directory), _driverHash(HASH_BYTES_SEED), _isSupported(GLEW_ARB_get_program_binary), _isDirectoryCreated(false) {
+
+    _driverHash = hashGlString(GL_VENDOR, _driverHash);
+    _driverHash = hashGlString(GL_RENDERER, _driverHash);
+    _driverHash = hashGlString(GL_VERSION, _driverHash);
+
+    if(_isSupported){
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        _isSupported = formatCount > 0;
+    }
+
+    // Let the driver use as many threads as it likes.
+    // The extensions are only known to GLEW 2.0 (ARB) and 2.1 (KHR): with older headers shaders compile serially
+#if defined(GL_KHR_parallel_shader_compile)
+    if(GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+#endif
+#if defined(GL_ARB_parallel_shader_compile)
+    if(GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xffffffff);
+#endif
+}
+
+std::string ProgramCache::cachePath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.lprog", static_cast<unsigned long long>(key));
+    return _directory + "/" + name;
+}
+
+uint64_t ProgramCache::key(const std::vector<ShaderSource> &sources) const {
+    uint64_t hash = _driverHash;
+    for(const ShaderSource& source : sources){
+        hash = hashBytes(&source.type, sizeof(source.type), hash);
+        hash = hashBytes(source.code, std::strlen(source.code) + 1, hash);
+    }
+    return hash;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key) {
+    if(!_isSupported)
+        return false;
+
+    MappedFile file;
+    if(!file.open(cachePath(key)))
+        return false;
+
+    ProgramCacheHeader header;
+    if(file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != PROGRAM_CACHE_VERSION
+       || header.key != key || file.size() - sizeof(header) < header.binarySize)
+        return false;
+
+    glProgramBinary(program, header.binaryFormat, file.data() + sizeof(header), header.binarySize);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE){
+        LOG(INFO) << "ProgramCache: binary " << cachePath(key) << " refused by the driver, the program is rebuilt";
+        return false;
+    }
+    return true;
+}
+
+bool ProgramCache::save(GLuint program, uint64_t key) {
+    if(!_isSupported)
+        return false;
+
+    GLint binarySize = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if(binarySize <= 0)
+        return false;
+
+    std::vector<char> binary(binarySize);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+    if(!_isDirectoryCreated){
+        _isDirectoryCreated = makeDirectory(_directory);
+        if(!_isDirectoryCreated){
+            LOG(WARNING) << "ProgramCache: unable to create " << _directory << ", programs are not cached";
+            _isSupported = false;
+            return false;
+        }
+    }
+
+    ProgramCacheHeader header;
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.binaryFormat = binaryFormat;
+    header.binarySize = static_cast<uint32_t>(binarySize);
+
+    return writeFileAtomically(cachePath(key), {{&header, sizeof(header)}, {binary.data(), static_cast<size_t>(binarySize)}});
+}
+
+void ProgramCache::prepare(GLuint program) const {
+    if(_isSupported)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramCache::isSupported() const {
+    return _isSupported;
+}
+
+bool ProgramCache::isParallelCompileSupported() {
+    bool isSupported = false;
+#if defined(GL_KHR_parallel_shader_compile)
+    isSupported = isSupported || GLEW_KHR_parallel_shader_compile;
+#endif
+#if defined(GL_ARB_parallel_shader_compile)
+    isSupported = isSupported || GLEW_ARB_parallel_shader_compile;
+#endif
+    return isSupported;
+}
+
+ProgramCache &ProgramCache::global() {
+    if(!_global)
+        _global.reset(new ProgramCache());
+    return *_global;
+}
+
+void ProgramCache::releaseGlobal() {
+    _global.reset();
+}
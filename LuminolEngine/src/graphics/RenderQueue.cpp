@@ -0,0 +1,120 @@
+#include "graphics/RenderQueue.hpp"
+#include "graphics/GLState.hpp"
+#include <algorithm>
+
+using namespace Graphics;
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, uint8_t state, uint32_t material, float depth) {
+    const uint32_t DEPTH_MAX = (1u << MATERIAL_SHIFT) - 1;
+
+    depth = std::min(std::max(depth, 0.f), 1.f);
+    uint32_t quantizedDepth = static_cast<uint32_t>(depth * DEPTH_MAX);
+    if(pass == RENDER_PASS_TRANSPARENT)
+        quantizedDepth = DEPTH_MAX - quantizedDepth;
+
+    return (uint64_t(pass & 0xf) << PASS_SHIFT)
+         | (uint64_t(program & 0xffff) << PROGRAM_SHIFT)
+         | (uint64_t(state & 0xf) << STATE_SHIFT)
+         | (uint64_t(material & 0xffff) << MATERIAL_SHIFT)
+         | quantizedDepth;
+}
+
+void RenderQueue::submit(const RenderPacket &packet) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _packets.push_back(packet);
+}
+
+void RenderQueue::submit(const RenderPacket *packets, size_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _packets.insert(_packets.end(), packets, packets + count);
+}
+
+void RenderQueue::sortEntries() {
+    size_t count = _entries.size();
+    if(count < 2)
+        return;
+
+    // Histograms of the 8 bytes in a single read of the keys
+    uint32_t histograms[8][256] = {};
+    for(const SortEntry& entry : _entries){
+        for(int byte = 0; byte < 8; ++byte)
+            ++histograms[byte][(entry.key >> (8 * byte)) & 0xff];
+    }
+
+    _sorted.resize(count);
+    for(int byte = 0; byte < 8; ++byte){
+        uint32_t* histogram = histograms[byte];
+        if(histogram[(_entries.front().key >> (8 * byte)) & 0xff] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for(int value = 0; value < 256; ++value){
+            uint32_t valueCount = histogram[value];
+            histogram[value] = offset;
+            offset += valueCount;
+        }
+
+        for(const SortEntry& entry : _entries)
+            _sorted[histogram[(entry.key >> (8 * byte)) & 0xff]++] = entry;
+        _entries.swap(_sorted);
+    }
+}
+
+void RenderQueue::execute() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _executed.swap(_packets);
+    }
+    if(_executed.empty())
+        return;
+
+    _entries.resize(_executed.size());
+    for(size_t i = 0; i < _executed.size(); ++i){
+        _entries[i].key = _executed[i].key;
+        _entries[i].index = static_cast<uint32_t>(i);
+    }
+    sortEntries();
+
+    GLState& state = GLState::global();
+    for(const SortEntry& entry : _entries){
+        const RenderPacket& packet = _executed[entry.index];
+
+        state.useProgram(packet.program);
+        state.bindVertexArray(packet.vertexArray);
+        state.setEnabled(GL_DEPTH_TEST, (packet.state & RENDER_DEPTH_TEST) != 0);
+        state.setEnabled(GL_BLEND, (packet.state & RENDER_BLEND) != 0);
+        state.polygonMode(packet.state & RENDER_WIREFRAME ? GL_LINE : GL_FILL);
+
+        if(packet.setup)
+            packet.setup(packet.setupData);
+
+        if(!packet.indexType){
+            if(packet.instanceCount == 1)
+                glDrawArrays(packet.primitive, static_cast<GLint>(packet.first), packet.count);
+            else
+                glDrawArraysInstanced(packet.primitive, static_cast<GLint>(packet.first), packet.count, packet.instanceCount);
+        }
+        else if(packet.instanceCount == 1 && packet.baseVertex == 0){
+            glDrawElements(packet.primitive, packet.count, packet.indexType, reinterpret_cast<const GLvoid*>(packet.first));
+        }
+        else{
+            glDrawElementsInstancedBaseVertex(packet.primitive, packet.count, packet.indexType, reinterpret_cast<const GLvoid*>(packet.first),
+                                              packet.instanceCount, packet.baseVertex);
+        }
+    }
+
+    // Code still binding element buffers outside of any VAO must not modify the last one
+    state.bindVertexArray(0);
+    state.polygonMode(GL_FILL);
+    _executed.clear();
+}
+
+size_t RenderQueue::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _packets.size();
+}
+
+void RenderQueue::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _packets.clear();
+}
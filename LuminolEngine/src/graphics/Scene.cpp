@@ -3,6 +3,7 @@
 //
 
 #include "graphics/Scene.h"
+#include <stdexcept>
 
 namespace Graphics
 {
@@ -21,27 +22,26 @@ namespace Graphics
             throw std::runtime_error("Scene::setCurrentInstance : trying to access instance that doesn't exist");
 
         _currentInstance = name;
+        _currentMeshInstance = _meshInstances.at(name);
     }
 
-    const std::vector<glm::vec3>& Scene::computeVisiblePositions(const glm::mat4 & VP){
+    void Scene::computeVisibleInstances(const glm::mat4 & VP){
         _visiblePositions.clear();
+        _visibleRotations.clear();
+
+        if(!_currentMeshInstance)
+            throw std::runtime_error("Scene::computeVisibleInstances : no current instance");
+
+        _currentMeshInstance->cull(Geometry::Frustum(VP), _visiblePositions, _visibleRotations);
+    }
 
-        for(int i = 0; i < _meshInstances[_currentInstance]->getInstanceNumber(); ++i){
-            if(_meshInstances[_currentInstance]->getBoundingBox(i).isVisible(VP)){
-                _visiblePositions.push_back(_meshInstances[_currentInstance]->getPosition(i));
-            }
-        }
+    const std::vector<glm::vec3>& Scene::computeVisiblePositions(const glm::mat4 & VP){
+        computeVisibleInstances(VP);
         return _visiblePositions;
     }
 
     const std::vector<glm::vec4>& Scene::computeVisibleRotations(const glm::mat4 & VP){
-        _visibleRotations.clear();
-
-        for(int i = 0; i < _meshInstances[_currentInstance]->getInstanceNumber(); ++i){
-            if(_meshInstances[_currentInstance]->getBoundingBox(i).isVisible(VP)){
-                _visibleRotations.push_back(_meshInstances[_currentInstance]->getRotation(i));
-            }
-        }
+        computeVisibleInstances(VP);
         return _visibleRotations;
     }
 
@@ -6,14 +6,14 @@
 
 using namespace Graphics;
 
-Shader::Shader(GLenum type, const std::string &path): _idShader(0), _type(type), _path(path) {
+Shader::Shader(GLenum type, const std::string &path, const std::string &defines):
+    _idShader(0), _type(type), _path(path), _defines(defines) {
     if(_path.empty())
         return;
-    compile();
+    load();
 }
 
-
-void Shader::compile() {
+void Shader::load() {
     std::ifstream shaderFile(_path);
 
     if(!shaderFile.is_open())
@@ -21,13 +21,30 @@ void Shader::compile() {
 
     std::stringstream shaderContent;
     shaderContent << shaderFile.rdbuf();
-    std::string t = shaderContent.str();
-    const char * shaderString = t.c_str();
+    _source = shaderContent.str();
 
-    _idShader = glCreateShader(_type);
+    // #version must stay the first directive
+    size_t insertion = 0;
+    size_t versionLine = _source.find("#version");
+    if(versionLine != std::string::npos){
+        size_t lineEnd = _source.find('\n', versionLine);
+        if(lineEnd == std::string::npos){
+            _source += '\n';
+            lineEnd = _source.size() - 1;
+        }
+        insertion = lineEnd + 1;
+    }
+    _source.insert(insertion, _defines);
+}
+
+void Shader::compile() {
+    const char * shaderString = _source.c_str();
+
+    if(_idShader == 0)
+        _idShader = glCreateShader(_type);
     glShaderSource(_idShader, 1, &shaderString, 0);
+    // The status is only queried by checkCompile(): with KHR_parallel_shader_compile the driver compiles in the background meanwhile
     glCompileShader(_idShader);
-    checkCompile();
 }
 
 void Shader::checkCompile() const {
@@ -60,11 +77,29 @@ std::string Shader::getPath() const {
 }
 
 void Shader::changeProperties(GLenum type, const std::string &path) {
+    if(_idShader != 0 && type != _type){
+        glDeleteShader(_idShader);
+        _idShader = 0;
+    }
     _type = type;
     _path = path;
+    load();
     compile();
+    checkCompile();
+}
+
+const std::string& Shader::source() const {
+    return _source;
+}
+
+GLenum Shader::type() const {
+    return _type;
 }
 
 GLuint Shader::id() const{
     return _idShader;
+}
+
+bool Shader::isCompiled() const {
+    return _idShader != 0;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "graphics/ShaderPermutations.hpp"
+#include <stdexcept>
+
+using namespace Graphics;
+
+const std::vector<std::string> &Graphics::mainShaderFeatureNames() {
+    static const std::vector<std::string> names = {"PACKED_VERTEX", "INSTANCED", "TEXTURE_ARRAY", "NORMAL_MAP", "SPECULAR_MAP"};
+    return names;
+}
+
+ShaderPermutations::ShaderPermutations(const std::string &vertexPath, const std::string &geometryPath, const std::string &fragmentPath,
+                                       const std::vector<std::string> &featureNames):
+    _vertexPath(vertexPath), _geometryPath(geometryPath), _fragmentPath(fragmentPath), _featureNames(featureNames) {
+
+    if(_featureNames.size() > 32)
+        throw std::invalid_argument("ShaderPermutations : at most 32 features");
+}
+
+ShaderProgram &ShaderPermutations::program(uint32_t features) {
+    auto it = _programs.find(features);
+    if(it != _programs.end())
+        return *it->second;
+
+    std::unique_ptr<ShaderProgram> program(new ShaderProgram(_vertexPath, _geometryPath, _fragmentPath, defines(features)));
+    return *(_programs[features] = std::move(program));
+}
+
+void ShaderPermutations::prepare(const std::vector<uint32_t> &features) {
+    // Programs are only linked on first use (see ShaderProgram::link), creating them just submits the work
+    for(uint32_t feature : features)
+        program(feature);
+}
+
+std::string ShaderPermutations::defines(uint32_t features) const {
+    std::string lines;
+    for(size_t bit = 0; bit < 32; ++bit){
+        if(!(features & (uint32_t(1) << bit)))
+            continue;
+        if(bit >= _featureNames.size())
+            throw std::invalid_argument("ShaderPermutations::defines : no feature for bit " + std::to_string(bit));
+        lines += "#define " + _featureNames[bit] + "\n";
+    }
+    return lines;
+}
+
+size_t ShaderPermutations::programCount() const {
+    return _programs.size();
+}
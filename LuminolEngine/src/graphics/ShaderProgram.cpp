@@ -1,28 +1,129 @@
 #include "graphics/ShaderProgram.hpp"
+#include "graphics/GLState.hpp"
+#include "graphics/ProgramCache.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
 
 using namespace Graphics;
 
-ShaderProgram::ShaderProgram(const std::string &vShader, const std::string& gShader, const std::string& fShader):
-    _vertexShader(std::make_shared<Shader>(GL_VERTEX_SHADER, vShader)),
-    _geometryShader(std::make_shared<Shader>(GL_GEOMETRY_SHADER, gShader)),
-    _fragShader(std::make_shared<Shader>(GL_FRAGMENT_SHADER, fShader)) {
+ShaderProgram::ShaderProgram(const std::string &vShader, const std::string& gShader, const std::string& fShader, const std::string& defines):
+    _vertexShader(std::make_shared<Shader>(GL_VERTEX_SHADER, vShader, defines)),
+    _geometryShader(std::make_shared<Shader>(GL_GEOMETRY_SHADER, gShader, defines)),
+    _fragShader(std::make_shared<Shader>(GL_FRAGMENT_SHADER, fShader, defines)) {
 
     compile();
 }
 
 void ShaderProgram::compile() {
     _programId = glCreateProgram();
-    glAttachShader(_programId, _vertexShader.get()->id());
-    glAttachShader(_programId, _fragShader.get()->id());
+    _isLinked = false;
 
-    if(_geometryShader.get() && _geometryShader.get()->id() != 0)
-        glAttachShader(_programId, _geometryShader.get()->id());
+    std::vector<Shader*> shaders = stages();
+    std::vector<ShaderSource> sources;
+    for(Shader* shader : shaders){
+        ShaderSource source = {shader->type(), shader->source().c_str()};
+        sources.push_back(source);
+    }
+
+    ProgramCache& cache = ProgramCache::global();
+    _cacheKey = cache.key(sources);
+    if(cache.load(_programId, _cacheKey)){
+        _isLinked = true;
+        cacheUniformLocations();
+        return;
+    }
 
+    for(Shader* shader : shaders){
+        if(!shader->isCompiled())
+            shader->compile();
+        glAttachShader(_programId, shader->id());
+    }
+
+    cache.prepare(_programId);
     glLinkProgram(_programId);
+}
+
+std::vector<Shader*> ShaderProgram::stages() const {
+    std::vector<Shader*> shaders;
+    shaders.push_back(_vertexShader.get());
+    if(_geometryShader && !_geometryShader->getPath().empty())
+        shaders.push_back(_geometryShader.get());
+    shaders.push_back(_fragShader.get());
+    return shaders;
+}
+
+bool ShaderProgram::isReady() const {
+    if(_isLinked || !ProgramCache::isParallelCompileSupported())
+        return true;
+
+    GLint isCompleted = GL_FALSE;
+#if defined(GL_COMPLETION_STATUS_KHR)
+    glGetProgramiv(_programId, GL_COMPLETION_STATUS_KHR, &isCompleted);
+#elif defined(GL_COMPLETION_STATUS_ARB)
+    glGetProgramiv(_programId, GL_COMPLETION_STATUS_ARB, &isCompleted);
+#else
+    isCompleted = GL_TRUE;
+#endif
+    return isCompleted == GL_TRUE;
+}
+
+void ShaderProgram::link() const {
+    if(_isLinked)
+        return;
+
+    // Compile errors are more telling than the link error they cause
+    GLint status = GL_FALSE;
+    glGetProgramiv(_programId, GL_LINK_STATUS, &status);
+    if(status == GL_FALSE){
+        for(Shader* shader : stages())
+            shader->checkCompile();
+    }
     checkLinkErrors();
+
+    _isLinked = true;
+    cacheUniformLocations();
+    ProgramCache::global().save(_programId, _cacheKey);
+}
+
+void ShaderProgram::cacheUniformLocations() const {
+    _uniformLocations.clear();
+
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(_programId, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::string name(std::max(maxNameLength, 1), '\0');
+    for(GLint i = 0; i < uniformCount; ++i){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(_programId, static_cast<GLuint>(i), maxNameLength, &length, &size, &type, &name[0]);
+
+        // Members of uniform blocks have no location
+        GLint location = glGetUniformLocation(_programId, name.c_str());
+        if(location == -1)
+            continue;
+        _uniformLocations[hashUniformName(name.c_str(), length)] = location;
+
+        // Arrays are listed as "name[0]" but usually addressed as "name"
+        if(length > 3 && name.compare(length - 3, 3, "[0]") == 0)
+            _uniformLocations[hashUniformName(name.c_str(), length - 3)] = location;
+    }
+}
+
+GLint ShaderProgram::uniformLocation(const UniformKey &key) const {
+    link();
+
+    auto it = _uniformLocations.find(key.hash);
+    if(it != _uniformLocations.end())
+        return it->second;
+
+    // Names not listed at link (e.g. "name[2]" or inactive uniforms) are queried once and remembered
+    GLint location = glGetUniformLocation(_programId, key.name);
+    _uniformLocations[key.hash] = location;
+    return location;
 }
 
 ShaderProgram::ShaderProgram(const std::shared_ptr<Shader>& vShader, const std::shared_ptr<Shader>& fShader):
@@ -64,52 +165,57 @@ void ShaderProgram::checkLinkErrors() const {
 }
 
 GLuint ShaderProgram::id() const {
+    link();
     return _programId;
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, float v){
-    glProgramUniform1f(_programId, glGetUniformLocation(_programId, uniformName.c_str()), v);
+void ShaderProgram::updateUniform(const UniformKey& key, float v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, int v){
-    glProgramUniform1i(_programId, glGetUniformLocation(_programId, uniformName.c_str()), v);
+void ShaderProgram::updateUniform(const UniformKey& key, int v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, const glm::vec2 & v){
-    glProgramUniform2fv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), 1, glm::value_ptr(v));
+void ShaderProgram::updateUniform(const UniformKey& key, const glm::vec2 & v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, const glm::ivec2 & v){
-    glProgramUniform2iv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), 1, glm::value_ptr(v));
+void ShaderProgram::updateUniform(const UniformKey& key, const glm::ivec2 & v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, const glm::vec3 & v){
-    glProgramUniform3fv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), 1, glm::value_ptr(v));
+void ShaderProgram::updateUniform(const UniformKey& key, const glm::vec3 & v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string &uniformName, const glm::mat3 &v) {
-    glProgramUniformMatrix3fv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), 1, 0, glm::value_ptr(v));
+void ShaderProgram::updateUniform(const UniformKey& key, const glm::mat3 &v) {
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, const glm::mat4 & v){
-    glProgramUniformMatrix4fv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), 1, 0, glm::value_ptr(v));
+void ShaderProgram::updateUniform(const UniformKey& key, const glm::mat4 & v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
-void ShaderProgram::updateBindingPointUBO(const std::string &uniformName, GLuint uboBindingPoint){
-    glUniformBlockBinding(_programId, glGetUniformBlockIndex(_programId, uniformName.c_str()), uboBindingPoint);
+void ShaderProgram::updateBindingPointUBO(const UniformKey& key, GLuint uboBindingPoint){
+    link();
+    glUniformBlockBinding(_programId, glGetUniformBlockIndex(_programId, key.name), uboBindingPoint);
 }
 
-void ShaderProgram::updateUniform(const std::string& uniformName, const std::vector<glm::vec3> & v){
-    glProgramUniform3fv(_programId, glGetUniformLocation(_programId, uniformName.c_str()), v.size(), (float*)v.data());
+void ShaderProgram::updateUniform(const UniformKey& key, const std::vector<glm::vec3> & v){
+    setProgramUniform(_programId, uniformLocation(key), v);
 }
 
 ShaderProgram::~ShaderProgram() {
+    if(GLState* state = GLState::existingGlobal())
+        state->forgetProgram(_programId);
     glDeleteProgram(_programId);
     _programId = 0;
 }
 
 void ShaderProgram::useProgram() const {
-    glUseProgram(_programId);
+    link();
+    GLState::global().useProgram(_programId);
 }
 
 const std::shared_ptr<Shader> ShaderProgram::vShader() const {return _vertexShader; }
@@ -0,0 +1,122 @@
+#include "graphics/StreamingBuffer.hpp"
+#include "graphics/GLState.hpp"
+#include <cstring>
+#include <glog/logging.h>
+
+using namespace Graphics;
+
+std::unique_ptr<StreamingBuffer> StreamingBuffer::_global;
+
+StreamingBuffer::StreamingBuffer(GLsizeiptr frameSize):
+    _frameSize(frameSize), _currentFrame(0), _head(0), _isPersistent(GLEW_ARB_buffer_storage), _mapped(nullptr), _overflowReported(false) {
+    for(int i = 0; i < FRAME_COUNT; ++i)
+        _fences[i] = 0;
+
+    glGenBuffers(1, &_glId);
+    GLState::global().bindBuffer(GL_COPY_WRITE_BUFFER, _glId);
+
+    if(_isPersistent){
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, FRAME_COUNT * _frameSize, nullptr, flags);
+        _mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, FRAME_COUNT * _frameSize, flags));
+    }
+    else{
+        glBufferData(GL_COPY_WRITE_BUFFER, FRAME_COUNT * _frameSize, nullptr, GL_STREAM_DRAW);
+    }
+
+    GLState::global().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamingBuffer::~StreamingBuffer() {
+    for(int i = 0; i < FRAME_COUNT; ++i){
+        if(_fences[i])
+            glDeleteSync(_fences[i]);
+    }
+
+    // Deleting the buffer unbinds it: forgetBuffer is enough to keep the state in sync
+    GLState* state = GLState::existingGlobal();
+    if(_mapped){
+        if(state)
+            state->bindBuffer(GL_COPY_WRITE_BUFFER, _glId);
+        else
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _glId);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    if(state)
+        state->forgetBuffer(_glId);
+    glDeleteBuffers(1, &_glId);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::upload(const void *data, GLsizeiptr size, GLsizeiptr alignment) {
+    Allocation allocation = {0, 0};
+
+    GLintptr offset = (_head + alignment - 1) / alignment * alignment;
+    if(offset + size > _frameSize){
+        if(!_overflowReported){
+            LOG(WARNING) << "StreamingBuffer: frame region of " << _frameSize << " bytes is full, uploads fall back to buffer orphaning";
+            _overflowReported = true;
+        }
+        return allocation;
+    }
+
+    allocation.buffer = _glId;
+    allocation.offset = _currentFrame * _frameSize + offset;
+    _head = offset + size;
+
+    if(_isPersistent){
+        std::memcpy(_mapped + allocation.offset, data, size);
+    }
+    else{
+        GLState::global().bindBuffer(GL_COPY_WRITE_BUFFER, _glId);
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+        void* pointer = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, size, access);
+        std::memcpy(pointer, data, size);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    return allocation;
+}
+
+void StreamingBuffer::endFrame() {
+    if(_fences[_currentFrame])
+        glDeleteSync(_fences[_currentFrame]);
+    _fences[_currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    _currentFrame = (_currentFrame + 1) % FRAME_COUNT;
+    _head = 0;
+
+    // The region was drawn FRAME_COUNT - 1 frames ago: the fence is usually signaled already
+    waitAndDeleteFence(_fences[_currentFrame]);
+}
+
+GLuint StreamingBuffer::glId() const {
+    return _glId;
+}
+
+StreamingBuffer &StreamingBuffer::global() {
+    if(!_global)
+        _global.reset(new StreamingBuffer());
+    return *_global;
+}
+
+void StreamingBuffer::endGlobalFrame() {
+    if(_global)
+        _global->endFrame();
+}
+
+void StreamingBuffer::releaseGlobal() {
+    _global.reset();
+}
+
+void Graphics::waitAndDeleteFence(GLsync &fence) {
+    if(!fence)
+        return;
+
+    // Try without blocking first, then flush the pending commands so that the fence is eventually reached
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    while(status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+    glDeleteSync(fence);
+    fence = 0;
+}
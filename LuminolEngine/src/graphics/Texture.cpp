@@ -3,7 +3,11 @@
 //
 
 #include "graphics/Texture.h"
+#include "graphics/GLState.hpp"
+#include "graphics/TextureCache.hpp"
+#include "graphics/TgaImage.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace Graphics
@@ -14,6 +18,9 @@ namespace Graphics
             setTextureParameters(type);
             return;
         }
+        _type = TextureType::FROM_FILE;
+        if(loadCache(path))
+            return;
         loadImage(path);
         setTextureParameters(TextureType::FROM_FILE);
     }
@@ -39,11 +46,15 @@ namespace Graphics
         std::swap(_height, texture._height);
         std::swap(_bitDepth, texture._bitDepth);
         std::swap(_type, texture._type);
+        std::swap(_texParams, texture._texParams);
+        std::swap(_path, texture._path);
+        std::swap(_levelCount, texture._levelCount);
+        std::swap(_tgaImage, texture._tgaImage);
     }
 
     Texture::Texture(const Texture& texture):
             _texId(0), _data(nullptr), _width(texture._width), _height(texture._height), _bitDepth(texture._bitDepth),
-            _texParams(texture._texParams), _path(texture._path){
+            _texParams(texture._texParams), _path(texture._path), _levelCount(texture._levelCount){
 
         if(!_path.empty())
             loadImage(_path);
@@ -51,14 +62,75 @@ namespace Graphics
     }
 
     Texture::~Texture() {
+        if(GLState* state = GLState::existingGlobal())
+            state->forgetTexture(_texId);
         glDeleteTextures(1, &_texId);
         free(_data);
     }
 
     void Texture::loadImage(const std::string &filePath){
+        // TGA files are read from their mapping and uploaded in their own channel order
+        if(TgaImage::isTga(filePath)){
+            std::unique_ptr<TgaImage> image(new TgaImage());
+            if(image->open(filePath)){
+                _width = image->width();
+                _height = image->height();
+                _bitDepth = image->channels();
+                _tgaImage = std::move(image);
+                return;
+            }
+        }
         _data = stbi_load(filePath.c_str(), &_width, &_height, &_bitDepth, 3);
     }
 
+    bool Texture::loadCache(const std::string &filePath){
+        TextureCache cache;
+        if(!cache.load(filePath, COMPRESSION_NONE))
+            return false;
+
+        loadLevels(cache);
+        return true;
+    }
+
+    void Texture::loadLevels(const TextureCache &cache, int firstLevel) {
+        const TextureCache::Level& first = cache.level(firstLevel);
+        setLevels(TextureCompressor::internalFormat(cache.compression()), first.width, first.height, cache.levelCount() - firstLevel);
+
+        for(int i = firstLevel; i < cache.levelCount(); ++i){
+            const TextureCache::Level& level = cache.level(i);
+            setLevel(i - firstLevel, level.data, cache.compression() == COMPRESSION_NONE ? 0 : static_cast<GLsizei>(level.size));
+        }
+    }
+
+    void Texture::updateLevelCount() {
+        _levelCount = _texParams.mipmap ? TextureCompressor::levelCount(_width, _height) : 1;
+    }
+
+    size_t Texture::memorySize() const {
+        size_t size = 0;
+        for(int level = 0; level < _levelCount; ++level)
+            size += levelMemorySize(level);
+        return size;
+    }
+
+    size_t Texture::levelMemorySize(int level) const {
+        int width = std::max(1, _width >> level);
+        int height = std::max(1, _height >> level);
+
+        switch(_texParams.internalFormat){
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return TextureCompressor::imageSize(width, height, COMPRESSION_BC1);
+            case GL_COMPRESSED_RED_RGTC1: return TextureCompressor::imageSize(width, height, COMPRESSION_BC4);
+            case GL_COMPRESSED_RG_RGTC2: return TextureCompressor::imageSize(width, height, COMPRESSION_BC5);
+            case GL_RGBA32F: return size_t(width) * height * 16;
+            // 8 bits RGB is padded to 4 bytes per texel by most drivers
+            default: return size_t(width) * height * 4;
+        }
+    }
+
+    int Texture::levelCount() const {
+        return _levelCount;
+    }
+
     void Texture::setTextureParameters(TextureType type){
         _type = type;
 
@@ -77,11 +149,36 @@ namespace Graphics
     }
 
     void Texture::genGlTex(){
-        
+        if(!_tgaImage){
+            genGlTex(_data);
+            return;
+        }
+
+        GLenum format = _texParams.format;
+        _texParams.format = _tgaImage->format();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        genGlTex(_tgaImage->pixels());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        _texParams.format = format;
+
+        // Grey images are uploaded as GL_RED: spread it like a GL_RGB upload of the grey level would
+        if(_tgaImage->channels() == 1){
+            const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            bind();
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+            unbind();
+        }
+        _tgaImage.reset();
+    }
+
+    void Texture::genGlTex(const void* pixels){
+
+        updateLevelCount();
+        GLState::global().forgetTexture(_texId);
         glDeleteTextures(1, &_texId);
         glGenTextures(1, &_texId);
         bind();
-        glTexImage2D(GL_TEXTURE_2D, 0, _texParams.internalFormat, _width, _height, 0, _texParams.format, _texParams.type, _data);
+        glTexImage2D(GL_TEXTURE_2D, 0, _texParams.internalFormat, _width, _height, 0, _texParams.format, _texParams.type, pixels);
 
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _texParams.wrapMode);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _texParams.wrapMode);
@@ -103,17 +200,77 @@ namespace Graphics
     }
 
 
+    void Texture::setImage(int width, int height, const void *pixels) {
+        free(_data);
+        _data = nullptr;
+        _width = width;
+        _height = height;
+        genGlTex(pixels);
+    }
+
+    void Texture::setLevels(GLenum internalFormat, int width, int height, int levelCount) {
+        free(_data);
+        _data = nullptr;
+        _width = width;
+        _height = height;
+        _levelCount = levelCount;
+        // genGlTex() rebuilds from the same format if the texture is copied
+        _texParams.internalFormat = internalFormat;
+        _texParams.format = GL_RGB;
+        _texParams.type = GL_UNSIGNED_BYTE;
+
+        GLState::global().forgetTexture(_texId);
+        glDeleteTextures(1, &_texId);
+        glGenTextures(1, &_texId);
+        bind();
+        if(GLEW_ARB_texture_storage){
+            glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, width, height);
+        }
+        else{
+            for(int level = 0; level < levelCount; ++level)
+                glTexImage2D(GL_TEXTURE_2D, level, internalFormat, std::max(1, width >> level), std::max(1, height >> level), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _texParams.wrapMode);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _texParams.wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        unbind();
+    }
+
+    void Texture::setLevel(int level, const void *pixels, GLsizei compressedSize) {
+        int width = std::max(1, _width >> level);
+        int height = std::max(1, _height >> level);
+
+        bind();
+        if(compressedSize){
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, _texParams.internalFormat, compressedSize, pixels);
+        }
+        else{
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, _texParams.format, _texParams.type, pixels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        unbind();
+    }
+
+    void Texture::setBaseLevel(int level) {
+        bind();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        unbind();
+    }
+
     void Texture::bind() {
-        glBindTexture(GL_TEXTURE_2D, _texId);
+        GLState::global().bindTexture(GL_TEXTURE_2D, _texId);
     }
 
     void Texture::bind(GLenum textureBindingIndex) {
-        glActiveTexture(textureBindingIndex);
-        glBindTexture(GL_TEXTURE_2D, _texId);
+        GLState::global().bindTexture(textureBindingIndex, GL_TEXTURE_2D, _texId);
     }
 
     void Texture::unbind() {
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::global().bindTexture(GL_TEXTURE_2D, 0);
     }
 
     GLuint& Texture::glId(){
@@ -0,0 +1,145 @@
+#include "graphics/TextureArray.hpp"
+#include "graphics/GLState.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Graphics;
+
+TextureArray::TextureArray(int width, int height, int capacity, TextureCompression compression):
+    _glId(0), _width(width), _height(height), _levelCount(TextureCompressor::levelCount(width, height)),
+    _capacity(capacity), _layerCount(0), _compression(compression) {
+
+    GLenum internalFormat = TextureCompressor::internalFormat(compression);
+
+    glGenTextures(1, &_glId);
+    GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, _glId);
+    if(GLEW_ARB_texture_storage){
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, _levelCount, internalFormat, width, height, capacity);
+    }
+    else{
+        for(int level = 0; level < _levelCount; ++level)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, std::max(1, width >> level), std::max(1, height >> level), capacity,
+                         0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, _levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, _levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureArray::TextureArray(TextureArray &&other):
+    _glId(other._glId), _width(other._width), _height(other._height), _levelCount(other._levelCount),
+    _capacity(other._capacity), _layerCount(other._layerCount), _compression(other._compression) {
+    other._glId = 0;
+}
+
+TextureArray::~TextureArray() {
+    if(GLState* state = GLState::existingGlobal())
+        state->forgetTexture(_glId);
+    glDeleteTextures(1, &_glId);
+}
+
+bool TextureArray::isCompatible(const TextureCache &cache) const {
+    return cache.levelCount() == _levelCount && cache.width() == _width && cache.height() == _height && cache.compression() == _compression;
+}
+
+int TextureArray::addLayer(const TextureCache &cache) {
+    if(!isCompatible(cache))
+        throw std::runtime_error("TextureArray::addLayer : the image size or compression does not match the array");
+    if(_layerCount == _capacity)
+        throw std::runtime_error("TextureArray::addLayer : the array is full");
+
+    GLenum internalFormat = TextureCompressor::internalFormat(_compression);
+
+    GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, _glId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(int i = 0; i < cache.levelCount(); ++i){
+        const TextureCache::Level& level = cache.level(i);
+        if(_compression == COMPRESSION_NONE)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, _layerCount, level.width, level.height, 1, GL_RGB, GL_UNSIGNED_BYTE, level.data);
+        else
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, _layerCount, level.width, level.height, 1,
+                                      internalFormat, static_cast<GLsizei>(level.size), level.data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    return _layerCount++;
+}
+
+int TextureArray::addLayer(const std::string &path) {
+    TextureCache cache;
+    if(!cache.load(path, _compression))
+        throw std::runtime_error("TextureArray::addLayer : unable to read " + path);
+    return addLayer(cache);
+}
+
+void TextureArray::bind(GLenum textureBindingIndex) {
+    GLState::global().bindTexture(textureBindingIndex, GL_TEXTURE_2D_ARRAY, _glId);
+}
+
+void TextureArray::unbind() {
+    GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+GLuint TextureArray::glId() const {
+    return _glId;
+}
+
+int TextureArray::layerCount() const {
+    return _layerCount;
+}
+
+int TextureArray::capacity() const {
+    return _capacity;
+}
+
+TextureCompression TextureArray::compression() const {
+    return _compression;
+}
+
+
+MaterialArray::MaterialArray(int width, int height, int capacity, const std::vector<Binding> &bindings):
+    _bindings(bindings), _materialCount(0) {
+    _arrays.reserve(bindings.size());
+    for(const Binding& binding : bindings){
+        TextureCompression compression = TextureCompressor::isSupported(binding.compression) ? binding.compression : COMPRESSION_NONE;
+        _arrays.emplace_back(width, height, capacity, compression);
+    }
+}
+
+int MaterialArray::addMaterial(const std::vector<std::string> &paths) {
+    if(paths.size() != _arrays.size())
+        throw std::runtime_error("MaterialArray::addMaterial : expected one texture per binding");
+
+    // Everything is checked before the first upload, so that a failure leaves the layers of the arrays aligned
+    std::vector<TextureCache> caches(paths.size());
+    for(size_t i = 0; i < paths.size(); ++i){
+        if(!caches[i].load(paths[i], _arrays[i].compression()))
+            throw std::runtime_error("MaterialArray::addMaterial : unable to read " + paths[i]);
+        if(!_arrays[i].isCompatible(caches[i]))
+            throw std::runtime_error("MaterialArray::addMaterial : " + paths[i] + " does not match the size of the material");
+    }
+    if(_materialCount == (_arrays.empty() ? 0 : _arrays.front().capacity()))
+        throw std::runtime_error("MaterialArray::addMaterial : the material array is full");
+
+    for(size_t i = 0; i < caches.size(); ++i)
+        _arrays[i].addLayer(caches[i]);
+    return _materialCount++;
+}
+
+void MaterialArray::bind() {
+    for(size_t i = 0; i < _arrays.size(); ++i)
+        _arrays[i].bind(_bindings[i].textureBindingIndex);
+}
+
+int MaterialArray::materialCount() const {
+    return _materialCount;
+}
+
+TextureArray &MaterialArray::array(size_t binding) {
+    return _arrays.at(binding);
+}
@@ -0,0 +1,220 @@
+#include "graphics/TextureCache.hpp"
+#include "graphics/TgaImage.hpp"
+#include "graphics/stb_image.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <glog/logging.h>
+
+using namespace Graphics;
+
+namespace {
+
+    const char TEXTURE_CACHE_MAGIC[4] = {'L', 'T', 'E', 'X'};
+    const uint32_t TEXTURE_CACHE_VERSION = 1;
+    const uint32_t MAX_LEVEL_COUNT = 32;
+    /** Offset alignment of the levels in the file */
+    const size_t LEVEL_ALIGNMENT = 16;
+
+    /** The cache is only read on the machine that wrote it: fields are in native byte order */
+    struct TextureCacheHeader{
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceModificationTime;
+        uint64_t sourceHash;
+        uint32_t compression;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+    };
+
+    /** One per level, right after the header */
+    struct TextureCacheLevel{
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(TextureCacheHeader) == 48, "TextureCacheHeader must not be padded");
+    static_assert(sizeof(TextureCacheLevel) == 24, "TextureCacheLevel must not be padded");
+}
+
+TextureCache::TextureCache(): _compression(COMPRESSION_NONE) {}
+
+bool TextureCache::parse(const unsigned char *data, size_t size, TextureCompression compression) {
+    _levels.clear();
+
+    TextureCacheHeader header;
+    if(size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+
+    if(std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != TEXTURE_CACHE_VERSION
+       || header.compression != static_cast<uint32_t>(compression)
+       || header.levelCount == 0 || header.levelCount > MAX_LEVEL_COUNT
+       || size < sizeof(header) + header.levelCount * sizeof(TextureCacheLevel))
+        return false;
+
+    for(uint32_t i = 0; i < header.levelCount; ++i){
+        TextureCacheLevel entry;
+        std::memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+        if(entry.offset > size || entry.size > size - entry.offset
+           || entry.size != TextureCompressor::imageSize(entry.width, entry.height, compression)){
+            _levels.clear();
+            return false;
+        }
+
+        Level level = {static_cast<int>(entry.width), static_cast<int>(entry.height), data + entry.offset, static_cast<size_t>(entry.size)};
+        _levels.push_back(level);
+    }
+
+    _compression = compression;
+    return true;
+}
+
+bool TextureCache::open(const std::string &sourcePath, TextureCompression compression) {
+    _file.close();
+    _memory.clear();
+    _levels.clear();
+
+    FileStamp sourceStamp;
+    if(!FileStamp::get(sourcePath, sourceStamp) || !_file.open(cachePath(sourcePath)))
+        return false;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(_file.data());
+    if(!parse(data, _file.size(), compression)){
+        _file.close();
+        return false;
+    }
+
+    TextureCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if(header.sourceSize == sourceStamp.size && header.sourceModificationTime == sourceStamp.modificationTime)
+        return true;
+
+    // The stamp changed: the cache is still good if the content did not
+    MappedFile source;
+    if(!source.open(sourcePath) || hashBytes(source.data(), source.size()) != header.sourceHash){
+        _levels.clear();
+        _file.close();
+        return false;
+    }
+
+    // Store the new stamp so that the next start does not hash again
+    std::fstream file(cachePath(sourcePath), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offsetof(TextureCacheHeader, sourceSize));
+    file.write(reinterpret_cast<const char*>(&sourceStamp.size), sizeof(sourceStamp.size));
+    file.write(reinterpret_cast<const char*>(&sourceStamp.modificationTime), sizeof(sourceStamp.modificationTime));
+    return true;
+}
+
+bool TextureCache::build(const std::string &sourcePath, TextureCompression compression) {
+    _file.close();
+    _memory.clear();
+    _levels.clear();
+
+    MappedFile source;
+    FileStamp sourceStamp;
+    if(!source.open(sourcePath) || !FileStamp::get(sourcePath, sourceStamp)){
+        LOG(WARNING) << "Unable to open texture " << sourcePath;
+        return false;
+    }
+
+    int width = 0, height = 0, bitDepth = 0;
+    std::vector<unsigned char> image;
+    TgaImage tga;
+    if(TgaImage::isTga(sourcePath) && tga.parse(source.data(), source.size())){
+        width = tga.width();
+        height = tga.height();
+        image.resize(size_t(width) * height * 3);
+        tga.copyRgb(image.data());
+    }
+    else{
+        unsigned char* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()),
+                                                      &width, &height, &bitDepth, 3);
+        if(!pixels){
+            LOG(WARNING) << "Unable to decode texture " << sourcePath << ": " << stbi_failure_reason();
+            return false;
+        }
+        image.assign(pixels, pixels + size_t(width) * height * 3);
+        stbi_image_free(pixels);
+    }
+
+    TextureCacheHeader header;
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceSize = sourceStamp.size;
+    header.sourceModificationTime = sourceStamp.modificationTime;
+    header.sourceHash = hashBytes(source.data(), source.size());
+    header.compression = static_cast<uint32_t>(compression);
+    header.width = width;
+    header.height = height;
+    header.levelCount = TextureCompressor::levelCount(width, height);
+
+    std::vector<unsigned char> content(sizeof(header) + header.levelCount * sizeof(TextureCacheLevel));
+    std::memcpy(content.data(), &header, sizeof(header));
+
+    int levelWidth = width, levelHeight = height;
+    for(uint32_t i = 0; i < header.levelCount; ++i){
+        std::vector<unsigned char> encoded = TextureCompressor::compress(image.data(), levelWidth, levelHeight, compression);
+
+        TextureCacheLevel entry;
+        entry.width = levelWidth;
+        entry.height = levelHeight;
+        entry.offset = (content.size() + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT * LEVEL_ALIGNMENT;
+        entry.size = encoded.size();
+        std::memcpy(content.data() + sizeof(header) + i * sizeof(entry), &entry, sizeof(entry));
+
+        content.resize(entry.offset);
+        content.insert(content.end(), encoded.begin(), encoded.end());
+
+        if(i + 1 < header.levelCount){
+            image = TextureCompressor::downsample(image.data(), levelWidth, levelHeight, compression == COMPRESSION_BC5);
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+    }
+
+    std::string path = cachePath(sourcePath);
+    if(writeFileAtomically(path, {{content.data(), content.size()}}) && _file.open(path)
+       && parse(reinterpret_cast<const unsigned char*>(_file.data()), _file.size(), compression))
+        return true;
+
+    LOG(WARNING) << "Unable to write the texture cache " << path;
+    _file.close();
+    _memory.swap(content);
+    return parse(_memory.data(), _memory.size(), compression);
+}
+
+bool TextureCache::load(const std::string &sourcePath, TextureCompression compression) {
+    return open(sourcePath, compression) || build(sourcePath, compression);
+}
+
+TextureCompression TextureCache::compression() const {
+    return _compression;
+}
+
+int TextureCache::width() const {
+    return _levels.empty() ? 0 : _levels.front().width;
+}
+
+int TextureCache::height() const {
+    return _levels.empty() ? 0 : _levels.front().height;
+}
+
+int TextureCache::levelCount() const {
+    return static_cast<int>(_levels.size());
+}
+
+const TextureCache::Level &TextureCache::level(int index) const {
+    return _levels[index];
+}
+
+std::string TextureCache::cachePath(const std::string &sourcePath) {
+    return sourcePath + ".ltex";
+}
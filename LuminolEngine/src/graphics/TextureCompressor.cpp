@@ -0,0 +1,244 @@
+#include "graphics/TextureCompressor.hpp"
+#include "graphics/ThreadPool.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+
+using namespace Graphics;
+
+namespace {
+
+    /** Block rows encoded per task */
+    const int BLOCK_ROW_GRAIN = 4;
+
+    /** 4x4 pixels of the image, edges are clamped to the last row or column */
+    void fetchBlock(const unsigned char* rgb, int width, int height, int blockX, int blockY, glm::vec3 block[16]){
+        for(int y = 0; y < 4; ++y){
+            int py = std::min(blockY * 4 + y, height - 1);
+            for(int x = 0; x < 4; ++x){
+                int px = std::min(blockX * 4 + x, width - 1);
+                const unsigned char* pixel = rgb + (size_t(py) * width + px) * 3;
+                block[y * 4 + x] = glm::vec3(pixel[0], pixel[1], pixel[2]);
+            }
+        }
+    }
+
+    inline uint16_t packRgb565(const glm::vec3& color){
+        glm::vec3 c = glm::clamp(color, 0.f, 255.f);
+        int r = int(c.r * 31.f / 255.f + 0.5f);
+        int g = int(c.g * 63.f / 255.f + 0.5f);
+        int b = int(c.b * 31.f / 255.f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    inline glm::vec3 unpackRgb565(uint16_t color){
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 3));
+    }
+
+    inline void writeLittleEndian(unsigned char* out, uint64_t value, int bytes){
+        for(int i = 0; i < bytes; ++i)
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+
+    void encodeBC1(const glm::vec3 block[16], unsigned char* out){
+        glm::vec3 mean(0.f);
+        for(int i = 0; i < 16; ++i)
+            mean += block[i];
+        mean /= 16.f;
+
+        // Principal axis of the colors by power iteration on their covariance
+        float cov[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+        for(int i = 0; i < 16; ++i){
+            glm::vec3 d = block[i] - mean;
+            cov[0] += d.r * d.r; cov[1] += d.r * d.g; cov[2] += d.r * d.b;
+            cov[3] += d.g * d.g; cov[4] += d.g * d.b; cov[5] += d.b * d.b;
+        }
+        glm::vec3 axis(1.f, 1.f, 1.f);
+        for(int iteration = 0; iteration < 8; ++iteration){
+            glm::vec3 next(cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                           cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                           cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+            float length = glm::length(next);
+            if(length < 1e-6f)
+                break;
+            axis = next / length;
+        }
+
+        float minProjection = 1e30f, maxProjection = -1e30f;
+        for(int i = 0; i < 16; ++i){
+            float projection = glm::dot(block[i] - mean, axis);
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        // Inset the endpoints a little: the extreme colors are rarely worth the error of all the others
+        float inset = (maxProjection - minProjection) / 16.f;
+        uint16_t c0 = packRgb565(mean + axis * (maxProjection - inset));
+        uint16_t c1 = packRgb565(mean + axis * (minProjection + inset));
+        if(c0 < c1)
+            std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if(c0 != c1){
+            // c0 > c1 selects the four colors mode
+            glm::vec3 palette[4];
+            palette[0] = unpackRgb565(c0);
+            palette[1] = unpackRgb565(c1);
+            palette[2] = (2.f * palette[0] + palette[1]) / 3.f;
+            palette[3] = (palette[0] + 2.f * palette[1]) / 3.f;
+
+            for(int i = 0; i < 16; ++i){
+                int best = 0;
+                float bestDistance = 1e30f;
+                for(int p = 0; p < 4; ++p){
+                    glm::vec3 d = block[i] - palette[p];
+                    float distance = glm::dot(d, d);
+                    if(distance < bestDistance){
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= uint32_t(best) << (2 * i);
+            }
+        }
+
+        writeLittleEndian(out, c0, 2);
+        writeLittleEndian(out + 2, c1, 2);
+        writeLittleEndian(out + 4, indices, 4);
+    }
+
+    void encodeBC4(const float values[16], unsigned char* out){
+        float minValue = values[0], maxValue = values[0];
+        for(int i = 1; i < 16; ++i){
+            minValue = std::min(minValue, values[i]);
+            maxValue = std::max(maxValue, values[i]);
+        }
+        int r0 = int(maxValue + 0.5f);
+        int r1 = int(minValue + 0.5f);
+
+        uint64_t indices = 0;
+        if(r0 > r1){
+            // Eight values mode: index 0 is r0, 1 is r1, then 2..7 interpolate from r0 to r1
+            for(int i = 0; i < 16; ++i){
+                int step = int((r0 - values[i]) / (r0 - r1) * 7.f + 0.5f);
+                step = std::max(0, std::min(7, step));
+                int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                indices |= uint64_t(index) << (3 * i);
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(r0);
+        out[1] = static_cast<unsigned char>(r1);
+        writeLittleEndian(out + 2, indices, 6);
+    }
+
+    void encodeBlock(const unsigned char* rgb, int width, int height, int blockX, int blockY, TextureCompression compression, unsigned char* out){
+        glm::vec3 block[16];
+        fetchBlock(rgb, width, height, blockX, blockY, block);
+
+        if(compression == COMPRESSION_BC1){
+            encodeBC1(block, out);
+            return;
+        }
+
+        float values[16];
+        for(int i = 0; i < 16; ++i)
+            values[i] = block[i].r;
+        encodeBC4(values, out);
+
+        if(compression == COMPRESSION_BC5){
+            for(int i = 0; i < 16; ++i)
+                values[i] = block[i].g;
+            encodeBC4(values, out + 8);
+        }
+    }
+
+    inline size_t blockSize(TextureCompression compression){
+        return compression == COMPRESSION_BC5 ? 16 : 8;
+    }
+}
+
+std::vector<unsigned char> TextureCompressor::compress(const unsigned char *rgb, int width, int height, TextureCompression compression) {
+    if(compression == COMPRESSION_NONE)
+        return std::vector<unsigned char>(rgb, rgb + size_t(width) * height * 3);
+
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const size_t size = blockSize(compression);
+    std::vector<unsigned char> result(blocksX * blocksY * size);
+
+    ThreadPool::global().parallelFor(0, blocksY, BLOCK_ROW_GRAIN, [&](int first, int last){
+        for(int blockY = first; blockY < last; ++blockY){
+            for(int blockX = 0; blockX < blocksX; ++blockX)
+                encodeBlock(rgb, width, height, blockX, blockY, compression, &result[(size_t(blockY) * blocksX + blockX) * size]);
+        }
+    });
+    return result;
+}
+
+std::vector<unsigned char> TextureCompressor::downsample(const unsigned char *rgb, int width, int height, bool normalMap) {
+    const int halfWidth = std::max(1, width / 2);
+    const int halfHeight = std::max(1, height / 2);
+    std::vector<unsigned char> result(size_t(halfWidth) * halfHeight * 3);
+
+    for(int y = 0; y < halfHeight; ++y){
+        const int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for(int x = 0; x < halfWidth; ++x){
+            const int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            const unsigned char* samples[4] = {
+                rgb + (size_t(y0) * width + x0) * 3, rgb + (size_t(y0) * width + x1) * 3,
+                rgb + (size_t(y1) * width + x0) * 3, rgb + (size_t(y1) * width + x1) * 3
+            };
+
+            glm::vec3 sum(0.f);
+            for(int s = 0; s < 4; ++s){
+                glm::vec3 value(samples[s][0], samples[s][1], samples[s][2]);
+                // Same decoding as perturb_normal in main.frag
+                sum += normalMap ? value / 127.f - 128.f / 127.f : value;
+            }
+
+            glm::vec3 average = sum / 4.f;
+            if(normalMap){
+                float length = glm::length(average);
+                average = length > 0.f ? average / length : glm::vec3(0.f, 0.f, 1.f);
+                average = average * 127.f + 128.f;
+            }
+
+            unsigned char* out = &result[(size_t(y) * halfWidth + x) * 3];
+            for(int c = 0; c < 3; ++c)
+                out[c] = static_cast<unsigned char>(glm::clamp(average[c] + 0.5f, 0.f, 255.f));
+        }
+    }
+    return result;
+}
+
+size_t TextureCompressor::imageSize(int width, int height, TextureCompression compression) {
+    if(compression == COMPRESSION_NONE)
+        return size_t(width) * height * 3;
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(compression);
+}
+
+int TextureCompressor::levelCount(int width, int height) {
+    int count = 1;
+    for(int size = std::max(width, height); size > 1; size /= 2)
+        ++count;
+    return count;
+}
+
+GLenum TextureCompressor::internalFormat(TextureCompression compression) {
+    switch(compression){
+        case COMPRESSION_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case COMPRESSION_BC4: return GL_COMPRESSED_RED_RGTC1;
+        case COMPRESSION_BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_RGB8;
+    }
+}
+
+bool TextureCompressor::isSupported(TextureCompression compression) {
+    switch(compression){
+        case COMPRESSION_BC1: return GLEW_EXT_texture_compression_s3tc;
+        case COMPRESSION_BC4:
+        case COMPRESSION_BC5: return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+        default: return true;
+    }
+}
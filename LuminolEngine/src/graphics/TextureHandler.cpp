@@ -3,25 +3,244 @@
 //
 
 #include "graphics/TextureHandler.h"
-#include <iostream>
+#include <algorithm>
+#include <glog/logging.h>
 
 namespace Graphics
 {
-    TextureHandler::TextureHandler() { }
+    TextureHandle::TextureHandle() : _handler(nullptr), _index(-1) { }
 
-    void TextureHandler::add(const Texture& texture, const std::string &textureName) {
-        _map.insert(std::pair<std::string, Texture>(textureName, texture));
+    TextureHandle::TextureHandle(TextureHandler* handler, int index) : _handler(handler), _index(index) {
+        _handler->retain(_index);
     }
 
-    void TextureHandler::add(Texture&& texture, const std::string& textureName) {
-        _map.insert(std::pair<std::string, Texture>(textureName, std::move(texture)));
+    TextureHandle::TextureHandle(const TextureHandle& handle) : _handler(handle._handler), _index(handle._index) {
+        if(_handler)
+            _handler->retain(_index);
+    }
+
+    TextureHandle::TextureHandle(TextureHandle&& handle) : _handler(handle._handler), _index(handle._index) {
+        handle._handler = nullptr;
+        handle._index = -1;
+    }
+
+    TextureHandle& TextureHandle::operator=(TextureHandle handle) {
+        std::swap(_handler, handle._handler);
+        std::swap(_index, handle._index);
+        return *this;
+    }
+
+    TextureHandle::~TextureHandle() {
+        if(_handler)
+            _handler->release(_index);
+    }
+
+    bool TextureHandle::isValid() const {
+        return _handler != nullptr;
+    }
+
+    void TextureHandle::bind(GLenum textureBindingIndex) const {
+        _handler->bind(_index, textureBindingIndex);
+    }
+
+    Texture& TextureHandle::texture() const {
+        return *_handler->_entries[_index].texture;
+    }
+
+
+    TextureHandler::TextureHandler() : _memoryBudget(0), _memoryUsage(0), _frame(0), _overBudgetReported(false) { }
+
+    TextureHandler::~TextureHandler() {
+        // Pending loads point to the textures: they go first
+        for(Entry& entry : _entries){
+            if(entry.texture)
+                _loader.cancel(*entry.texture);
+        }
+    }
+
+    int TextureHandler::insert(std::unique_ptr<Texture> texture, const std::string& key) {
+        int index;
+        if(!_freeEntries.empty()){
+            index = _freeEntries.back();
+            _freeEntries.pop_back();
+        }
+        else{
+            index = static_cast<int>(_entries.size());
+            _entries.emplace_back();
+        }
+
+        Entry& entry = _entries[index];
+        entry.texture = std::move(texture);
+        entry.key = key;
+        entry.path.clear();
+        entry.compression = COMPRESSION_NONE;
+        entry.placeholder = glm::u8vec3(0);
+        entry.refCount = 0;
+        entry.lastBound = _frame;
+        entry.firstLevel = 0;
+        entry.isUnloaded = false;
+        entry.completeSize = 0;
+        entry.pendingSize = 0;
+
+        _indices[key] = index;
+        return index;
+    }
+
+    TextureHandle TextureHandler::load(const std::string& path, TextureCompression compression, const glm::u8vec3& placeholder) {
+        auto it = _indices.find(path);
+        if(it != _indices.end())
+            return TextureHandle(this, it->second);
+
+        if(!TextureCompressor::isSupported(compression))
+            compression = COMPRESSION_NONE;
+
+        int index = insert(std::unique_ptr<Texture>(new Texture()), path);
+        Entry& entry = _entries[index];
+        entry.path = path;
+        entry.compression = compression;
+        entry.placeholder = placeholder;
+
+        _loader.load(*entry.texture, path, compression, placeholder);
+        return TextureHandle(this, index);
+    }
+
+    TextureHandle TextureHandler::add(Texture&& texture, const std::string& textureName) {
+        auto it = _indices.find(textureName);
+        if(it != _indices.end()){
+            // The handles already given keep the entry and see the new texture
+            Entry& entry = _entries[it->second];
+            _loader.cancel(*entry.texture);
+            entry.texture.reset(new Texture(std::move(texture)));
+            if(!entry.path.empty()){
+                // A file texture becomes owned by the handler, and is no longer evicted
+                entry.path.clear();
+                ++entry.refCount;
+            }
+            entry.firstLevel = 0;
+            entry.isUnloaded = false;
+            entry.completeSize = 0;
+            entry.pendingSize = 0;
+            return TextureHandle(this, it->second);
+        }
+
+        int index = insert(std::unique_ptr<Texture>(new Texture(std::move(texture))), textureName);
+        // Owned by the handler for its whole life
+        _entries[index].refCount = 1;
+        return TextureHandle(this, index);
     }
 
     const Texture& TextureHandler::operator[](const std::string &textureName) const {
-        return _map.at(textureName);
+        return *_entries[_indices.at(textureName)].texture;
     }
 
     Texture& TextureHandler::operator[](const std::string &textureName) {
-        return _map[textureName];
+        return *_entries[_indices.at(textureName)].texture;
+    }
+
+    void TextureHandler::retain(int index) {
+        ++_entries[index].refCount;
+    }
+
+    void TextureHandler::release(int index) {
+        Entry& entry = _entries[index];
+        if(--entry.refCount > 0)
+            return;
+
+        _loader.cancel(*entry.texture);
+        _indices.erase(entry.key);
+        entry.texture.reset();
+        _freeEntries.push_back(index);
+    }
+
+    void TextureHandler::bind(int index, GLenum textureBindingIndex) {
+        Entry& entry = _entries[index];
+        entry.lastBound = _frame;
+
+        // An evicted texture comes back when it is used and fits in the budget
+        if(!entry.path.empty() && (entry.isUnloaded || entry.firstLevel > 0) && !_loader.isPending(*entry.texture)){
+            size_t currentSize = entry.texture->memorySize();
+            size_t growth = entry.completeSize > currentSize ? entry.completeSize - currentSize : 0;
+            if(_memoryBudget == 0 || _memoryUsage + growth <= _memoryBudget){
+                _loader.reload(*entry.texture, entry.path, entry.compression);
+                entry.pendingSize = entry.completeSize;
+                entry.firstLevel = 0;
+                entry.isUnloaded = false;
+                _memoryUsage += growth;
+            }
+        }
+
+        entry.texture->bind(textureBindingIndex);
+    }
+
+    size_t TextureHandler::evict(Entry& entry) {
+        Texture& texture = *entry.texture;
+        size_t size = texture.memorySize();
+        if(entry.firstLevel == 0)
+            entry.completeSize = size;
+
+        // The cache is read on the ThreadPool: the texture keeps its levels until the lighter ones are uploaded
+        if(texture.width() > MIN_EVICTED_SIZE && texture.height() > MIN_EVICTED_SIZE && texture.levelCount() > 1){
+            ++entry.firstLevel;
+            _loader.reload(texture, entry.path, entry.compression, entry.firstLevel);
+            entry.pendingSize = size - texture.levelMemorySize(0);
+            return size - entry.pendingSize;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        texture.setImage(1, 1, &entry.placeholder);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        entry.isUnloaded = true;
+        entry.firstLevel = 0;
+        return size - std::min(size, texture.memorySize());
+    }
+
+    void TextureHandler::update() {
+        ++_frame;
+        _loader.update();
+
+        _memoryUsage = 0;
+        for(const Entry& entry : _entries){
+            // A texture being reloaded counts for what it will be, or the eviction would go on while it uploads
+            if(entry.texture)
+                _memoryUsage += entry.pendingSize > 0 && _loader.isPending(*entry.texture) ? entry.pendingSize : entry.texture->memorySize();
+        }
+
+        if(_memoryBudget == 0 || _memoryUsage <= _memoryBudget){
+            _overBudgetReported = false;
+            return;
+        }
+
+        // Least recently bound first, sparing what the last frame used
+        std::vector<int> candidates;
+        for(int i = 0; i < static_cast<int>(_entries.size()); ++i){
+            const Entry& entry = _entries[i];
+            if(entry.texture && !entry.path.empty() && !entry.isUnloaded && entry.lastBound + 1 < _frame && !_loader.isPending(*entry.texture))
+                candidates.push_back(i);
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](int a, int b){ return _entries[a].lastBound < _entries[b].lastBound; });
+
+        for(int index : candidates){
+            if(_memoryUsage <= _memoryBudget)
+                break;
+
+            _memoryUsage -= std::min(_memoryUsage, evict(_entries[index]));
+        }
+
+        if(_memoryUsage > _memoryBudget && !_overBudgetReported){
+            LOG(WARNING) << "TextureHandler: " << _memoryUsage << " bytes of textures in use, over the budget of " << _memoryBudget << " bytes";
+            _overBudgetReported = true;
+        }
+    }
+
+    void TextureHandler::setMemoryBudget(size_t bytes) {
+        _memoryBudget = bytes;
+    }
+
+    size_t TextureHandler::memoryUsage() const {
+        return _memoryUsage;
+    }
+
+    TextureLoader& TextureHandler::loader() {
+        return _loader;
     }
 }
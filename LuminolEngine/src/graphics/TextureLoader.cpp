@@ -0,0 +1,137 @@
+#include "graphics/TextureLoader.hpp"
+#include "graphics/GLState.hpp"
+#include "graphics/StreamingBuffer.hpp"
+#include "graphics/ThreadPool.hpp"
+#include <algorithm>
+#include <limits>
+#include <glog/logging.h>
+
+using namespace Graphics;
+
+TextureLoader::TextureLoader(size_t uploadBudget): _uploadBudget(uploadBudget) {}
+
+void TextureLoader::load(Texture &texture, const std::string &path, TextureCompression compression, const glm::u8vec3 &placeholder) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture.setImage(1, 1, &placeholder);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    reload(texture, path, compression);
+}
+
+void TextureLoader::reload(Texture &texture, const std::string &path, TextureCompression compression, int firstLevel) {
+    cancel(texture);
+
+    if(!TextureCompressor::isSupported(compression)){
+        LOG(WARNING) << path << ": texture compression not supported, loaded uncompressed";
+        compression = COMPRESSION_NONE;
+    }
+
+    Request request;
+    request.texture = &texture;
+    request.path = path;
+    request.start = std::chrono::steady_clock::now();
+    request.firstLevel = firstLevel;
+    request.nextLevel = -1;
+    request.decoded = ThreadPool::global().enqueue([path, compression](){
+        std::unique_ptr<TextureCache> cache(new TextureCache());
+        if(!cache->load(path, compression))
+            cache.reset();
+        return cache;
+    });
+
+    _decoding.push_back(std::move(request));
+}
+
+void TextureLoader::update() {
+    for(auto it = _decoding.begin(); it != _decoding.end();){
+        if(it->decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            ++it;
+            continue;
+        }
+
+        // A texture which can't be read keeps its placeholder, TextureCache already logged why
+        it->cache = it->decoded.get();
+        if(it->cache){
+            it->firstLevel = std::min(it->firstLevel, it->cache->levelCount() - 1);
+            it->nextLevel = it->cache->levelCount() - 1;
+            _uploading.push_back(std::move(*it));
+        }
+        it = _decoding.erase(it);
+    }
+
+    size_t budget = _uploadBudget;
+    while(!_uploading.empty() && budget > 0){
+        Request& request = _uploading.front();
+        budget -= std::min(budget, uploadLevel(request));
+
+        if(request.nextLevel >= request.firstLevel)
+            continue;
+
+        const TextureCache::Level& first = request.cache->level(request.firstLevel);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - request.start);
+        LOG(INFO) << request.path << ": " << first.width << "x" << first.height
+                  << " texture loaded in " << duration.count() << " ms";
+        _uploading.pop_front();
+    }
+}
+
+size_t TextureLoader::uploadLevel(Request &request) {
+    const TextureCache& cache = *request.cache;
+    const int level = request.nextLevel;
+    const int textureLevel = level - request.firstLevel;
+
+    // The placeholder is replaced by the full chain storage with the first (smallest) level
+    if(level == cache.levelCount() - 1){
+        const TextureCache::Level& first = cache.level(request.firstLevel);
+        request.texture->setLevels(TextureCompressor::internalFormat(cache.compression()), first.width, first.height,
+                                   cache.levelCount() - request.firstLevel);
+    }
+
+    const TextureCache::Level& data = cache.level(level);
+    GLsizei compressedSize = cache.compression() == COMPRESSION_NONE ? 0 : static_cast<GLsizei>(data.size);
+
+    StreamingBuffer::Allocation allocation = StreamingBuffer::global().upload(data.data, data.size);
+    if(allocation.buffer){
+        // The copy from the buffer runs asynchronously, the fence of the frame region protects it
+        GLState::global().bindBuffer(GL_PIXEL_UNPACK_BUFFER, allocation.buffer);
+        request.texture->setLevel(textureLevel, reinterpret_cast<const void*>(allocation.offset), compressedSize);
+        GLState::global().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else{
+        request.texture->setLevel(textureLevel, data.data, compressedSize);
+    }
+    request.texture->setBaseLevel(textureLevel);
+
+    request.nextLevel = level - 1;
+    return data.size;
+}
+
+void TextureLoader::finish() {
+    for(auto& request : _decoding)
+        request.decoded.wait();
+
+    size_t budget = _uploadBudget;
+    _uploadBudget = std::numeric_limits<size_t>::max();
+    update();
+    _uploadBudget = budget;
+}
+
+void TextureLoader::cancel(const Texture &texture) {
+    // A decoding task still running finishes on its own, its result is dropped with the future
+    auto isTexture = [&texture](const Request& request){ return request.texture == &texture; };
+    _decoding.erase(std::remove_if(_decoding.begin(), _decoding.end(), isTexture), _decoding.end());
+    _uploading.erase(std::remove_if(_uploading.begin(), _uploading.end(), isTexture), _uploading.end());
+}
+
+bool TextureLoader::isPending(const Texture &texture) const {
+    auto isTexture = [&texture](const Request& request){ return request.texture == &texture; };
+    return std::any_of(_decoding.begin(), _decoding.end(), isTexture) || std::any_of(_uploading.begin(), _uploading.end(), isTexture);
+}
+
+size_t TextureLoader::pendingCount() const {
+    return _decoding.size() + _uploading.size();
+}
+
+void TextureLoader::setUploadBudget(size_t bytes) {
+    _uploadBudget = bytes;
+}
@@ -0,0 +1,249 @@
+#include "graphics/TgaImage.hpp"
+#include "graphics/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <glog/logging.h>
+
+using namespace Graphics;
+
+namespace {
+
+    const size_t TGA_HEADER_SIZE = 18;
+
+    enum TgaImageType{
+        TGA_TRUECOLOR = 2,
+        TGA_GREY = 3,
+        TGA_RLE_TRUECOLOR = 10,
+        TGA_RLE_GREY = 11
+    };
+
+    /** Bit 5 of the descriptor: rows are stored top first */
+    const unsigned char TGA_TOP_ORIGIN = 0x20;
+
+    /** Rows decoded or copied per task */
+    const int ROW_GRAIN = 64;
+
+    /** Where the decoding of a block of rows starts in the RLE stream */
+    struct RlePosition{
+        size_t offset;  /** Offset of the packet holding the first pixel of the block */
+        int skip;       /** Pixels of that packet belonging to the previous block */
+    };
+
+    inline int readShort(const unsigned char* data){
+        return data[0] | (data[1] << 8);
+    }
+
+    /**
+     * Decode the pixels [first, last[ of an RLE stream starting at position.
+     * Rows are written flipped if the file is stored bottom first. Returns false if the stream ends too early.
+     */
+    bool decodeRle(const unsigned char* data, size_t size, RlePosition position, size_t first, size_t last,
+                   int width, int height, int channels, bool flip, unsigned char* out){
+        size_t offset = position.offset;
+        size_t pixel = first;
+        int skip = position.skip;
+
+        while(pixel < last){
+            if(offset >= size)
+                return false;
+            unsigned char header = data[offset++];
+            int count = (header & 0x7f) + 1 - skip;
+            bool isRun = (header & 0x80) != 0;
+
+            if(isRun){
+                if(offset + channels > size)
+                    return false;
+            }
+            else{
+                offset += skip * channels;
+                if(offset + size_t(count) * channels > size)
+                    return false;
+            }
+            skip = 0;
+
+            for(int i = 0; i < count && pixel < last; ++i, ++pixel){
+                size_t row = pixel / width;
+                size_t column = pixel % width;
+                size_t targetRow = flip ? height - 1 - row : row;
+                std::memcpy(out + (targetRow * width + column) * channels, data + offset, channels);
+                if(!isRun)
+                    offset += channels;
+            }
+            if(isRun)
+                offset += channels;
+        }
+        return true;
+    }
+}
+
+TgaImage::TgaImage(): _pixels(nullptr), _width(0), _height(0), _channels(0) {}
+
+bool TgaImage::open(const std::string &path) {
+    auto start = std::chrono::steady_clock::now();
+
+    if(!_file.open(path) || !parse(_file.data(), _file.size())){
+        _file.close();
+        return false;
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    double megabytes = double(_width) * _height * _channels / (1 << 20);
+    LOG(INFO) << path << ": " << _width << "x" << _height << " TGA read in " << duration.count() << " us ("
+              << (isZeroCopy() ? "mapped" : "decoded") << ", " << megabytes * 1e6 / std::max<int64_t>(1, duration.count()) << " MB/s)";
+    return true;
+}
+
+bool TgaImage::parse(const char *fileData, size_t size) {
+    _decoded.clear();
+    _pixels = nullptr;
+    _width = _height = _channels = 0;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(fileData);
+    if(size < TGA_HEADER_SIZE)
+        return false;
+
+    const int idLength = data[0];
+    const int colorMapType = data[1];
+    const int imageType = data[2];
+    const int width = readShort(data + 12);
+    const int height = readShort(data + 14);
+    const int bitsPerPixel = data[16];
+    const bool flip = (data[17] & TGA_TOP_ORIGIN) == 0;
+
+    const bool isGrey = imageType == TGA_GREY || imageType == TGA_RLE_GREY;
+    const bool isRle = imageType == TGA_RLE_TRUECOLOR || imageType == TGA_RLE_GREY;
+    if(colorMapType != 0 || width == 0 || height == 0
+       || (imageType != TGA_TRUECOLOR && imageType != TGA_GREY && !isRle)
+       || (isGrey && bitsPerPixel != 8) || (!isGrey && bitsPerPixel != 24 && bitsPerPixel != 32))
+        return false;
+
+    const int channels = bitsPerPixel / 8;
+    const size_t rowSize = size_t(width) * channels;
+    const size_t pixelsOffset = TGA_HEADER_SIZE + idLength;
+    if(pixelsOffset > size)
+        return false;
+
+    ThreadPool& pool = ThreadPool::global();
+
+    if(!isRle){
+        if(size - pixelsOffset < rowSize * height)
+            return false;
+
+        const unsigned char* pixels = data + pixelsOffset;
+        if(!flip){
+            _pixels = pixels;
+        }
+        else{
+            _decoded.resize(rowSize * height);
+            pool.parallelFor(0, height, ROW_GRAIN, [&](int first, int last){
+                for(int row = first; row < last; ++row)
+                    std::memcpy(&_decoded[(height - 1 - row) * rowSize], pixels + row * rowSize, rowSize);
+            });
+            _pixels = _decoded.data();
+        }
+    }
+    else{
+        // Packets may cross rows: a quick pass over the packet headers finds where each block of rows starts
+        const size_t pixelCount = size_t(width) * height;
+        const size_t blockPixels = size_t(ROW_GRAIN) * width;
+        std::vector<RlePosition> starts;
+
+        size_t offset = pixelsOffset;
+        size_t pixel = 0;
+        size_t nextBlock = 0;
+        while(pixel < pixelCount){
+            if(offset >= size)
+                return false;
+            unsigned char header = data[offset];
+            size_t count = (header & 0x7f) + 1;
+
+            for(; nextBlock < pixel + count && nextBlock < pixelCount; nextBlock += blockPixels){
+                RlePosition position = {offset, static_cast<int>(nextBlock - pixel)};
+                starts.push_back(position);
+            }
+
+            offset += 1 + ((header & 0x80) ? channels : count * channels);
+            pixel += count;
+        }
+
+        _decoded.resize(rowSize * height);
+        std::atomic<bool> isValid(true);
+        pool.parallelFor(0, static_cast<int>(starts.size()), 1, [&](int first, int last){
+            for(int block = first; block < last; ++block){
+                size_t begin = block * blockPixels;
+                size_t end = std::min(pixelCount, begin + blockPixels);
+                if(!decodeRle(data, size, starts[block], begin, end, width, height, channels, flip, _decoded.data()))
+                    isValid.store(false, std::memory_order_relaxed);
+            }
+        });
+        if(!isValid.load(std::memory_order_relaxed)){
+            _decoded.clear();
+            return false;
+        }
+        _pixels = _decoded.data();
+    }
+
+    _width = width;
+    _height = height;
+    _channels = channels;
+    return true;
+}
+
+const unsigned char *TgaImage::pixels() const {
+    return _pixels;
+}
+
+int TgaImage::width() const {
+    return _width;
+}
+
+int TgaImage::height() const {
+    return _height;
+}
+
+int TgaImage::channels() const {
+    return _channels;
+}
+
+bool TgaImage::isZeroCopy() const {
+    return _pixels && _decoded.empty();
+}
+
+GLenum TgaImage::format() const {
+    return _channels == 1 ? GL_RED : _channels == 4 ? GL_BGRA : GL_BGR;
+}
+
+void TgaImage::copyRgb(unsigned char *rgb) const {
+    const int width = _width;
+    const int channels = _channels;
+    const unsigned char* pixels = _pixels;
+
+    ThreadPool::global().parallelFor(0, _height, ROW_GRAIN, [=](int first, int last){
+        for(int row = first; row < last; ++row){
+            const unsigned char* source = pixels + size_t(row) * width * channels;
+            unsigned char* target = rgb + size_t(row) * width * 3;
+            for(int x = 0; x < width; ++x, source += channels, target += 3){
+                if(channels == 1){
+                    target[0] = target[1] = target[2] = source[0];
+                }
+                else{
+                    target[0] = source[2];
+                    target[1] = source[1];
+                    target[2] = source[0];
+                }
+            }
+        }
+    });
+}
+
+bool TgaImage::isTga(const std::string &path) {
+    if(path.size() < 4)
+        return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".tga";
+}
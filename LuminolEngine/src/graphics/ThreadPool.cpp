@@ -0,0 +1,112 @@
+#include "graphics/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+
+using namespace Graphics;
+
+ThreadPool::ThreadPool(unsigned int threadCount): _stop(false) {
+    for(unsigned int i = 0; i < threadCount; ++i)
+        _workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _condition.notify_all();
+
+    for(auto& worker : _workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop() {
+    while(true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this](){ return _stop || !_tasks.empty(); });
+
+            if(_stop && _tasks.empty())
+                return;
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::push(std::function<void()>&& task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+unsigned int ThreadPool::size() const {
+    return _workers.size();
+}
+
+void ThreadPool::parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& func) {
+    int count = end - begin;
+    if(count <= 0)
+        return;
+
+    grainSize = std::max(grainSize, 1);
+    int chunkCount = std::min<int>((count + grainSize - 1) / grainSize, size() + 1);
+
+    if(chunkCount <= 1){
+        func(begin, end);
+        return;
+    }
+
+    struct Job{
+        std::atomic<int> next;
+        std::atomic<int> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto job = std::make_shared<Job>();
+    job->next = 0;
+    job->done = 0;
+
+    // Rounding the size up may leave the last chunks without elements: they are not run
+    int chunkSize = (count + chunkCount - 1) / chunkCount;
+    chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    // func is only called while a chunk is left, and the caller waits for every chunk: the pointer never dangles
+    const std::function<void(int, int)>* funcPtr = &func;
+    auto run = [job, funcPtr, begin, end, chunkSize, chunkCount](){
+        int chunk;
+        while((chunk = job->next++) < chunkCount){
+            int chunkBegin = begin + chunk * chunkSize;
+            (*funcPtr)(chunkBegin, chunkBegin + std::min(chunkSize, end - chunkBegin));
+
+            if(++job->done == chunkCount){
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished.notify_all();
+            }
+        }
+    };
+
+    for(int i = 1; i < chunkCount; ++i)
+        push(run);
+
+    run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job, chunkCount](){ return job->done == chunkCount; });
+}
+
+unsigned int ThreadPool::defaultThreadCount() {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
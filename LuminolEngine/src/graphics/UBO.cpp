@@ -1,32 +1,51 @@
 #include "graphics/UBO.hpp"
+#include "graphics/GLState.hpp"
+#include "graphics/StreamingBuffer.hpp"
 #include <cstring>
 #include <iostream>
 
 using namespace Graphics;
 
-UBO::UBO(GLuint bindingPointIndex, int sizeBuffer):_bindingPointIndex(bindingPointIndex), _sizeBuffer(sizeBuffer){
+UBO::UBO(GLuint bindingPointIndex, int sizeBuffer, bool isStreamed):
+    _bindingPointIndex(bindingPointIndex), _sizeBuffer(sizeBuffer), _isStreamed(isStreamed){
     glGenBuffers(1, &_bufferId);
     reserveBuffer(_sizeBuffer);
 }
 
 UBO::~UBO() {
+    if(GLState* state = GLState::existingGlobal())
+        state->forgetBuffer(_bufferId);
     glDeleteBuffers(1, &_bufferId);
 }
 
 void UBO::reserveBuffer(int size){
-    glBindBuffer(GL_UNIFORM_BUFFER, _bufferId);
+    GLState::global().bindBuffer(GL_UNIFORM_BUFFER, _bufferId);
     glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GLState::global().bindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void UBO::updateBuffer(const GLvoid* data, int sizeofObject) {
+    if(_isStreamed){
+        StreamingBuffer::Allocation allocation = StreamingBuffer::global().upload(data, sizeofObject, offsetAlignment());
+        if(allocation.buffer){
+            GLState::global().bindBufferRange(GL_UNIFORM_BUFFER, _bindingPointIndex, allocation.buffer, allocation.offset, sizeofObject);
+            return;
+        }
+
+        // The frame region is full: orphan our own storage instead
+        _sizeBuffer = sizeofObject;
+        GLState::global().bindBufferBase(GL_UNIFORM_BUFFER, _bindingPointIndex, _bufferId);
+        glBufferData(GL_UNIFORM_BUFFER, sizeofObject, data, GL_STREAM_DRAW);
+        return;
+    }
+
     if(sizeofObject > _sizeBuffer){
         _sizeBuffer = sizeofObject;
         reserveBuffer(_sizeBuffer);
         std::cout << "UBO buffer has been resized: UBO " << this << std::endl;
     }
 
-    glBindBufferBase(GL_UNIFORM_BUFFER, _bindingPointIndex, _bufferId);
+    GLState::global().bindBufferBase(GL_UNIFORM_BUFFER, _bindingPointIndex, _bufferId);
     GLvoid* uboData = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
     std::memcpy(uboData, data, sizeofObject);
     glUnmapBuffer(GL_UNIFORM_BUFFER);
@@ -34,4 +53,18 @@ void UBO::updateBuffer(const GLvoid* data, int sizeofObject) {
 
 GLuint UBO::bindingPoint() const{
     return _bindingPointIndex;
-}
\ No newline at end of file
+}
+
+bool UBO::isStreamed() const{
+    return _isStreamed;
+}
+
+GLint UBO::offsetAlignment(){
+    static GLint alignment = 0;
+    if(alignment == 0){
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if(alignment <= 0)
+            alignment = 256;
+    }
+    return alignment;
+}
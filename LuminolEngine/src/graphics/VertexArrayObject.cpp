@@ -3,6 +3,7 @@
 //
 
 #include "graphics/VertexArrayObject.h"
+#include "graphics/GLState.hpp"
 #include <iostream>
 #include <glog/logging.h>
 
@@ -17,24 +18,36 @@ namespace Graphics
         _glId = other._glId;
         other._glId = 0;
         std::swap(_vbos, other._vbos);
+        std::swap(_vboGenerations, other._vboGenerations);
         std::swap(_isInGPU, other._isInGPU);
     }
 
     VertexArrayObject::VertexArrayObject(const VertexArrayObject &other) : VertexArrayObject(other._isInGPU) {
         _vbos = other._vbos;
+        _vboGenerations = other._vboGenerations;
     }
 
     VertexArrayObject::~VertexArrayObject() {
+        if(GLState* state = GLState::existingGlobal())
+            state->forgetVertexArray(_glId);
         glDeleteVertexArrays(1, &_glId);
         _glId = 0;
     }
 
     void VertexArrayObject::addVBO(VertexBufferObject *vbo) {
         _vbos.push_back(vbo);
+        _vboGenerations.push_back(vbo->streamGeneration());
     }
 
     void VertexArrayObject::bind() {
-        glBindVertexArray(_glId);
+        GLState::global().bindVertexArray(_glId);
+
+        for(size_t i = 0; i < _vbos.size(); ++i){
+            if(_vbos[i]->streamGeneration() != _vboGenerations[i]){
+                _vbos[i]->init();
+                _vboGenerations[i] = _vbos[i]->streamGeneration();
+            }
+        }
     }
 
     void VertexArrayObject::initGL() {
@@ -50,9 +63,10 @@ namespace Graphics
         if(!_isInGPU)
             initGL();
 
-        bind();
-        for(auto& vbo : _vbos){
-            vbo->init();
+        GLState::global().bindVertexArray(_glId);
+        for(size_t i = 0; i < _vbos.size(); ++i){
+            _vbos[i]->init();
+            _vboGenerations[i] = _vbos[i]->streamGeneration();
         }
     }
 
@@ -61,7 +75,7 @@ namespace Graphics
     }
 
     void VertexArrayObject::unbindAll() {
-        glBindVertexArray(0);
+        GLState::global().bindVertexArray(0);
     }
 
 
@@ -72,6 +86,7 @@ namespace Graphics
 
     void VertexArrayObject::clearVBOs() {
         _vbos.clear();
+        _vboGenerations.clear();
     }
 
 }
\ No newline at end of file
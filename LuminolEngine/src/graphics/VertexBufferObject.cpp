@@ -3,13 +3,18 @@
 //
 
 #include "graphics/VertexBufferObject.h"
+#include "graphics/GLState.hpp"
+#include "graphics/StreamingBuffer.hpp"
 #include <iostream>
+#include <stdexcept>
 #include <glog/logging.h>
 
 namespace Graphics
 {
 
-    VertexBufferObject::VertexBufferObject(DataType dataType, GLuint attribArray, bool initGL) : _dataType(dataType), _attribArray(attribArray), _isInGPU(initGL) {
+    VertexBufferObject::VertexBufferObject(DataType dataType, GLuint attribArray, bool initGL, BufferUsage usage) :
+            _dataType(dataType), _attribArray(attribArray), _isInGPU(initGL),
+            _usage(usage), _capacity(0), _streamBuffer(0), _streamOffset(0), _streamGeneration(0) {
         if(initGL)
             glGenBuffers(1, &_glId);
         _target = _dataType == ELEMENT_ARRAY_BUFFER ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
@@ -21,10 +26,15 @@ namespace Graphics
         std::swap(_target, other._target);
         std::swap(_attribArray, other._attribArray);
         std::swap(_isInGPU, other._isInGPU);
+        std::swap(_usage, other._usage);
+        std::swap(_capacity, other._capacity);
+        std::swap(_streamBuffer, other._streamBuffer);
+        std::swap(_streamOffset, other._streamOffset);
+        std::swap(_streamGeneration, other._streamGeneration);
         other._glId = 0;
     }
 
-    VertexBufferObject::VertexBufferObject(const VertexBufferObject &other): VertexBufferObject(other._dataType, other._attribArray, other._isInGPU) {}
+    VertexBufferObject::VertexBufferObject(const VertexBufferObject &other): VertexBufferObject(other._dataType, other._attribArray, other._isInGPU, other._usage) {}
 
     void VertexBufferObject::initGL() {
         if(_isInGPU){
@@ -36,6 +46,8 @@ namespace Graphics
     }
 
     VertexBufferObject::~VertexBufferObject() {
+        if(GLState* state = GLState::existingGlobal())
+            state->forgetBuffer(_glId);
         glDeleteBuffers(1, &_glId);
         _glId = 0;
     }
@@ -46,7 +58,15 @@ namespace Graphics
 
         switch(_dataType){
             case VERTEX_DESCRIPTOR:
-                initVboVertexDescriptor();
+                initVboFormat<VertexDescriptor>();
+                break;
+
+            case COMPACT_VERTEX:
+                initVboFormat<CompactVertex>();
+                break;
+
+            case PACKED_VERTEX:
+                initVboFormat<PackedVertex>();
                 break;
 
             case VEC3:
@@ -69,6 +89,10 @@ namespace Graphics
                 initVboInstanceVec3();
                 break;
 
+            case INSTANCE_FLOAT_BUFFER:
+                initVboInstanceFloat();
+                break;
+
             case INSTANCE_TRANSFORMATION_BUFFER:
                 initVboInstanceMat4();
                 break;
@@ -78,50 +102,52 @@ namespace Graphics
         }
     }
 
-    void VertexBufferObject::initVboVertexDescriptor(){
+    template<typename Vertex>
+    void VertexBufferObject::initVboFormat(){
         bind();
-        // position
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Graphics::VertexDescriptor), (void*)0);
-
-        // normal
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Graphics::VertexDescriptor), (void*)(3*sizeof(GL_FLOAT)));
-
-        // uv
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Graphics::VertexDescriptor), (void*)(6*sizeof(GL_FLOAT)));
+        for(size_t i = 0; i < VertexFormat<Vertex>::attributeCount; ++i){
+            const VertexAttribute& attribute = VertexFormat<Vertex>::attributes[i];
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, sizeof(Vertex), attribOffset(attribute.offset));
+        }
     }
 
     void VertexBufferObject::initVboVec3(){
         bind();
         glEnableVertexAttribArray(_attribArray);
-        glVertexAttribPointer(_attribArray, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void*)0);
+        glVertexAttribPointer(_attribArray, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), attribOffset(0));
     }
 
     void VertexBufferObject::initVboVec2(){
         bind();
         glEnableVertexAttribArray(_attribArray);
-        glVertexAttribPointer(_attribArray, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GL_FLOAT), (void*)0);
+        glVertexAttribPointer(_attribArray, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GL_FLOAT), attribOffset(0));
     }
 
     void VertexBufferObject::initVboFloat(){
         bind();
         glEnableVertexAttribArray(_attribArray);
-        glVertexAttribPointer(_attribArray, 1, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glVertexAttribPointer(_attribArray, 1, GL_FLOAT, GL_FALSE, 0, attribOffset(0));
     }
 
     void VertexBufferObject::initVboInt(){
         bind();
         glEnableVertexAttribArray(_attribArray);
-        glVertexAttribPointer(_attribArray, 1, GL_INT, GL_FALSE, 0, (void*)0);
+        glVertexAttribPointer(_attribArray, 1, GL_INT, GL_FALSE, 0, attribOffset(0));
     }
 
 
     void VertexBufferObject::initVboInstanceVec3() {
         bind();
         glEnableVertexAttribArray( _attribArray );
-        glVertexAttribPointer( _attribArray, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), (void*)0 );
+        glVertexAttribPointer( _attribArray, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float), attribOffset(0) );
+        glVertexAttribDivisor( _attribArray, 1 );
+    }
+
+    void VertexBufferObject::initVboInstanceFloat() {
+        bind();
+        glEnableVertexAttribArray( _attribArray );
+        glVertexAttribPointer( _attribArray, 1, GL_FLOAT, GL_FALSE, sizeof(float), attribOffset(0) );
         glVertexAttribDivisor( _attribArray, 1 );
     }
 
@@ -131,48 +157,142 @@ namespace Graphics
         for( int c = 0; c < 4; ++c )
         {
             glEnableVertexAttribArray( _attribArray + c );
-            glVertexAttribPointer( _attribArray + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(c * sizeof(glm::vec4)) );
+            glVertexAttribPointer( _attribArray + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), attribOffset(c * sizeof(glm::vec4)) );
             glVertexAttribDivisor( _attribArray + c, 1 );
         }
     }
 
     void VertexBufferObject::bind(){
-        glBindBuffer(_target, _glId);
+        GLState::global().bindBuffer(_target, _streamBuffer ? _streamBuffer : _glId);
     }
 
     GLuint VertexBufferObject::glId(){
         return _glId;
     }
 
-    void VertexBufferObject::updateData(const std::vector<VertexDescriptor>& data){
+    const GLvoid* VertexBufferObject::attribOffset(size_t offset) const {
+        return (const GLvoid*)(_streamOffset + offset);
+    }
+
+    GLintptr VertexBufferObject::offset() const {
+        return _streamOffset;
+    }
+
+    unsigned int VertexBufferObject::streamGeneration() const {
+        return _streamGeneration;
+    }
+
+    void VertexBufferObject::upload(const void* data, GLsizeiptr size){
+        if(_usage == STREAM_USAGE && _dataType != ELEMENT_ARRAY_BUFFER){
+            StreamingBuffer::Allocation allocation = StreamingBuffer::global().upload(data, size);
+            if(allocation.buffer || _streamBuffer)
+                ++_streamGeneration;
+            _streamBuffer = allocation.buffer;
+            _streamOffset = allocation.offset;
+            if(_streamBuffer)
+                return;
+
+            // The frame region is full: orphan our own storage instead
+            bind();
+            glBufferData(_target, size, data, GL_STREAM_DRAW);
+            return;
+        }
+
         bind();
-        glBufferData(_target, data.size() * sizeof(Graphics::VertexDescriptor), data.data(), GL_STATIC_DRAW);
+
+        // Immutable storage: the driver knows the buffer will never be reallocated
+        if(_usage == IMMUTABLE_USAGE && GLEW_ARB_buffer_storage){
+            if(size == 0)
+                return;
+            if(_capacity == 0){
+                glBufferStorage(_target, size, data, GL_DYNAMIC_STORAGE_BIT);
+                _capacity = size;
+                return;
+            }
+            if(size > _capacity)
+                throw std::runtime_error("An IMMUTABLE_USAGE VertexBufferObject can't grow, use DYNAMIC_USAGE");
+            glBufferSubData(_target, 0, size, data);
+            return;
+        }
+
+        if(_usage == STATIC_USAGE){
+            glBufferData(_target, size, data, GL_STATIC_DRAW);
+            _capacity = size;
+            return;
+        }
+
+        // Storage is only reallocated when it grows
+        if(size > _capacity){
+            glBufferData(_target, size, data, _usage == IMMUTABLE_USAGE ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+            _capacity = size;
+        }
+        else{
+            glBufferSubData(_target, 0, size, data);
+        }
+    }
+
+    void VertexBufferObject::updateData(const std::vector<VertexDescriptor>& data){
+        updateData(data.data(), data.size());
+    }
+
+    void VertexBufferObject::updateData(const std::vector<CompactVertex>& data){
+        upload(data.data(), data.size() * sizeof(CompactVertex));
+    }
+
+    void VertexBufferObject::updateData(const std::vector<PackedVertex>& data){
+        upload(data.data(), data.size() * sizeof(PackedVertex));
     }
 
     void VertexBufferObject::updateData(const std::vector<glm::vec3>& data){
-        bind();
-        glBufferData(_target, data.size() * 3 * sizeof(GL_FLOAT), data.data(), GL_STATIC_DRAW);
+        updateData(data.data(), data.size());
     }
 
     void VertexBufferObject::updateData(const std::vector<glm::vec2>& data){
-        bind();
-        glBufferData(_target, data.size() * 2 * sizeof(GL_FLOAT), data.data(), GL_STATIC_DRAW);
+        upload(data.data(), data.size() * 2 * sizeof(GL_FLOAT));
     }
 
     void VertexBufferObject::updateData(const std::vector<float>& data){
-        bind();
-        glBufferData(_target, data.size() * sizeof(GL_FLOAT), data.data(), GL_STATIC_DRAW);
+        updateData(data.data(), data.size());
     }
 
     void VertexBufferObject::updateData(const std::vector<int>& data){
-        bind();
-        glBufferData(_target, data.size() * sizeof(GL_INT), data.data(), GL_STATIC_DRAW);
+        updateData(data.data(), data.size());
+    }
+
+    void VertexBufferObject::updateData(const std::vector<uint16_t>& data){
+        upload(data.data(), data.size() * sizeof(uint16_t));
     }
 
 
     void VertexBufferObject::updateData(const std::vector<glm::mat4> &data) {
+        upload(data.data(), data.size() * sizeof(glm::mat4));
+    }
+
+    void VertexBufferObject::updateData(const std::vector<glm::mat4> &data, size_t first, size_t count) {
+        // A streamed buffer moves at each update: it is sent whole
+        if(_usage == STREAM_USAGE){
+            updateData(data);
+            return;
+        }
+
         bind();
-        glBufferData(_target, data.size() * sizeof(glm::mat4), data.data(), GL_STATIC_DRAW);
+        glBufferSubData(_target, first * sizeof(glm::mat4), count * sizeof(glm::mat4), data.data() + first);
+    }
+
+    void VertexBufferObject::updateData(const VertexDescriptor* data, size_t count) {
+        upload(data, count * sizeof(Graphics::VertexDescriptor));
+    }
+
+    void VertexBufferObject::updateData(const int* data, size_t count) {
+        upload(data, count * sizeof(GL_INT));
+    }
+
+    void VertexBufferObject::updateData(const glm::vec3* data, size_t count) {
+        upload(data, count * 3 * sizeof(GL_FLOAT));
+    }
+
+    void VertexBufferObject::updateData(const float* data, size_t count) {
+        upload(data, count * sizeof(GL_FLOAT));
     }
 
     void VertexBufferObject::setAttribArray(GLuint value){
@@ -180,8 +300,8 @@ namespace Graphics
     }
 
     void VertexBufferObject::unbindAll(){
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+        GLState::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "graphics/VertexFormat.hpp"
+#include <glm/gtc/packing.hpp>
+#include <cstddef>
+
+using namespace Graphics;
+
+const VertexAttribute VertexFormat<VertexDescriptor>::attributes[] = {
+    {0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexDescriptor, position)},
+    {1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexDescriptor, normal)},
+    {2, 2, GL_FLOAT, GL_FALSE, offsetof(VertexDescriptor, texcoord)}
+};
+const size_t VertexFormat<VertexDescriptor>::attributeCount = 3;
+
+const VertexAttribute VertexFormat<CompactVertex>::attributes[] = {
+    {0, 3, GL_FLOAT, GL_FALSE, offsetof(CompactVertex, position)},
+    {1, 2, GL_SHORT, GL_TRUE, offsetof(CompactVertex, normal)},
+    {2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactVertex, texcoord)}
+};
+const size_t VertexFormat<CompactVertex>::attributeCount = 3;
+
+const VertexAttribute VertexFormat<PackedVertex>::attributes[] = {
+    {0, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, position)},
+    {1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal)},
+    {2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texcoord)}
+};
+const size_t VertexFormat<PackedVertex>::attributeCount = 3;
+
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex must not be padded");
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must not be padded");
+
+CompactVertex::CompactVertex(const VertexDescriptor &vertex):
+    position(vertex.position),
+    normal(packOctahedral(vertex.normal)),
+    texcoord(packHalf(vertex.texcoord.x), packHalf(vertex.texcoord.y))
+{}
+
+PackedVertex::PackedVertex(const VertexDescriptor &vertex):
+    position(packHalf(vertex.position.x), packHalf(vertex.position.y), packHalf(vertex.position.z), packHalf(1.f)),
+    normal(packOctahedral(vertex.normal)),
+    texcoord(packHalf(vertex.texcoord.x), packHalf(vertex.texcoord.y))
+{}
+
+namespace {
+    inline int16_t packSnorm(float value){
+        return static_cast<int16_t>(glm::round(glm::clamp(value, -1.f, 1.f) * 32767.f));
+    }
+
+    inline float unpackSnorm(int16_t value){
+        return glm::max(value / 32767.f, -1.f);
+    }
+
+    inline float signNotZero(float value){
+        return value >= 0.f ? 1.f : -1.f;
+    }
+}
+
+glm::i16vec2 Graphics::packOctahedral(const glm::vec3 &normal) {
+    // Project on the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+    float l1 = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+    if(l1 == 0.f)
+        return glm::i16vec2(0, 0);
+
+    glm::vec2 p = glm::vec2(normal.x, normal.y) / l1;
+    if(normal.z < 0.f)
+        p = glm::vec2((1.f - glm::abs(p.y)) * signNotZero(p.x), (1.f - glm::abs(p.x)) * signNotZero(p.y));
+
+    return glm::i16vec2(packSnorm(p.x), packSnorm(p.y));
+}
+
+glm::vec3 Graphics::unpackOctahedral(const glm::i16vec2 &packed) {
+    glm::vec3 n(unpackSnorm(packed.x), unpackSnorm(packed.y), 0.f);
+    n.z = 1.f - glm::abs(n.x) - glm::abs(n.y);
+
+    float t = glm::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+uint16_t Graphics::packHalf(float value) {
+    return glm::packHalf1x16(value);
+}
+
+float Graphics::unpackHalf(uint16_t value) {
+    return glm::unpackHalf1x16(value);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace PartyKel {
+
+// File de commandes remplie depuis n'importe quel thread et vidée par le thread qui possède les données,
+// à un moment où il peut les modifier sans risque (par exemple entre deux pas de simulation)
+class CommandQueue {
+public:
+    void push(std::function<void()> command) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingCommands.push_back(std::move(command));
+    }
+
+    // Exécute dans l'ordre les commandes reçues depuis le dernier appel
+    void execute() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            std::swap(m_PendingCommands, m_ExecutedCommands);
+        }
+
+        for(auto& command : m_ExecutedCommands) {
+            command();
+        }
+        m_ExecutedCommands.clear();
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::vector<std::function<void()>> m_PendingCommands;
+    std::vector<std::function<void()>> m_ExecutedCommands;
+};
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "PartyKel/glm.hpp"
+#include <vector>
+
+namespace PartyKel {
+
+// Calcule les normales par sommet d'une grille de gridWidth * gridHeight points, triangulée
+// comme dans FlagRenderer3D: chaque case (a, b = a + 1, c = a + 1 + w, d = a + w) donne (a, b, c) et (a, c, d).
+//
+// Deux passes réparties par bandes de lignes sur le ThreadPool du moteur:
+// - une normale par triangle, stockée en SoA, calculée une seule fois,
+// - pour chaque sommet, somme des normales des 6 triangles adjacents puis normalisation.
+// Le tableau de faces est entouré d'une bordure de faces nulles: aucune des deux boucles internes
+// ne contient de branchement, ce qui permet au compilateur de les vectoriser.
+class GridNormalGenerator {
+public:
+    GridNormalGenerator(int gridWidth, int gridHeight);
+
+    // positionArray et normalArray contiennent gridWidth * gridHeight éléments
+    void compute(const glm::vec3* positionArray, glm::vec3* normalArray);
+
+    int getGridWidth() const {
+        return m_nGridWidth;
+    }
+
+    int getGridHeight() const {
+        return m_nGridHeight;
+    }
+
+private:
+    void computeFaceNormals(const glm::vec3* positionArray, int firstRow, int lastRow);
+
+    void accumulateVertexNormals(glm::vec3* normalArray, int firstRow, int lastRow);
+
+    // Index dans le tableau de faces de la case (i, j), avec -1 <= i < gridWidth et -1 <= j < gridHeight
+    int faceIndex(int i, int j) const {
+        return (i + 1) + (j + 1) * m_nFaceStride;
+    }
+
+    int m_nGridWidth, m_nGridHeight;
+    int m_nFaceStride;
+
+    // Composantes des normales des triangles (a, b, c) et (a, c, d) de chaque case
+    std::vector<float> m_Face0X, m_Face0Y, m_Face0Z;
+    std::vector<float> m_Face1X, m_Face1Y, m_Face1Z;
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace PartyKel {
+
+// Exécute une fonction de pas de simulation sur un thread dédié, une frame en avance sur le rendu:
+// le thread de rendu lance le pas suivant puis dessine le dernier état publié pendant qu'il se calcule.
+// Le temps d'une frame devient le maximum des temps de simulation et de rendu au lieu de leur somme.
+class SimulationThread {
+public:
+    typedef std::function<void(float)> StepFunction;
+
+    explicit SimulationThread(StepFunction step);
+
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+
+    SimulationThread& operator =(const SimulationThread&) = delete;
+
+    // Attend la fin du pas précédent, lance step(dt) sur le thread de simulation et rend la main aussitôt
+    void requestStep(float dt);
+
+    // Attend la fin du pas en cours, s'il y en a un
+    void wait();
+
+private:
+    void run();
+
+    StepFunction m_Step;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_bStepPending, m_bStop;
+    float m_fStepDt;
+
+    // Déclaré en dernier: le thread ne démarre qu'une fois les autres membres initialisés
+    std::thread m_Thread;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+
+namespace PartyKel {
+
+// Échange sans verrou entre un producteur et un consommateur.
+// Le producteur écrit dans back() puis appelle publish(); le consommateur appelle update() pour récupérer
+// le dernier état publié complet, qu'il lit ensuite dans front(). Aucun des deux ne bloque jamais l'autre:
+// un état publié mais pas encore lu est simplement remplacé par le suivant.
+template<typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer(const T& initialValue = T()):
+        m_nBack(0), m_Middle(1), m_nFront(2) {
+        for(int i = 0; i < 3; ++i) {
+            m_Buffers[i] = initialValue;
+        }
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+
+    TripleBuffer& operator =(const TripleBuffer&) = delete;
+
+    // Côté producteur
+    T& back() {
+        return m_Buffers[m_nBack];
+    }
+
+    void publish() {
+        m_nBack = m_Middle.exchange(m_nBack | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Côté consommateur: renvoit true si un nouvel état a été récupéré
+    bool update() {
+        if(!(m_Middle.load(std::memory_order_relaxed) & FRESH_BIT)) {
+            return false;
+        }
+        m_nFront = m_Middle.exchange(m_nFront, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& front() const {
+        return m_Buffers[m_nFront];
+    }
+
+private:
+    // m_Middle contient l'index du buffer intermédiaire et un bit indiquant s'il a été publié depuis la dernière lecture
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+
+    T m_Buffers[3];
+    int m_nBack;
+    std::atomic<int> m_Middle;
+    int m_nFront;
+};
+
+}
@@ -8,6 +8,7 @@
 #include <glog/logging.h>
 #include "graphics/ShaderProgram.hpp"
 #include "graphics/DebugDrawer.h"   
+#include "graphics/BoxBatch.hpp"
 
 #define DEBUG 0
 
@@ -75,6 +76,11 @@ namespace PartyKel
          */
         void cleanRecursive();
 
+        /**
+         * Draw the boundaries of this voxel only, using LuminolEngine DebugDrawer
+         */
+        void drawBoundaries(Graphics::ShaderProgram& program);
+
     public:
         /**
          * This method only initialize depth, position & dimension of the octree
@@ -106,16 +112,26 @@ namespace PartyKel
 
         /**
          * Debug draw using LuminolEngine DebugDrawer.
-         * Draw the Boundaries of the octree
+         * Draw the Boundaries of the octree. Lines are drawn on the next DebugDrawer::submit() or flush()
          */
         void draw(Graphics::ShaderProgram& program);
 
         /**
          * Debug draw using LuminolEngine DebugDrawer.
-         * Draw the Boundaries of leafs that contain at least 1 value
+         * Draw the Boundaries of leafs that contain at least 1 value. Lines are drawn on the next DebugDrawer::submit() or flush()
          */
         void drawRecursive(Graphics::ShaderProgram& program);
 
+        /**
+         * Add the boundaries of the octree to a box batch, drawn with all its other boxes in a single instanced call
+         */
+        void addBoxes(Graphics::BoxBatch& boxes, const glm::vec3& color = glm::vec3(1));
+
+        /**
+         * Add the boundaries of leafs that contain at least 1 value to a box batch
+         */
+        void addBoxesRecursive(Graphics::BoxBatch& boxes, const glm::vec3& color = glm::vec3(1));
+
         void printRecursive();
 
     };
@@ -279,6 +295,27 @@ namespace PartyKel
                 );
     }
 
+    template <typename T>
+    void Octree<T>::drawBoundaries(Graphics::ShaderProgram& program){
+        glm::vec3 offset = _dimension / 2.f;
+
+        glm::vec3 points[8];
+        points[0] = glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z + offset.z);
+        points[1] = glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z + offset.z);
+        points[2] = glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z + offset.z);
+        points[3] = glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z + offset.z);
+        points[4] = glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z - offset.z);
+        points[5] = glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z - offset.z);
+        points[6] = glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z - offset.z);
+        points[7] = glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z - offset.z);
+
+        for(int i = 0; i < 4; ++i){
+            Graphics::DebugDrawer::drawRay(points[i], points[(i + 1) % 4], program);
+            Graphics::DebugDrawer::drawRay(points[4 + i], points[4 + (i + 1) % 4], program);
+            Graphics::DebugDrawer::drawRay(points[i], points[4 + i], program);
+        }
+    }
+
     template <typename T>
     void Octree<T>::drawRecursive(Graphics::ShaderProgram& program){
         if(_depth != 0 ){
@@ -290,59 +327,31 @@ namespace PartyKel
 
         if(_depth == 0 && _values.empty()) return;
 
-        glm::vec3 offset = _dimension / 2.f;
-
-        std::vector<glm::vec3> points;
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z - offset.z));
-
-        Graphics::DebugDrawer::drawRay(points[0], points[1], program);
-        Graphics::DebugDrawer::drawRay(points[1], points[2], program);
-        Graphics::DebugDrawer::drawRay(points[2], points[3], program);
-        Graphics::DebugDrawer::drawRay(points[3], points[0], program);
-        Graphics::DebugDrawer::drawRay(points[4], points[5], program);
-        Graphics::DebugDrawer::drawRay(points[5], points[6], program);
-        Graphics::DebugDrawer::drawRay(points[6], points[7], program);
-        Graphics::DebugDrawer::drawRay(points[7], points[4], program);
-        Graphics::DebugDrawer::drawRay(points[0], points[4], program);
-        Graphics::DebugDrawer::drawRay(points[1], points[5], program);
-        Graphics::DebugDrawer::drawRay(points[3], points[7], program);
-        Graphics::DebugDrawer::drawRay(points[2], points[6], program);
+        drawBoundaries(program);
     }
 
     template <typename T>
     void Octree<T>::draw(Graphics::ShaderProgram& program){
+        drawBoundaries(program);
+    }
 
-        glm::vec3 offset = _dimension / 2.f;
+    template <typename T>
+    void Octree<T>::addBoxes(Graphics::BoxBatch& boxes, const glm::vec3& color){
+        boxes.add(_position, _dimension / 2.f, color);
+    }
+
+    template <typename T>
+    void Octree<T>::addBoxesRecursive(Graphics::BoxBatch& boxes, const glm::vec3& color){
+        if(_depth != 0 ){
+            for(auto& child : _children){
+                child.addBoxesRecursive(boxes, color);
+            }
+            return;
+        }
+
+        if(_values.empty()) return;
 
-        std::vector<glm::vec3> points;
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z + offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y - offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x - offset.x, _position.y + offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y + offset.y, _position.z - offset.z));
-        points.push_back(glm::vec3(_position.x + offset.x, _position.y - offset.y, _position.z - offset.z));
-
-        Graphics::DebugDrawer::drawRay(points[0], points[1], program);
-        Graphics::DebugDrawer::drawRay(points[1], points[2], program);
-        Graphics::DebugDrawer::drawRay(points[2], points[3], program);
-        Graphics::DebugDrawer::drawRay(points[3], points[0], program);
-        Graphics::DebugDrawer::drawRay(points[4], points[5], program);
-        Graphics::DebugDrawer::drawRay(points[5], points[6], program);
-        Graphics::DebugDrawer::drawRay(points[6], points[7], program);
-        Graphics::DebugDrawer::drawRay(points[7], points[4], program);
-        Graphics::DebugDrawer::drawRay(points[0], points[4], program);
-        Graphics::DebugDrawer::drawRay(points[1], points[5], program);
-        Graphics::DebugDrawer::drawRay(points[3], points[7], program);
-        Graphics::DebugDrawer::drawRay(points[2], points[6], program);
+        boxes.add(_position, _dimension / 2.f, color);
     }
 
     template <typename T> 
@@ -4,15 +4,29 @@
 #include <GL/glew.h>
 #include <vector>
 
+#include "graphics/RenderQueue.hpp"
+
 namespace PartyKel {
 
 class FlagRenderer3D {
-	struct Vertex {
-		glm::vec3 position;
-		glm::vec3 normal;
-	};
 public:
-    FlagRenderer3D(int gridWidth, int gridHeight);
+    // Format des sommets envoyés à chaque frame
+    enum StreamFormat {
+        // Positions et normales en float: 24 octets par sommet
+        STREAM_FULL,
+        // Positions en float, normales octaédriques sur 2x16 bits: 16 octets par sommet
+        STREAM_COMPACT,
+        // Positions en half float (complétées à 4 composantes pour l'alignement), normales octaédriques: 12 octets par sommet
+        STREAM_PACKED
+    };
+
+    // Zone du buffer de streaming dans laquelle écrire les sommets de la prochaine frame, au format getStreamFormat()
+    struct StreamRegion {
+        void* positions; // gridWidth * gridHeight glm::vec3, ou glm::u16vec4 en half float pour STREAM_PACKED
+        void* normals;   // gridWidth * gridHeight glm::vec3, ou glm::i16vec2 (voir Graphics::packOctahedral) sinon
+    };
+
+    FlagRenderer3D(int gridWidth, int gridHeight, StreamFormat format = STREAM_COMPACT);
 
     ~FlagRenderer3D();
 
@@ -22,7 +36,29 @@ public:
 
 	void clear();
 
-	void drawGrid(const glm::vec3* positionArray, bool wireframe);
+	// Renvoit la prochaine région du buffer de streaming, après avoir attendu que le GPU ait fini de la lire.
+	// Le contenu doit être entièrement réécrit avant l'appel à submitGrid(queue, wireframe).
+	StreamRegion beginFrame();
+
+	// Ajoute à la file le dessin de la région remplie depuis le dernier appel à beginFrame.
+	// endFrame() doit être appelé une fois la file exécutée
+	void submitGrid(Graphics::RenderQueue& queue, bool wireframe);
+
+	// Copie positions et normales dans la prochaine région, en les compressant selon le format, puis ajoute son dessin à la file.
+	// Les normales sont fournies par l'appelant (voir GridNormalGenerator) pour n'être calculées qu'une fois par pas de simulation
+	void submitGrid(Graphics::RenderQueue& queue, const glm::vec3* positionArray, const glm::vec3* normalArray, bool wireframe);
+
+	// Marque la région comme lue par le GPU: à appeler après l'exécution de la file contenant le dessin de la grille
+	void endFrame();
+
+	StreamFormat getStreamFormat() const {
+		return m_StreamFormat;
+	}
+
+	// true si le buffer est mappé en permanence (ARB_buffer_storage), false si on retombe sur l'orphaning
+	bool isPersistentlyMapped() const {
+		return m_bPersistentMapping;
+	}
 
     void setProjMatrix(const glm::mat4& P) {
 		m_ProjMatrix = P;
@@ -35,19 +71,44 @@ public:
 private:
 	static const GLchar *VERTEX_SHADER, *FRAGMENT_SHADER;
 
+    // Nombre de régions du buffer de streaming quand il est mappé en permanence:
+    // le CPU écrit dans l'une pendant que le GPU lit les deux autres
+    static const int STREAM_REGION_COUNT = 3;
+
+    // Compresse les sommets [first, last[ dans la région courante
+    void packVertices(const glm::vec3* positionArray, const glm::vec3* normalArray, int first, int last);
+
+    // Uniforms de la grille, appelé par la file une fois le programme lié
+    static void setupGrid(void* renderer);
+
+    StreamFormat m_StreamFormat;
+    GLsizei m_nPositionStride, m_nNormalStride;
+
     // Ressources OpenGL
     GLuint m_ProgramID;
-    GLuint m_VBOID, m_VAOID, m_IBOID;
+    GLuint m_StreamVBOID, m_VAOID, m_IBOID;
+
+    // Buffer de streaming: [positions région 0 .. n-1][normales région 0 .. n-1].
+    // Une région est sélectionnée au dessin par le base vertex, sans toucher au VAO
+    bool m_bPersistentMapping;
+    int m_nRegionCount;
+    int m_nCurrentRegion;
+    GLsizeiptr m_nStreamSize;
+    void* m_pMappedStream;
+    // Sans mapping persistant, si glMapBufferRange échoue, la frame est écrite ici puis envoyée par glBufferSubData
+    bool m_bStreamMapped;
+    std::vector<char> m_FallbackStream;
+    GLsync m_RegionFences[STREAM_REGION_COUNT];
+    StreamRegion m_CurrentRegion;
 
     GLint m_uMVPMatrix, m_uMVMatrix;
+    GLint m_uOctahedralNormals;
 
     glm::mat4 m_ProjMatrix;
     glm::mat4 m_ViewMatrix;
 
     int m_nGridWidth, m_nGridHeight;
     uint32_t m_nIndexCount;
-
-    std::vector<Vertex> m_VertexBuffer;
 };
 
 }
@@ -8,4 +8,11 @@ namespace PartyKel {
 
 GLuint buildProgram(const GLchar* vertexShaderSrc, const GLchar* fragmentShaderSrc);
 
+// Première moitié de buildProgram: relit le programme depuis le cache de binaires, ou lance sa compilation sans attendre le pilote
+// (avec KHR_parallel_shader_compile, plusieurs programmes se compilent alors en même temps)
+GLuint startProgram(const GLchar* vertexShaderSrc, const GLchar* fragmentShaderSrc);
+
+// Seconde moitié: attend l'édition de liens, la vérifie et met le binaire en cache. Renvoie program, ou 0 en cas d'échec
+GLuint finishProgram(GLuint program);
+
 }
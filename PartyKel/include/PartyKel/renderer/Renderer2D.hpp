@@ -17,6 +17,7 @@ public:
 
     void clear();
 
+    // Dessine toutes les particules en un seul appel instancié
     void drawParticles(uint32_t count,
                        const glm::vec2* positionArray,
                        const float* massArray,
@@ -40,19 +41,26 @@ private:
     static const GLchar *POLYGON_VERTEX_SHADER, *POLYGON_FRAGMENT_SHADER;
     static const GLchar *LINE_VERTEX_SHADER, *LINE_FRAGMENT_SHADER;
 
+    // Attributs d'une particule, entrelacés dans le buffer d'instances
+    struct ParticleInstance {
+        glm::vec2 position;
+        float scale;
+        glm::vec3 color;
+    };
+
     // Ressources OpenGL
     GLuint m_ProgramID, m_PolygonProgramID, m_LineProgramID;
     GLuint m_VBOID, m_VAOID;
 
+    // Buffer d'instances réécrit à chaque frame; il n'est réalloué que lorsque le nombre de particules dépasse sa capacité
+    GLuint m_InstanceVBOID;
+    uint32_t m_nInstanceCapacity;
+
     GLuint m_PolygonVBOID, m_PolygonVAOID;
 
     GLuint m_LinePositionVBOID, m_LineColorVBOID, m_LineIBOID, m_LineVAOID;
 
     // Uniform locations
-    GLint m_uParticleColor;
-    GLint m_uParticlePosition;
-    GLint m_uParticleScale;
-
     GLint m_uPolygonColor;
 };
 
@@ -4,12 +4,26 @@
 #include <GL/glew.h>
 #include <vector>
 
+#include "graphics/RenderQueue.hpp"
+#include "graphics/VertexBufferObject.h"
+
 namespace PartyKel {
 
 class Renderer3D {
 public:
+    // Représentation des particules
+    enum ParticleMode {
+        // Un quad face à la caméra par particule; la sphère est lancée en rayon dans le fragment shader
+        PARTICLE_IMPOSTOR,
+        // Une sphère indexée par particule, dont la finesse dépend de sa taille à l'écran
+        PARTICLE_MESH
+    };
+
+    // Nombre de niveaux de détail des sphères
+    static const uint32_t LOD_COUNT = 4;
+
     Renderer3D();
- 
+
     ~Renderer3D();
 
     Renderer3D(const Renderer3D&) = delete;
@@ -17,12 +31,15 @@ public:
     Renderer3D& operator =(const Renderer3D&) = delete;
 
     void clear();
- 
-    void drawParticles(uint32_t count,
-                       const glm::vec3* positionArray,
-                       const float* massArray,
-                       const glm::vec3* colorArray,
-                       float massScale = 0.05);
+
+    // Ajoute à la file les appels instanciés dessinant toutes les particules: positions, masses et couleurs sont envoyées
+    // dans des buffers d'instances, qui doivent être dessinés avant le prochain appel
+    void submitParticles(Graphics::RenderQueue& queue,
+                         uint32_t count,
+                         const glm::vec3* positionArray,
+                         const float* massArray,
+                         const glm::vec3* colorArray,
+                         float massScale = 0.05);
 
     void setProjMatrix(const glm::mat4& P) {
         m_ProjMatrix = P;
@@ -32,20 +49,80 @@ public:
         m_ViewMatrix = V;
     }
 
+    void setParticleMode(ParticleMode mode) {
+        m_ParticleMode = mode;
+    }
+
+    ParticleMode getParticleMode() const {
+        return m_ParticleMode;
+    }
+
 private:
     static const GLchar *SPHERE_VERTEX_SHADER, *SPHERE_FRAGMENT_SHADER;
+    static const GLchar *IMPOSTOR_VERTEX_SHADER, *IMPOSTOR_FRAGMENT_SHADER;
+
+    // Envoie les attributs des particules dans les buffers d'instances
+    void uploadInstances(uint32_t count,
+                         const glm::vec3* positionArray,
+                         const float* massArray,
+                         const glm::vec3* colorArray);
+
+    // Fait commencer les attributs d'instance du VAO courant à l'instance firstInstance des données envoyées en dernier
+    void setInstanceOffset(uint32_t firstInstance);
+
+    void submitImpostors(Graphics::RenderQueue& queue, uint32_t count);
+
+    void submitMeshes(Graphics::RenderQueue& queue,
+                      uint32_t count,
+                      const glm::vec3* positionArray,
+                      const float* massArray,
+                      const glm::vec3* colorArray);
+
+    // Appelés par la file une fois le programme et le VAO liés: uniforms et attributs d'instance du paquet
+    static void setupImpostors(void* draw);
+    static void setupMeshes(void* draw);
+
+    // Données d'un paquet: les instances dessinées commencent à firstInstance
+    struct InstanceDraw {
+        Renderer3D* renderer;
+        uint32_t firstInstance;
+    };
+
+    ParticleMode m_ParticleMode;
+
+    // Un paquet par niveau de détail, l'imposteur utilise le premier
+    InstanceDraw m_InstanceDraws[LOD_COUNT];
+    float m_MassScale;
 
     // Ressources OpenGL
-    GLuint m_SphereProgramID;
-    GLuint m_SphereVBOID, m_SphereVAOID;
+    GLuint m_SphereProgramID, m_ImpostorProgramID;
+    GLuint m_SphereVBOID, m_SphereIBOID, m_SphereVAOID;
+    GLuint m_ImpostorVBOID, m_ImpostorVAOID;
+
+    // Attributs par instance, partagés par les deux représentations
+    Graphics::VertexBufferObject m_PositionInstanceVBO;
+    Graphics::VertexBufferObject m_MassInstanceVBO;
+    Graphics::VertexBufferObject m_ColorInstanceVBO;
 
-    uint32_t m_nSphereVertexCount;
+    // Sous-parties des buffers de sphère occupées par chaque niveau de détail
+    GLsizei m_LodIndexCount[LOD_COUNT];
+    GLsizei m_LodFirstIndex[LOD_COUNT];
+    GLint m_LodBaseVertex[LOD_COUNT];
+
+    // Particules réordonnées par niveau de détail, réutilisées d'une frame à l'autre
+    std::vector<uint8_t> m_ParticleLods;
+    std::vector<glm::vec3> m_SortedPositions;
+    std::vector<float> m_SortedMasses;
+    std::vector<glm::vec3> m_SortedColors;
 
     glm::mat4 m_ProjMatrix;
     glm::mat4 m_ViewMatrix;
 
-    GLint m_uMVPMatrix, m_uMVMatrix;
-    GLint m_uParticleColor;
+    GLint m_uProjMatrix, m_uViewMatrix;
+    GLint m_uMassScale;
+
+    GLint m_uImpostorProjMatrix, m_uImpostorViewMatrix;
+    GLint m_uImpostorMassScale;
 };
 
 }
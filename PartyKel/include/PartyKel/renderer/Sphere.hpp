@@ -34,9 +34,21 @@ public:
         return m_nVertexCount;
     }
 
+    // Version indexée: chaque sommet n'est stocké qu'une fois et les triangles sont décrits par getIndices()
+    const std::vector<Vertex>& getUniqueVertices() const {
+        return m_UniqueVertices;
+    }
+
+    const std::vector<GLuint>& getIndices() const {
+        return m_Indices;
+    }
+
 private:
     std::vector<Vertex> m_Vertices;
     GLsizei m_nVertexCount; // Nombre de sommets
+
+    std::vector<Vertex> m_UniqueVertices;
+    std::vector<GLuint> m_Indices;
 };
     
 }
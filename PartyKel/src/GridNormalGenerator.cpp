@@ -0,0 +1,115 @@
+#include "PartyKel/GridNormalGenerator.hpp"
+#include "graphics/ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PartyKel {
+
+// Nombre minimal de sommets traités par tâche: en dessous, le coût de synchronisation dépasse le gain
+static const int MIN_VERTICES_PER_TASK = 4096;
+
+GridNormalGenerator::GridNormalGenerator(int gridWidth, int gridHeight):
+    m_nGridWidth(gridWidth), m_nGridHeight(gridHeight),
+    m_nFaceStride(gridWidth + 1) {
+
+    // Bordure comprise: les cases d'index -1 et gridWidth - 1 (resp. gridHeight - 1) restent nulles
+    size_t faceCount = (gridWidth + 1) * (gridHeight + 1);
+    m_Face0X.assign(faceCount, 0.f);
+    m_Face0Y.assign(faceCount, 0.f);
+    m_Face0Z.assign(faceCount, 0.f);
+    m_Face1X.assign(faceCount, 0.f);
+    m_Face1Y.assign(faceCount, 0.f);
+    m_Face1Z.assign(faceCount, 0.f);
+}
+
+void GridNormalGenerator::compute(const glm::vec3* positionArray, glm::vec3* normalArray) {
+    Graphics::ThreadPool& pool = Graphics::ThreadPool::global();
+    int rowGrain = std::max(1, MIN_VERTICES_PER_TASK / std::max(1, m_nGridWidth));
+
+    // Les faces doivent toutes être calculées avant l'accumulation: parallelFor ne rend la main qu'une fois la passe terminée
+    pool.parallelFor(0, m_nGridHeight - 1, rowGrain, [this, positionArray](int firstRow, int lastRow) {
+        computeFaceNormals(positionArray, firstRow, lastRow);
+    });
+
+    pool.parallelFor(0, m_nGridHeight, rowGrain, [this, normalArray](int firstRow, int lastRow) {
+        accumulateVertexNormals(normalArray, firstRow, lastRow);
+    });
+}
+
+void GridNormalGenerator::computeFaceNormals(const glm::vec3* positionArray, int firstRow, int lastRow) {
+    const int w = m_nGridWidth;
+
+    for(int j = firstRow; j < lastRow; ++j) {
+        const glm::vec3* row = positionArray + j * w;
+        const glm::vec3* nextRow = row + w;
+
+        float* f0x = &m_Face0X[faceIndex(0, j)];
+        float* f0y = &m_Face0Y[faceIndex(0, j)];
+        float* f0z = &m_Face0Z[faceIndex(0, j)];
+        float* f1x = &m_Face1X[faceIndex(0, j)];
+        float* f1y = &m_Face1Y[faceIndex(0, j)];
+        float* f1z = &m_Face1Z[faceIndex(0, j)];
+
+        for(int i = 0; i < w - 1; ++i) {
+            const glm::vec3& A = row[i];
+            const glm::vec3& B = row[i + 1];
+            const glm::vec3& C = nextRow[i + 1];
+            const glm::vec3& D = nextRow[i];
+
+            float abx = B.x - A.x, aby = B.y - A.y, abz = B.z - A.z;
+            float acx = C.x - A.x, acy = C.y - A.y, acz = C.z - A.z;
+            float adx = D.x - A.x, ady = D.y - A.y, adz = D.z - A.z;
+
+            // Triangle (A, B, C)
+            float n0x = aby * acz - abz * acy;
+            float n0y = abz * acx - abx * acz;
+            float n0z = abx * acy - aby * acx;
+            float l0 = std::sqrt(n0x * n0x + n0y * n0y + n0z * n0z);
+            float rcp0 = l0 > 0.0001f ? 1.f / l0 : 0.f;
+
+            // Triangle (A, C, D)
+            float n1x = acy * adz - acz * ady;
+            float n1y = acz * adx - acx * adz;
+            float n1z = acx * ady - acy * adx;
+            float l1 = std::sqrt(n1x * n1x + n1y * n1y + n1z * n1z);
+            float rcp1 = l1 > 0.0001f ? 1.f / l1 : 0.f;
+
+            f0x[i] = n0x * rcp0;
+            f0y[i] = n0y * rcp0;
+            f0z[i] = n0z * rcp0;
+            f1x[i] = n1x * rcp1;
+            f1y[i] = n1y * rcp1;
+            f1z[i] = n1z * rcp1;
+        }
+    }
+}
+
+void GridNormalGenerator::accumulateVertexNormals(glm::vec3* normalArray, int firstRow, int lastRow) {
+    const int w = m_nGridWidth;
+
+    for(int j = firstRow; j < lastRow; ++j) {
+        // Cases adjacentes au sommet (i, j): (i - 1, j - 1) et (i, j) pour les deux triangles,
+        // (i, j - 1) pour le triangle (a, c, d), (i - 1, j) pour le triangle (a, b, c)
+        const int below = faceIndex(-1, j - 1);
+        const int above = faceIndex(-1, j);
+
+        glm::vec3* normals = normalArray + j * w;
+
+        for(int i = 0; i < w; ++i) {
+            float x = m_Face0X[below + i] + m_Face1X[below + i] + m_Face1X[below + i + 1]
+                    + m_Face0X[above + i] + m_Face0X[above + i + 1] + m_Face1X[above + i + 1];
+            float y = m_Face0Y[below + i] + m_Face1Y[below + i] + m_Face1Y[below + i + 1]
+                    + m_Face0Y[above + i] + m_Face0Y[above + i + 1] + m_Face1Y[above + i + 1];
+            float z = m_Face0Z[below + i] + m_Face1Z[below + i] + m_Face1Z[below + i + 1]
+                    + m_Face0Z[above + i] + m_Face0Z[above + i + 1] + m_Face1Z[above + i + 1];
+
+            float l = std::sqrt(x * x + y * y + z * z);
+            float rcp = l > 0.f ? 1.f / l : 0.f;
+
+            normals[i] = glm::vec3(x * rcp, y * rcp, z * rcp);
+        }
+    }
+}
+
+}
@@ -0,0 +1,57 @@
+#include "PartyKel/SimulationThread.hpp"
+
+namespace PartyKel {
+
+SimulationThread::SimulationThread(StepFunction step):
+    m_Step(std::move(step)),
+    m_bStepPending(false), m_bStop(false), m_fStepDt(0.f),
+    m_Thread(&SimulationThread::run, this) {
+}
+
+SimulationThread::~SimulationThread() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+    }
+    m_Condition.notify_all();
+    m_Thread.join();
+}
+
+void SimulationThread::requestStep(float dt) {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return !m_bStepPending; });
+
+    m_fStepDt = dt;
+    m_bStepPending = true;
+    m_Condition.notify_all();
+}
+
+void SimulationThread::wait() {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Condition.wait(lock, [this]() { return !m_bStepPending; });
+}
+
+void SimulationThread::run() {
+    while(true) {
+        float dt;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_bStepPending || m_bStop; });
+
+            if(m_bStop) {
+                return;
+            }
+            dt = m_fStepDt;
+        }
+
+        m_Step(dt);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStepPending = false;
+        }
+        m_Condition.notify_all();
+    }
+}
+
+}
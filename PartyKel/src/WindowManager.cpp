@@ -1,6 +1,9 @@
 #include "PartyKel/WindowManager.hpp"
 
 #include <GL/glew.h>
+#include "graphics/GLState.hpp"
+#include "graphics/ProgramCache.hpp"
+#include "graphics/StreamingBuffer.hpp"
 #include <iostream>
 #include <stdexcept>
 
@@ -25,12 +28,21 @@ WindowManager::WindowManager(uint32_t w, uint32_t h, const char *title) {
 }
 
 WindowManager::~WindowManager() {
+    // Les objets globaux du moteur sont détruits tant que le contexte GL existe encore,
+    // l'état GL en dernier car le buffer de streaming s'y retire
+    Graphics::StreamingBuffer::releaseGlobal();
+    Graphics::ProgramCache::releaseGlobal();
+    Graphics::GLState::releaseGlobal();
     SDL_Quit();
 }
 
 float WindowManager::update() {
     SDL_GL_SwapBuffers();
 
+    // Les données envoyées pendant la frame ne servent plus: leur région du buffer de streaming pourra être réécrite
+    Graphics::StreamingBuffer::endGlobalFrame();
+    Graphics::GLState::endGlobalFrame();
+
     Uint32 currentTime = SDL_GetTicks();
     Uint32 d = currentTime - m_nStartTime;
     if(d < m_nFrameDuration) {
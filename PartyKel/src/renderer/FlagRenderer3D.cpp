@@ -1,11 +1,19 @@
 #include "PartyKel/renderer/FlagRenderer3D.hpp"
 #include "PartyKel/renderer/GLtools.hpp"
+#include "graphics/GLState.hpp"
+#include "graphics/StreamingBuffer.hpp"
 #include "PartyKel/glm.hpp"
+#include "graphics/ThreadPool.hpp"
+#include "graphics/VertexFormat.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 namespace PartyKel {
 
+// Nombre minimal de sommets compressés par tâche
+static const int MIN_VERTICES_PER_TASK = 4096;
+
 const GLchar* FlagRenderer3D::VERTEX_SHADER =
 "#version 330 core\n"
 GL_STRINGIFY(
@@ -14,13 +22,24 @@ GL_STRINGIFY(
 
     uniform mat4 uMVPMatrix;
     uniform mat4 uMVMatrix;
+    // Normale octaédrique dans aVertexNormal.xy (formats compressés)
+    uniform bool uOctahedralNormals;
 
     out vec3 vFragPosition;
     out vec3 vFragNormal;
 
+    vec3 decodeOctahedral(vec2 e) {
+        vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+        float t = max(-n.z, 0.0);
+        n.x += n.x >= 0.0 ? -t : t;
+        n.y += n.y >= 0.0 ? -t : t;
+        return normalize(n);
+    }
+
     void main() {
+        vec3 normal = uOctahedralNormals ? decodeOctahedral(aVertexNormal.xy) : aVertexNormal;
         vFragPosition = vec3(uMVPMatrix * vec4(aVertexPosition, 1));
-        vFragNormal = vec3(uMVMatrix * vec4(aVertexNormal, 0));
+        vFragNormal = vec3(uMVMatrix * vec4(normal, 0));
         gl_Position = uMVPMatrix * vec4(aVertexPosition, 1);
     }
 );
@@ -38,15 +57,38 @@ GL_STRINGIFY(
     }
 );
 
-FlagRenderer3D::FlagRenderer3D(int gridWidth, int gridHeight):
-    m_ProgramID(buildProgram(VERTEX_SHADER, FRAGMENT_SHADER)),
+FlagRenderer3D::FlagRenderer3D(int gridWidth, int gridHeight, StreamFormat format):
+    m_StreamFormat(format),
+    m_nPositionStride(format == STREAM_PACKED ? sizeof(glm::u16vec4) : sizeof(glm::vec3)),
+    m_nNormalStride(format == STREAM_FULL ? sizeof(glm::vec3) : sizeof(glm::i16vec2)),
+    m_ProgramID(startProgram(VERTEX_SHADER, FRAGMENT_SHADER)),
+    m_bPersistentMapping(GLEW_ARB_buffer_storage), m_nRegionCount(m_bPersistentMapping ? STREAM_REGION_COUNT : 1),
+    m_nCurrentRegion(0), m_pMappedStream(nullptr), m_bStreamMapped(false),
     m_ProjMatrix(1.f), m_ViewMatrix(1.f),
-    m_nGridWidth(gridWidth), m_nGridHeight(gridHeight), m_nIndexCount(0),
-    m_VertexBuffer(gridWidth * gridHeight) {
+    m_nGridWidth(gridWidth), m_nGridHeight(gridHeight), m_nIndexCount(0) {
+
+    for(int i = 0; i < STREAM_REGION_COUNT; ++i) {
+        m_RegionFences[i] = 0;
+    }
+    m_CurrentRegion.positions = m_CurrentRegion.normals = nullptr;
+
+    // Création du buffer de streaming: positions et normales sont deux flux séparés
+    GLsizeiptr positionStreamSize = gridWidth * gridHeight * m_nPositionStride;
+    GLsizeiptr normalStreamSize = gridWidth * gridHeight * m_nNormalStride;
+    m_nStreamSize = m_nRegionCount * (positionStreamSize + normalStreamSize);
 
-    // Création du VBO
-    glGenBuffers(1, &m_VBOID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
+    glGenBuffers(1, &m_StreamVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_StreamVBOID);
+
+    if(m_bPersistentMapping) {
+        // Stockage immuable mappé une fois pour toutes: plus aucune réallocation ni synchronisation implicite du driver
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, m_nStreamSize, nullptr, flags);
+        m_pMappedStream = glMapBufferRange(GL_ARRAY_BUFFER, 0, m_nStreamSize, flags);
+    } else {
+        // Sans ARB_buffer_storage, le stockage est alloué une fois puis orphelin à chaque frame (voir beginFrame)
+        glBufferData(GL_ARRAY_BUFFER, m_nStreamSize, nullptr, GL_STREAM_DRAW);
+    }
 
     glGenBuffers(1, &m_IBOID);
 
@@ -68,25 +110,65 @@ FlagRenderer3D::FlagRenderer3D(int gridWidth, int gridHeight):
 
     // Création du VAO
     glGenVertexArrays(1, &m_VAOID);
-    glBindVertexArray(m_VAOID);
+    Graphics::GLState::global().bindVertexArray(m_VAOID);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBOID);
+    Graphics::GLState::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBOID);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.size() * sizeof(indexBuffer[0]), indexBuffer.data(), GL_STATIC_DRAW);
 
+    const GLvoid* normalOffset = (const GLvoid*) (m_nRegionCount * positionStreamSize);
+
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*) offsetof(Vertex, position));
+    if(m_StreamFormat == STREAM_PACKED) {
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, m_nPositionStride, 0);
+    } else {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_nPositionStride, 0);
+    }
+
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*) offsetof(Vertex, normal));
+    if(m_StreamFormat == STREAM_FULL) {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_nNormalStride, normalOffset);
+    } else {
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, m_nNormalStride, normalOffset);
+    }
+
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+    Graphics::GLState::global().bindVertexArray(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Compilé pendant la création des buffers
+    m_ProgramID = finishProgram(m_ProgramID);
 
     m_uMVPMatrix = glGetUniformLocation(m_ProgramID, "uMVPMatrix");
     m_uMVMatrix = glGetUniformLocation(m_ProgramID, "uMVMatrix");
+    m_uOctahedralNormals = glGetUniformLocation(m_ProgramID, "uOctahedralNormals");
 }
 
 FlagRenderer3D::~FlagRenderer3D() {
-    glDeleteBuffers(1, &m_VBOID);
+    for(int i = 0; i < STREAM_REGION_COUNT; ++i) {
+        if(m_RegionFences[i]) {
+            glDeleteSync(m_RegionFences[i]);
+        }
+    }
+
+    // Pas d'état GL à créer pendant la destruction: il n'existe peut-être plus
+    Graphics::GLState* state = Graphics::GLState::existingGlobal();
+    if(m_pMappedStream) {
+        if(state) {
+            state->bindBuffer(GL_ARRAY_BUFFER, m_StreamVBOID);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, m_StreamVBOID);
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    // Les noms peuvent être réutilisés par les prochains objets créés
+    if(state) {
+        state->forgetBuffer(m_StreamVBOID);
+        state->forgetBuffer(m_IBOID);
+        state->forgetVertexArray(m_VAOID);
+        state->forgetProgram(m_ProgramID);
+    }
+
+    glDeleteBuffers(1, &m_StreamVBOID);
     glDeleteBuffers(1, &m_IBOID);
     glDeleteVertexArrays(1, &m_VAOID);
     glDeleteProgram(m_ProgramID);
@@ -96,139 +178,114 @@ void FlagRenderer3D::clear() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void FlagRenderer3D::drawGrid(const glm::vec3* positionArray, bool wireframe) {
-    glEnable(GL_DEPTH_TEST);
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
-
-    for(int j = 0; j < m_nGridHeight; ++j) {
-        for(int i = 0; i < m_nGridWidth; ++i) {
-            m_VertexBuffer[i + j * m_nGridWidth].position = positionArray[i + j * m_nGridWidth];
-            
-            glm::vec3 N(0.f);
-            glm::vec3 M(0.f);
-
-            glm::vec3 A = positionArray[i + j * m_nGridWidth];
-
-            if(i > 0 && j > 0) {
-                glm::vec3 B = positionArray[(i - 1) + j * m_nGridWidth];
-                glm::vec3 C = positionArray[(i - 1) + (j - 1) * m_nGridWidth];
-
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
-
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
-
-            if(i > 0 && j > 0) {
-                glm::vec3 B = positionArray[(i - 1) + (j - 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[i + (j - 1) * m_nGridWidth];
+FlagRenderer3D::StreamRegion FlagRenderer3D::beginFrame() {
+    char* stream;
 
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
+    if(m_bPersistentMapping) {
+        m_nCurrentRegion = (m_nCurrentRegion + 1) % m_nRegionCount;
 
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
-
-            if(i < m_nGridWidth - 1 && j > 0) {
-                glm::vec3 B = positionArray[i + (j - 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[(i + 1) + (j - 1) * m_nGridWidth];
-
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
-
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
-
-            if(i < m_nGridWidth - 1 && j > 0) {
-                glm::vec3 B = positionArray[(i + 1) + (j - 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[(i + 1) + j * m_nGridWidth];
-
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
-
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
-
-            if(i < m_nGridWidth - 1 && j < m_nGridHeight - 1) {
-                glm::vec3 B = positionArray[(i + 1) + j * m_nGridWidth];
-                glm::vec3 C = positionArray[(i + 1) + (j + 1) * m_nGridWidth];
-
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
-
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
-
-            if(i < m_nGridWidth - 1 && j < m_nGridHeight - 1) {
-                glm::vec3 B = positionArray[(i + 1) + (j + 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[i + (j + 1) * m_nGridWidth];
-
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
+        // La région a été dessinée il y a m_nRegionCount frames: en pratique la barrière est déjà franchie
+        Graphics::waitAndDeleteFence(m_RegionFences[m_nCurrentRegion]);
+        stream = (char*) m_pMappedStream;
+    } else {
+        // Orphaning: le driver fournit un nouveau stockage si l'ancien est encore utilisé par le GPU
+        Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_StreamVBOID);
+        stream = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, m_nStreamSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        m_bStreamMapped = stream != nullptr;
+        if(!m_bStreamMapped) {
+            m_FallbackStream.resize(m_nStreamSize);
+            stream = m_FallbackStream.data();
+        }
+    }
 
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
+    size_t vertexCount = m_nGridWidth * m_nGridHeight;
+    char* normals = stream + m_nRegionCount * vertexCount * m_nPositionStride;
 
-            if(i > 0 && j < m_nGridHeight - 1) {
-                glm::vec3 B = positionArray[i + (j + 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[(i - 1) + (j + 1) * m_nGridWidth];
+    m_CurrentRegion.positions = stream + m_nCurrentRegion * vertexCount * m_nPositionStride;
+    m_CurrentRegion.normals = normals + m_nCurrentRegion * vertexCount * m_nNormalStride;
 
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
+    return m_CurrentRegion;
+}
 
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
+void FlagRenderer3D::packVertices(const glm::vec3* positionArray, const glm::vec3* normalArray, int first, int last) {
+    if(m_StreamFormat == STREAM_PACKED) {
+        glm::u16vec4* positions = (glm::u16vec4*) m_CurrentRegion.positions;
+        const uint16_t one = Graphics::packHalf(1.f);
+        for(int i = first; i < last; ++i) {
+            const glm::vec3& p = positionArray[i];
+            positions[i] = glm::u16vec4(Graphics::packHalf(p.x), Graphics::packHalf(p.y), Graphics::packHalf(p.z), one);
+        }
+    } else {
+        std::copy(positionArray + first, positionArray + last, (glm::vec3*) m_CurrentRegion.positions + first);
+    }
 
-            if(i > 0 && j < m_nGridHeight - 1) {
-                glm::vec3 B = positionArray[(i - 1) + (j + 1) * m_nGridWidth];
-                glm::vec3 C = positionArray[(i - 1) + j * m_nGridWidth];
-                // glm::vec3 D = positionArray[ i + (j-1) * m_nGridWidth];
+    if(m_StreamFormat == STREAM_FULL) {
+        std::copy(normalArray + first, normalArray + last, (glm::vec3*) m_CurrentRegion.normals + first);
+    } else {
+        glm::i16vec2* normals = (glm::i16vec2*) m_CurrentRegion.normals;
+        for(int i = first; i < last; ++i) {
+            normals[i] = Graphics::packOctahedral(normalArray[i]);
+        }
+    }
+}
 
-                glm::vec3 BxC = glm::cross(B - A, C - A);
-                float l = glm::length(BxC);
+void FlagRenderer3D::submitGrid(Graphics::RenderQueue& queue, const glm::vec3* positionArray, const glm::vec3* normalArray, bool wireframe) {
+    beginFrame();
 
+    if(m_StreamFormat == STREAM_FULL) {
+        packVertices(positionArray, normalArray, 0, m_nGridWidth * m_nGridHeight);
+    } else {
+        Graphics::ThreadPool::global().parallelFor(0, m_nGridWidth * m_nGridHeight, MIN_VERTICES_PER_TASK,
+            [this, positionArray, normalArray](int first, int last) {
+                packVertices(positionArray, normalArray, first, last);
+            });
+    }
 
-                if(l > 0.0001f) {
-                    N += BxC / l;
-                }
-            }
+    submitGrid(queue, wireframe);
+}
 
-            m_VertexBuffer[i + j * m_nGridWidth].normal = N != glm::vec3(0.f) ? glm::normalize(N) : glm::vec3(0.f);
-            // m_VertexBuffer[i + j * m_nGridWidth].normal = M != glm::vec3(0.f) ? glm::normalize(M) : glm::vec3(0.f);
+void FlagRenderer3D::submitGrid(Graphics::RenderQueue& queue, bool wireframe) {
+    if(!m_bPersistentMapping) {
+        Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_StreamVBOID);
+        if(m_bStreamMapped) {
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, m_nStreamSize, m_FallbackStream.data());
         }
-    } 
+    }
 
-    glBufferData(GL_ARRAY_BUFFER, m_VertexBuffer.size() * sizeof(m_VertexBuffer[0]), m_VertexBuffer.data(), GL_DYNAMIC_DRAW);
+    uint8_t state = Graphics::RENDER_DEPTH_TEST | (wireframe ? Graphics::RENDER_WIREFRAME : 0);
+
+    Graphics::RenderPacket packet;
+    packet.key = Graphics::RenderQueue::makeKey(Graphics::RENDER_PASS_OPAQUE, m_ProgramID, state, 0, 0.f);
+    packet.program = m_ProgramID;
+    packet.vertexArray = m_VAOID;
+    packet.indexType = GL_UNSIGNED_INT;
+    packet.count = m_nIndexCount;
+    // La région est sélectionnée par le base vertex
+    packet.baseVertex = m_nCurrentRegion * m_nGridWidth * m_nGridHeight;
+    packet.state = state;
+    packet.setup = &FlagRenderer3D::setupGrid;
+    packet.setupData = this;
+    queue.submit(packet);
+}
 
-    glUseProgram(m_ProgramID);
+void FlagRenderer3D::setupGrid(void* renderer) {
+    const FlagRenderer3D& self = *static_cast<FlagRenderer3D*>(renderer);
 
-    glUniformMatrix4fv(m_uMVPMatrix, 1, GL_FALSE, glm::value_ptr(m_ProjMatrix * m_ViewMatrix));
-    glUniformMatrix4fv(m_uMVMatrix, 1, GL_FALSE, glm::value_ptr(m_ViewMatrix));
+    glUniformMatrix4fv(self.m_uMVPMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ProjMatrix * self.m_ViewMatrix));
+    glUniformMatrix4fv(self.m_uMVMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ViewMatrix));
+    glUniform1i(self.m_uOctahedralNormals, self.m_StreamFormat != STREAM_FULL);
+}
 
-    if(wireframe) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    } else {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+void FlagRenderer3D::endFrame() {
+    if(m_bPersistentMapping) {
+        // Une barrière encore là n'a jamais été attendue (endFrame appelé sans beginFrame): la supprimer avant de la remplacer
+        if(m_RegionFences[m_nCurrentRegion]) {
+            glDeleteSync(m_RegionFences[m_nCurrentRegion]);
+        }
+        m_RegionFences[m_nCurrentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     }
-
-    glBindVertexArray(m_VAOID);
-        glDrawElements(GL_TRIANGLES, m_nIndexCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
 }
 
 }
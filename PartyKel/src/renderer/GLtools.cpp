@@ -1,73 +1,70 @@
 #include "PartyKel/renderer/GLtools.hpp"
 
+#include "graphics/ProgramCache.hpp"
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 
 namespace PartyKel {
 
-GLuint buildProgram(const GLchar* vertexShaderSource, const GLchar* fragmentShaderSource) {
-    // Creation d'un Vertex Shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+namespace {
 
-    // Spécification du code source
-    glShaderSource(vertexShader, 1, &vertexShaderSource, 0);
+// Clé de cache des programmes lancés par startProgram et pas encore vérifiés
+std::unordered_map<GLuint, uint64_t> pendingProgramKeys;
 
-    // Compilation du shader
-    glCompileShader(vertexShader);
-
-    /// Vérification que la compilation a bien fonctionnée (très important !)
+// Affiche le log de compilation d'un shader en échec. Renvoie false dans ce cas
+bool checkShader(GLuint shader, const char* name, const GLchar* source) {
     GLint compileStatus;
 
     // Récupération du status de compilation
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &compileStatus);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
     if(compileStatus == GL_FALSE) {
         // Si echec, récupération de la taille du log de compilation
         GLint logLength;
-        glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &logLength);
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
 
         // Allocation d'une chaine de caractère suffisement grande pour contenir le log
         char* log = new char[logLength];
 
-        glGetShaderInfoLog(vertexShader, logLength, 0, log);
-        std::cerr << "Vertex Shader error:" << log << std::endl;
-        std::cerr << vertexShaderSource << std::endl;
+        glGetShaderInfoLog(shader, logLength, 0, log);
+        std::cerr << name << " error:" << log << std::endl;
+        std::cerr << source << std::endl;
 
         delete [] log;
-        return 0;
+        return false;
     }
+    return true;
+}
 
-    // Creation d'un Fragment Shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Spécification du code source
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, 0);
-
-    // Compilation du shader
-    glCompileShader(fragmentShader);
-
-    /// Vérification que la compilation a bien fonctionnée (très important !)
-
-    // Récupération du status de compilation
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &compileStatus);
-    if(compileStatus == GL_FALSE) {
-        // Si echec, récupération de la taille du log de compilation
-        GLint logLength;
-        glGetShaderiv(fragmentShader, GL_INFO_LOG_LENGTH, &logLength);
+}
 
-        // Allocation d'une chaine de caractère suffisement grande pour contenir le log
-        char* log = new char[logLength];
+GLuint buildProgram(const GLchar* vertexShaderSource, const GLchar* fragmentShaderSource) {
+    return finishProgram(startProgram(vertexShaderSource, fragmentShaderSource));
+}
 
-        glGetShaderInfoLog(fragmentShader, logLength, 0, log);
-        std::cerr << "Fragment Shader error:" << log << std::endl;
-        std::cerr << fragmentShaderSource << std::endl;
+GLuint startProgram(const GLchar* vertexShaderSource, const GLchar* fragmentShaderSource) {
+    // Creation d'un programme
+    GLuint program = glCreateProgram();
 
-        delete [] log;
-        return 0;
+    // Déjà compilé lors d'un lancement précédent avec le même pilote
+    Graphics::ProgramCache& cache = Graphics::ProgramCache::global();
+    uint64_t key = cache.key({{GL_VERTEX_SHADER, vertexShaderSource}, {GL_FRAGMENT_SHADER, fragmentShaderSource}});
+    if(cache.load(program, key)) {
+        return program;
     }
 
-    GLuint program;
+    // Creation d'un Vertex Shader et d'un Fragment Shader
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
-    // Creation d'un programme
-    program = glCreateProgram();
+    // Spécification du code source
+    glShaderSource(vertexShader, 1, &vertexShaderSource, 0);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, 0);
+
+    // Compilation des shaders: le status n'est lu que par finishProgram, le pilote peut compiler en arrière-plan d'ici là
+    glCompileShader(vertexShader);
+    glCompileShader(fragmentShader);
 
     // Attachement des shaders au programme
     glAttachShader(program, vertexShader);
@@ -78,26 +75,60 @@ GLuint buildProgram(const GLchar* vertexShaderSource, const GLchar* fragmentShad
     glDeleteShader(fragmentShader);
 
     // Edition de lien
+    cache.prepare(program);
     glLinkProgram(program);
 
+    pendingProgramKeys[program] = key;
+    return program;
+}
+
+GLuint finishProgram(GLuint program) {
+    auto pending = pendingProgramKeys.find(program);
+    if(pending == pendingProgramKeys.end()) {
+        // Relu depuis le cache, déjà vérifié
+        return program;
+    }
+    uint64_t key = pending->second;
+    pendingProgramKeys.erase(pending);
+
     /// Vérification que l'édition de liens a bien fonctionnée (très important aussi !)
     GLint linkStatus;
     glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
     if(linkStatus == GL_FALSE) {
-        // Si echec, récupération de la taille du log de link
-        GLint logLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-        // Allocation d'une chaine de caractère suffisement grande pour contenir le log
-        char* log = new char[logLength];
-
-        glGetProgramInfoLog(program, logLength, 0, log);
-        std::cerr << "Program link error:" << log << std::endl;
-
-        delete [] log;
+        // Les erreurs de compilation expliquent mieux l'échec, les shaders sont encore attachés
+        GLuint shaders[2];
+        GLsizei shaderCount = 0;
+        glGetAttachedShaders(program, 2, &shaderCount, shaders);
+
+        bool compiled = true;
+        for(GLsizei i = 0; i < shaderCount; ++i) {
+            GLint type, sourceLength;
+            glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+            glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &sourceLength);
+            std::string source(std::max(sourceLength, 1), '\0');
+            glGetShaderSource(shaders[i], sourceLength, 0, &source[0]);
+            compiled = checkShader(shaders[i], type == GL_VERTEX_SHADER ? "Vertex Shader" : "Fragment Shader", source.c_str()) && compiled;
+        }
+
+        if(compiled) {
+            // Si echec, récupération de la taille du log de link
+            GLint logLength;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+
+            // Allocation d'une chaine de caractère suffisement grande pour contenir le log
+            char* log = new char[logLength];
+
+            glGetProgramInfoLog(program, logLength, 0, log);
+            std::cerr << "Program link error:" << log << std::endl;
+
+            delete [] log;
+        }
+
+        glDeleteProgram(program);
         return 0;
     }
 
+    Graphics::ProgramCache::global().save(program, key);
     return program;
 }
 
@@ -1,7 +1,11 @@
 #include "PartyKel/renderer/Renderer2D.hpp"
 #include "PartyKel/renderer/GLtools.hpp"
+#include "graphics/GLState.hpp"
 #include "PartyKel/glm.hpp"
 
+#include <algorithm>
+#include <cstddef>
+
 namespace PartyKel {
 
 const GLchar* Renderer2D::VERTEX_SHADER =
@@ -9,14 +13,18 @@ const GLchar* Renderer2D::VERTEX_SHADER =
 GL_STRINGIFY(
     layout(location = 0) in vec2 aVertexPosition;
 
-    uniform vec2 uParticlePosition;
-    uniform float uParticleScale;
+    // Attributs par particule
+    layout(location = 1) in vec2 aParticlePosition;
+    layout(location = 2) in float aParticleScale;
+    layout(location = 3) in vec3 aParticleColor;
 
     out vec2 vFragPosition;
+    flat out vec3 vParticleColor;
 
     void main() {
         vFragPosition = aVertexPosition;
-        gl_Position = vec4(uParticlePosition + uParticleScale * aVertexPosition, 0.f, 1.f);
+        vParticleColor = aParticleColor;
+        gl_Position = vec4(aParticlePosition + aParticleScale * aVertexPosition, 0.f, 1.f);
     }
 );
 
@@ -24,11 +32,10 @@ const GLchar* Renderer2D::FRAGMENT_SHADER =
 "#version 330 core\n"
 GL_STRINGIFY(
     in vec2 vFragPosition;
+    flat in vec3 vParticleColor;
 
     out vec4 fFragColor;
 
-    uniform vec3 uParticleColor;
-
     float computeAttenuation(float distance) {
         return 3.f * exp(-distance * distance * 9.f);
     }
@@ -36,7 +43,7 @@ GL_STRINGIFY(
     void main() {
         float distance = length(vFragPosition);
         float attenuation = computeAttenuation(distance);
-        fFragColor = vec4(uParticleColor, attenuation);
+        fFragColor = vec4(vParticleColor, attenuation);
     }
 );
 
@@ -89,20 +96,22 @@ GL_STRINGIFY(
 );
 
 Renderer2D::Renderer2D():
-    m_ProgramID(buildProgram(VERTEX_SHADER, FRAGMENT_SHADER)),
-    m_PolygonProgramID(buildProgram(POLYGON_VERTEX_SHADER, POLYGON_FRAGMENT_SHADER)),
-    m_LineProgramID(buildProgram(LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER)) {
+    m_ProgramID(startProgram(VERTEX_SHADER, FRAGMENT_SHADER)),
+    m_PolygonProgramID(startProgram(POLYGON_VERTEX_SHADER, POLYGON_FRAGMENT_SHADER)),
+    m_LineProgramID(startProgram(LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER)),
+    m_nInstanceCapacity(0) {
 
-    // Récuperation des uniforms
-    m_uParticleColor = glGetUniformLocation(m_ProgramID, "uParticleColor");
-    m_uParticlePosition = glGetUniformLocation(m_ProgramID, "uParticlePosition");
-    m_uParticleScale = glGetUniformLocation(m_ProgramID, "uParticleScale");
+    // Les trois programmes se compilent en même temps, on n'attend qu'ici
+    m_ProgramID = finishProgram(m_ProgramID);
+    m_PolygonProgramID = finishProgram(m_PolygonProgramID);
+    m_LineProgramID = finishProgram(m_LineProgramID);
 
+    // Récuperation des uniforms
     m_uPolygonColor = glGetUniformLocation(m_PolygonProgramID, "uPolygonColor");
 
     // Création du VBO
     glGenBuffers(1, &m_VBOID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_VBOID);
 
     // Une particule est un carré
     GLfloat positions[] = {
@@ -116,50 +125,76 @@ Renderer2D::Renderer2D():
 
     // Création du VAO
     glGenVertexArrays(1, &m_VAOID);
-    glBindVertexArray(m_VAOID);
+    Graphics::GLState::global().bindVertexArray(m_VAOID);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Attributs par instance: leur stockage est alloué au premier appel à drawParticles
+    glGenBuffers(1, &m_InstanceVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_InstanceVBOID);
+
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (const GLvoid*) offsetof(ParticleInstance, position));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (const GLvoid*) offsetof(ParticleInstance, scale));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (const GLvoid*) offsetof(ParticleInstance, color));
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribDivisor(3, 1);
+
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+    Graphics::GLState::global().bindVertexArray(0);
 
     glGenBuffers(1, &m_PolygonVBOID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_PolygonVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_PolygonVBOID);
     glGenVertexArrays(1, &m_PolygonVAOID);
-    glBindVertexArray(m_PolygonVAOID);
+    Graphics::GLState::global().bindVertexArray(m_PolygonVAOID);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+    Graphics::GLState::global().bindVertexArray(0);
 
     glGenBuffers(1, &m_LinePositionVBOID);
     glGenBuffers(1, &m_LineColorVBOID);
     glGenBuffers(1, &m_LineIBOID);
 
     glGenVertexArrays(1, &m_LineVAOID);
-    glBindVertexArray(m_LineVAOID);
+    Graphics::GLState::global().bindVertexArray(m_LineVAOID);
 
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, m_LinePositionVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_LinePositionVBOID);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
     glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, m_LineColorVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_LineColorVBOID);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+    Graphics::GLState::global().bindVertexArray(0);
 }
 
 Renderer2D::~Renderer2D() {
+    // Les noms peuvent être réutilisés par les prochains objets créés
+    Graphics::GLState& state = Graphics::GLState::global();
+    state.forgetProgram(m_ProgramID);
+    state.forgetProgram(m_PolygonProgramID);
+    state.forgetProgram(m_LineProgramID);
+    state.forgetBuffer(m_VBOID);
+    state.forgetBuffer(m_InstanceVBOID);
+    state.forgetBuffer(m_PolygonVBOID);
+    state.forgetVertexArray(m_VAOID);
+    state.forgetVertexArray(m_PolygonVAOID);
+
     glDeleteProgram(m_ProgramID);
     glDeleteProgram(m_PolygonProgramID);
     glDeleteProgram(m_LineProgramID);
 
     glDeleteBuffers(1, &m_VBOID);
+    glDeleteBuffers(1, &m_InstanceVBOID);
     glDeleteBuffers(1, &m_PolygonVBOID);
     glDeleteVertexArrays(1, &m_VAOID);
     glDeleteVertexArrays(1, &m_PolygonVAOID);
@@ -175,48 +210,67 @@ void Renderer2D::drawParticles(
         const float* massArray,
         const glm::vec3* colorArray,
         float massScale) {
+    if(!count) {
+        return;
+    }
+
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_InstanceVBOID);
+
+    if(count > m_nInstanceCapacity) {
+        // Croissance géométrique pour ne pas réallouer à chaque particule ajoutée
+        m_nInstanceCapacity = std::max(count, 2 * m_nInstanceCapacity);
+        glBufferData(GL_ARRAY_BUFFER, m_nInstanceCapacity * sizeof(ParticleInstance), nullptr, GL_STREAM_DRAW);
+    }
+
+    // L'invalidation laisse le driver fournir une zone libre au lieu d'attendre la fin du dessin de la frame précédente
+    ParticleInstance* instances = (ParticleInstance*) glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(ParticleInstance),
+                                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    for(uint32_t i = 0; i < count; ++i) {
+        instances[i].position = positionArray[i];
+        instances[i].scale = massScale * massArray[i];
+        instances[i].color = colorArray[i];
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+
     // Active la gestion de la transparence
-    glEnable(GL_BLEND);
+    Graphics::GLState::global().enable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    glDisable(GL_DEPTH_TEST);
+    Graphics::GLState::global().disable(GL_DEPTH_TEST);
 
-    glUseProgram(m_ProgramID);
+    Graphics::GLState::global().useProgram(m_ProgramID);
 
-    glBindVertexArray(m_VAOID);
+    Graphics::GLState::global().bindVertexArray(m_VAOID);
 
-    // Dessine chacune des particules
-    for(uint32_t i = 0; i < count; ++i) {
-        glUniform3fv(m_uParticleColor, 1, glm::value_ptr(colorArray[i]));
-        glUniform2fv(m_uParticlePosition, 1, glm::value_ptr(positionArray[i]));
-        glUniform1f(m_uParticleScale, massScale * massArray[i]);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    }
+    // Dessine toutes les particules
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count);
 
-    glBindVertexArray(0);
+    Graphics::GLState::global().bindVertexArray(0);
 
-    glDisable(GL_BLEND);
+    Graphics::GLState::global().disable(GL_BLEND);
 }
 
 void Renderer2D::drawPolygon(uint32_t count,
                  const glm::vec2* position,
                  const glm::vec3& color,
                  float lineWidth) {
-    glBindBuffer(GL_ARRAY_BUFFER, m_PolygonVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_PolygonVBOID);
     glBufferData(GL_ARRAY_BUFFER, count * sizeof(position[0]), position, GL_DYNAMIC_DRAW);
 
-    glDisable(GL_DEPTH_TEST);
+    Graphics::GLState::global().disable(GL_DEPTH_TEST);
 
     glLineWidth(lineWidth);
 
-    glUseProgram(m_PolygonProgramID);
+    Graphics::GLState::global().useProgram(m_PolygonProgramID);
 
-    glBindVertexArray(m_PolygonVAOID);
+    Graphics::GLState::global().bindVertexArray(m_PolygonVAOID);
 
     glUniform3fv(m_uPolygonColor, 1, glm::value_ptr(color));
     glDrawArrays(GL_LINE_LOOP, 0, count);
 
-    glBindVertexArray(0);
+    Graphics::GLState::global().bindVertexArray(0);
 }
 
 void Renderer2D::drawLines(
@@ -226,26 +280,26 @@ void Renderer2D::drawLines(
                            const glm::vec2* positionArray,
                            const glm::vec3* colorArray,
                            float lineWidth) {
-    glBindBuffer(GL_ARRAY_BUFFER, m_LinePositionVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_LinePositionVBOID);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(positionArray[0]), positionArray, GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_LineColorVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_LineColorVBOID);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(colorArray[0]), colorArray, GL_DYNAMIC_DRAW);
 
-    glDisable(GL_DEPTH_TEST);
+    Graphics::GLState::global().disable(GL_DEPTH_TEST);
 
     glLineWidth(lineWidth);
 
-    glUseProgram(m_LineProgramID);
+    Graphics::GLState::global().useProgram(m_LineProgramID);
 
-    glBindVertexArray(m_LineVAOID);
+    Graphics::GLState::global().bindVertexArray(m_LineVAOID);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_LineIBOID);
+    Graphics::GLState::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_LineIBOID);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, lineCount * sizeof(lines[0]), lines, GL_DYNAMIC_DRAW);
 
     glDrawElements(GL_LINES, lineCount * 2, GL_UNSIGNED_INT, 0);
 
-    glBindVertexArray(0);
+    Graphics::GLState::global().bindVertexArray(0);
 }
 
 }
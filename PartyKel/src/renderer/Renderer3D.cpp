@@ -1,25 +1,54 @@
 #include "PartyKel/renderer/Renderer3D.hpp"
 #include "PartyKel/renderer/GLtools.hpp"
+#include "graphics/GLState.hpp"
 #include "PartyKel/renderer/Sphere.hpp"
 
+#include <algorithm>
+
 namespace PartyKel {
 
+// Emplacements des attributs par instance, communs aux deux programmes
+static const GLuint PARTICLE_POSITION_ATTRIB = 2;
+static const GLuint PARTICLE_MASS_ATTRIB = 3;
+static const GLuint PARTICLE_COLOR_ATTRIB = 4;
+
+// Discrétisations (latitude, longitude) des sphères de chaque niveau de détail
+static const GLsizei LOD_DISCRETIZATIONS[Renderer3D::LOD_COUNT][2] = {
+    { 64, 32 }, { 32, 16 }, { 16, 8 }, { 8, 4 }
+};
+
+// Rayon projeté (en fraction de la demi hauteur de l'écran) en dessous duquel on passe au niveau suivant
+static const float LOD_THRESHOLDS[Renderer3D::LOD_COUNT - 1] = {
+    0.1f, 0.025f, 0.006f
+};
+
 const GLchar* Renderer3D::SPHERE_VERTEX_SHADER =
 "#version 330 core\n"
 GL_STRINGIFY(
     layout(location = 0) in vec3 aVertexPosition;
     layout(location = 1) in vec3 aVertexNormal;
 
-    uniform mat4 uMVPMatrix;
-    uniform mat4 uMVMatrix;
+    // Attributs par particule
+    layout(location = 2) in vec3 aParticlePosition;
+    layout(location = 3) in float aParticleMass;
+    layout(location = 4) in vec3 aParticleColor;
+
+    uniform mat4 uProjMatrix;
+    uniform mat4 uViewMatrix;
+    uniform float uMassScale;
 
     out vec3 vFragPositionViewSpace;
     out vec3 vFragNormalViewSpace;
+    flat out vec3 vParticleColor;
 
     void main() {
-        vFragPositionViewSpace = vec3(uMVMatrix * vec4(aVertexPosition, 1));
-        vFragNormalViewSpace = vec3(uMVMatrix * vec4(aVertexNormal, 0));
-        gl_Position = uMVPMatrix * vec4(aVertexPosition, 1);
+        vec3 position = aParticlePosition + uMassScale * aParticleMass * aVertexPosition;
+        vec4 positionViewSpace = uViewMatrix * vec4(position, 1);
+
+        vFragPositionViewSpace = vec3(positionViewSpace);
+        vFragNormalViewSpace = vec3(uViewMatrix * vec4(aVertexNormal, 0));
+        vParticleColor = aParticleColor;
+        gl_Position = uProjMatrix * positionViewSpace;
     }
 );
 
@@ -28,78 +57,364 @@ const GLchar* Renderer3D::SPHERE_FRAGMENT_SHADER =
 GL_STRINGIFY(
     in vec3 vFragPositionViewSpace;
     in vec3 vFragNormalViewSpace;
+    flat in vec3 vParticleColor;
+
+    out vec3 fFragColor;
+
+    void main() {
+        fFragColor = vParticleColor * vec3(abs(dot(normalize(vFragPositionViewSpace), normalize(vFragNormalViewSpace))));
+    }
+);
+
+const GLchar* Renderer3D::IMPOSTOR_VERTEX_SHADER =
+"#version 330 core\n"
+GL_STRINGIFY(
+    layout(location = 0) in vec2 aQuadCorner;
+
+    // Attributs par particule
+    layout(location = 2) in vec3 aParticlePosition;
+    layout(location = 3) in float aParticleMass;
+    layout(location = 4) in vec3 aParticleColor;
 
-    uniform vec3 uParticleColor;
+    uniform mat4 uProjMatrix;
+    uniform mat4 uViewMatrix;
+    uniform float uMassScale;
+
+    out vec3 vFragPositionViewSpace;
+    flat out vec3 vSphereCenterViewSpace;
+    flat out float vSphereRadius;
+    flat out vec3 vParticleColor;
+
+    void main() {
+        vec3 center = vec3(uViewMatrix * vec4(aParticlePosition, 1));
+        float radius = uMassScale * aParticleMass;
+
+        // Quad perpendiculaire à la direction caméra -> centre, placé à l'avant de la sphère:
+        // à cette distance la silhouette de la sphère tient dans un carré de demi côté radius
+        vec3 forward = normalize(center);
+        vec3 right = normalize(cross(forward, abs(forward.y) > 0.99 ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+        vec3 up = cross(right, forward);
+        vec3 position = center - radius * forward + radius * (aQuadCorner.x * right + aQuadCorner.y * up);
+
+        vFragPositionViewSpace = position;
+        vSphereCenterViewSpace = center;
+        vSphereRadius = radius;
+        vParticleColor = aParticleColor;
+        gl_Position = uProjMatrix * vec4(position, 1);
+    }
+);
+
+const GLchar* Renderer3D::IMPOSTOR_FRAGMENT_SHADER =
+"#version 330 core\n"
+GL_STRINGIFY(
+    in vec3 vFragPositionViewSpace;
+    flat in vec3 vSphereCenterViewSpace;
+    flat in float vSphereRadius;
+    flat in vec3 vParticleColor;
+
+    uniform mat4 uProjMatrix;
 
     out vec3 fFragColor;
 
     void main() {
-        fFragColor = uParticleColor * vec3(abs(dot(normalize(vFragPositionViewSpace), normalize(vFragNormalViewSpace))));
+        // Intersection du rayon partant de la caméra avec la sphère
+        vec3 rayDirection = normalize(vFragPositionViewSpace);
+        float b = dot(rayDirection, vSphereCenterViewSpace);
+        float c = dot(vSphereCenterViewSpace, vSphereCenterViewSpace) - vSphereRadius * vSphereRadius;
+        float delta = b * b - c;
+        if(delta < 0.0) {
+            discard;
+        }
+
+        vec3 hit = (b - sqrt(delta)) * rayDirection;
+        vec3 normal = (hit - vSphereCenterViewSpace) / vSphereRadius;
+
+        // Profondeur du point de la sphère et non du quad, pour que les particules s'intersectent correctement
+        vec4 hitClipSpace = uProjMatrix * vec4(hit, 1);
+        gl_FragDepth = 0.5 * (hitClipSpace.z / hitClipSpace.w) + 0.5;
+
+        fFragColor = vParticleColor * vec3(abs(dot(rayDirection, normal)));
     }
 );
 
 Renderer3D::Renderer3D():
-    m_SphereProgramID(buildProgram(SPHERE_VERTEX_SHADER, SPHERE_FRAGMENT_SHADER)) {
+    m_ParticleMode(PARTICLE_MESH),
+    m_MassScale(0.05f),
+    m_SphereProgramID(startProgram(SPHERE_VERTEX_SHADER, SPHERE_FRAGMENT_SHADER)),
+    m_ImpostorProgramID(startProgram(IMPOSTOR_VERTEX_SHADER, IMPOSTOR_FRAGMENT_SHADER)),
+    m_PositionInstanceVBO(Graphics::INSTANCE_BUFFER, PARTICLE_POSITION_ATTRIB, true, Graphics::STREAM_USAGE),
+    m_MassInstanceVBO(Graphics::INSTANCE_FLOAT_BUFFER, PARTICLE_MASS_ATTRIB, true, Graphics::STREAM_USAGE),
+    m_ColorInstanceVBO(Graphics::INSTANCE_BUFFER, PARTICLE_COLOR_ATTRIB, true, Graphics::STREAM_USAGE) {
+    // Les deux programmes se compilent en même temps, on n'attend qu'ici
+    m_SphereProgramID = finishProgram(m_SphereProgramID);
+    m_ImpostorProgramID = finishProgram(m_ImpostorProgramID);
+
+    for(uint32_t lod = 0; lod < LOD_COUNT; ++lod) {
+        m_InstanceDraws[lod].renderer = this;
+        m_InstanceDraws[lod].firstInstance = 0;
+    }
+
     // Récuperation des uniforms
-    m_uParticleColor = glGetUniformLocation(m_SphereProgramID, "uParticleColor");
-    m_uMVPMatrix = glGetUniformLocation(m_SphereProgramID, "uMVPMatrix");
-    m_uMVMatrix = glGetUniformLocation(m_SphereProgramID, "uMVMatrix");
+    m_uProjMatrix = glGetUniformLocation(m_SphereProgramID, "uProjMatrix");
+    m_uViewMatrix = glGetUniformLocation(m_SphereProgramID, "uViewMatrix");
+    m_uMassScale = glGetUniformLocation(m_SphereProgramID, "uMassScale");
 
-    // Création du VBO
-    glGenBuffers(1, &m_SphereVBOID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_SphereVBOID);
+    m_uImpostorProjMatrix = glGetUniformLocation(m_ImpostorProgramID, "uProjMatrix");
+    m_uImpostorViewMatrix = glGetUniformLocation(m_ImpostorProgramID, "uViewMatrix");
+    m_uImpostorMassScale = glGetUniformLocation(m_ImpostorProgramID, "uMassScale");
+
+    // Sphères indexées de chaque niveau de détail, mises bout à bout dans un même VBO et un même IBO
+    std::vector<Sphere::Vertex> vertices;
+    std::vector<GLuint> indices;
+
+    for(uint32_t lod = 0; lod < LOD_COUNT; ++lod) {
+        Sphere sphere(1.f, LOD_DISCRETIZATIONS[lod][0], LOD_DISCRETIZATIONS[lod][1]);
 
-    Sphere sphere(1.f, 64, 32);
-    m_nSphereVertexCount = sphere.getVertexCount();
+        m_LodBaseVertex[lod] = vertices.size();
+        m_LodFirstIndex[lod] = indices.size();
+        m_LodIndexCount[lod] = sphere.getIndices().size();
 
-    glBufferData(GL_ARRAY_BUFFER, m_nSphereVertexCount * sizeof(Sphere::Vertex), sphere.getDataPointer(), GL_STATIC_DRAW);
+        vertices.insert(end(vertices), begin(sphere.getUniqueVertices()), end(sphere.getUniqueVertices()));
+        indices.insert(end(indices), begin(sphere.getIndices()), end(sphere.getIndices()));
+    }
+
+    // Création des buffers
+    glGenBuffers(1, &m_SphereVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_SphereVBOID);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Sphere::Vertex), vertices.data(), GL_STATIC_DRAW);
 
     // Création du VAO
     glGenVertexArrays(1, &m_SphereVAOID);
-    glBindVertexArray(m_SphereVAOID);
+    Graphics::GLState::global().bindVertexArray(m_SphereVAOID);
+
+    glGenBuffers(1, &m_SphereIBOID);
+    Graphics::GLState::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SphereIBOID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Sphere::Vertex), (const GLvoid*) offsetof(Sphere::Vertex, position));
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Sphere::Vertex), (const GLvoid*) offsetof(Sphere::Vertex, normal));
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Attributs par instance, avec un diviseur de 1
+    m_PositionInstanceVBO.init();
+    m_MassInstanceVBO.init();
+    m_ColorInstanceVBO.init();
+
+    Graphics::GLState::global().bindVertexArray(0);
+
+    // Quad des imposteurs, dessiné en GL_TRIANGLE_STRIP
+    GLfloat corners[] = {
+        -1.f, -1.f,
+         1.f, -1.f,
+        -1.f,  1.f,
+         1.f,  1.f
+    };
+
+    glGenBuffers(1, &m_ImpostorVBOID);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, m_ImpostorVBOID);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &m_ImpostorVAOID);
+    Graphics::GLState::global().bindVertexArray(m_ImpostorVAOID);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    m_PositionInstanceVBO.init();
+    m_MassInstanceVBO.init();
+    m_ColorInstanceVBO.init();
+
+    Graphics::GLState::global().bindVertexArray(0);
+
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+    Graphics::GLState::global().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 Renderer3D::~Renderer3D() {
+    // Les noms peuvent être réutilisés par les prochains objets créés
+    Graphics::GLState& state = Graphics::GLState::global();
+    state.forgetProgram(m_SphereProgramID);
+    state.forgetProgram(m_ImpostorProgramID);
+    state.forgetBuffer(m_SphereVBOID);
+    state.forgetBuffer(m_SphereIBOID);
+    state.forgetBuffer(m_ImpostorVBOID);
+    state.forgetVertexArray(m_SphereVAOID);
+    state.forgetVertexArray(m_ImpostorVAOID);
+
     glDeleteProgram(m_SphereProgramID);
+    glDeleteProgram(m_ImpostorProgramID);
 
     glDeleteBuffers(1, &m_SphereVBOID);
+    glDeleteBuffers(1, &m_SphereIBOID);
+    glDeleteBuffers(1, &m_ImpostorVBOID);
     glDeleteVertexArrays(1, &m_SphereVAOID);
+    glDeleteVertexArrays(1, &m_ImpostorVAOID);
 }
  
 void Renderer3D::clear() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
-void Renderer3D::drawParticles(uint32_t count,
-                   const glm::vec3* positionArray,
-                   const float* massArray,
-                   const glm::vec3* colorArray,
-                   float massScale) {
-    glUseProgram(m_SphereProgramID);
+void Renderer3D::submitParticles(Graphics::RenderQueue& queue,
+                                 uint32_t count,
+                                 const glm::vec3* positionArray,
+                                 const float* massArray,
+                                 const glm::vec3* colorArray,
+                                 float massScale) {
+    if(!count) {
+        return;
+    }
+
+    m_MassScale = massScale;
+
+    if(m_ParticleMode == PARTICLE_IMPOSTOR) {
+        uploadInstances(count, positionArray, massArray, colorArray);
+        submitImpostors(queue, count);
+    } else {
+        submitMeshes(queue, count, positionArray, massArray, colorArray);
+    }
+}
+
+void Renderer3D::uploadInstances(uint32_t count,
+                                 const glm::vec3* positionArray,
+                                 const float* massArray,
+                                 const glm::vec3* colorArray) {
+    m_PositionInstanceVBO.updateData(positionArray, count);
+    m_MassInstanceVBO.updateData(massArray, count);
+    m_ColorInstanceVBO.updateData(colorArray, count);
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer3D::setInstanceOffset(uint32_t firstInstance) {
+    // Les buffers d'instances sont écrits dans le StreamingBuffer: leur position y change à chaque frame
+    m_PositionInstanceVBO.bind();
+    glVertexAttribPointer(PARTICLE_POSITION_ATTRIB, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                          (const GLvoid*) (m_PositionInstanceVBO.offset() + firstInstance * sizeof(glm::vec3)));
+    m_MassInstanceVBO.bind();
+    glVertexAttribPointer(PARTICLE_MASS_ATTRIB, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                          (const GLvoid*) (m_MassInstanceVBO.offset() + firstInstance * sizeof(float)));
+    m_ColorInstanceVBO.bind();
+    glVertexAttribPointer(PARTICLE_COLOR_ATTRIB, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                          (const GLvoid*) (m_ColorInstanceVBO.offset() + firstInstance * sizeof(glm::vec3)));
+    Graphics::GLState::global().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer3D::submitImpostors(Graphics::RenderQueue& queue, uint32_t count) {
+    Graphics::RenderPacket packet;
+    packet.key = Graphics::RenderQueue::makeKey(Graphics::RENDER_PASS_OPAQUE, m_ImpostorProgramID, Graphics::RENDER_DEPTH_TEST, 0, 0.f);
+    packet.program = m_ImpostorProgramID;
+    packet.vertexArray = m_ImpostorVAOID;
+    packet.primitive = GL_TRIANGLE_STRIP;
+    packet.count = 4;
+    packet.instanceCount = count;
+    packet.setup = &Renderer3D::setupImpostors;
+    packet.setupData = &m_InstanceDraws[0];
+    queue.submit(packet);
+}
+
+void Renderer3D::setupImpostors(void* draw) {
+    const InstanceDraw& instanceDraw = *static_cast<InstanceDraw*>(draw);
+    Renderer3D& self = *instanceDraw.renderer;
 
-    glBindVertexArray(m_SphereVAOID);
+    glUniformMatrix4fv(self.m_uImpostorProjMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ProjMatrix));
+    glUniformMatrix4fv(self.m_uImpostorViewMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ViewMatrix));
+    glUniform1f(self.m_uImpostorMassScale, self.m_MassScale);
 
-    glEnable(GL_DEPTH_TEST);
+    self.setInstanceOffset(instanceDraw.firstInstance);
+}
+
+void Renderer3D::submitMeshes(Graphics::RenderQueue& queue,
+                              uint32_t count,
+                              const glm::vec3* positionArray,
+                              const float* massArray,
+                              const glm::vec3* colorArray) {
+    // Choix du niveau de détail de chaque particule d'après son rayon projeté.
+    // Les particules entièrement derrière la caméra reçoivent le niveau LOD_COUNT et ne sont pas dessinées.
+    glm::vec3 viewZ(m_ViewMatrix[0][2], m_ViewMatrix[1][2], m_ViewMatrix[2][2]);
+    float viewZOffset = m_ViewMatrix[3][2];
+    float projectionScale = m_ProjMatrix[1][1];
+
+    uint32_t lodCounts[LOD_COUNT + 1] = { 0 };
+    m_ParticleLods.resize(count);
 
-    // Dessine chacune des particules
     for(uint32_t i = 0; i < count; ++i) {
-        auto modelMatrix = glm::scale(glm::translate(glm::mat4(1.f), positionArray[i]), glm::vec3(massScale * massArray[i]));
-        glUniformMatrix4fv(m_uMVPMatrix, 1, GL_FALSE, glm::value_ptr(m_ProjMatrix * m_ViewMatrix * modelMatrix));
-        glUniformMatrix4fv(m_uMVMatrix, 1, GL_FALSE, glm::value_ptr(m_ViewMatrix * modelMatrix));
+        float radius = m_MassScale * massArray[i];
+        float depth = -(glm::dot(viewZ, positionArray[i]) + viewZOffset);
+
+        uint8_t lod = LOD_COUNT;
+        if(depth + radius > 0.f) {
+            float projectedRadius = radius * projectionScale / std::max(depth, radius);
+            lod = 0;
+            while(lod < LOD_COUNT - 1 && projectedRadius < LOD_THRESHOLDS[lod]) {
+                ++lod;
+            }
+        }
+
+        m_ParticleLods[i] = lod;
+        ++lodCounts[lod];
+    }
 
-        glUniform3fv(m_uParticleColor, 1, glm::value_ptr(colorArray[i]));
-        glDrawArrays(GL_TRIANGLES, 0, m_nSphereVertexCount);
+    // Tri par dénombrement: les particules de chaque niveau deviennent contiguës dans les buffers d'instances
+    uint32_t lodOffsets[LOD_COUNT + 1];
+    lodOffsets[0] = 0;
+    for(uint32_t lod = 1; lod <= LOD_COUNT; ++lod) {
+        lodOffsets[lod] = lodOffsets[lod - 1] + lodCounts[lod - 1];
+    }
+
+    m_SortedPositions.resize(count);
+    m_SortedMasses.resize(count);
+    m_SortedColors.resize(count);
+
+    uint32_t nextSlot[LOD_COUNT + 1];
+    std::copy(lodOffsets, lodOffsets + LOD_COUNT + 1, nextSlot);
+
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t slot = nextSlot[m_ParticleLods[i]]++;
+        m_SortedPositions[slot] = positionArray[i];
+        m_SortedMasses[slot] = massArray[i];
+        m_SortedColors[slot] = colorArray[i];
     }
 
-    glBindVertexArray(0);
+    uint32_t visibleCount = lodOffsets[LOD_COUNT];
+    if(!visibleCount) {
+        return;
+    }
+
+    uploadInstances(visibleCount, m_SortedPositions.data(), m_SortedMasses.data(), m_SortedColors.data());
+
+    // Un appel instancié par niveau de détail, les niveaux se distinguent par le matériau de la clé
+    for(uint32_t lod = 0; lod < LOD_COUNT; ++lod) {
+        if(!lodCounts[lod]) {
+            continue;
+        }
+
+        m_InstanceDraws[lod].firstInstance = lodOffsets[lod];
+
+        Graphics::RenderPacket packet;
+        packet.key = Graphics::RenderQueue::makeKey(Graphics::RENDER_PASS_OPAQUE, m_SphereProgramID, Graphics::RENDER_DEPTH_TEST, lod, 0.f);
+        packet.program = m_SphereProgramID;
+        packet.vertexArray = m_SphereVAOID;
+        packet.indexType = GL_UNSIGNED_INT;
+        packet.first = m_LodFirstIndex[lod] * sizeof(GLuint);
+        packet.count = m_LodIndexCount[lod];
+        packet.instanceCount = lodCounts[lod];
+        packet.baseVertex = m_LodBaseVertex[lod];
+        packet.setup = &Renderer3D::setupMeshes;
+        packet.setupData = &m_InstanceDraws[lod];
+        queue.submit(packet);
+    }
+}
+
+void Renderer3D::setupMeshes(void* draw) {
+    const InstanceDraw& instanceDraw = *static_cast<InstanceDraw*>(draw);
+    Renderer3D& self = *instanceDraw.renderer;
+
+    glUniformMatrix4fv(self.m_uProjMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ProjMatrix));
+    glUniformMatrix4fv(self.m_uViewMatrix, 1, GL_FALSE, glm::value_ptr(self.m_ViewMatrix));
+    glUniform1f(self.m_uMassScale, self.m_MassScale);
+
+    self.setInstanceOffset(instanceDraw.firstInstance);
 }
 
 }
@@ -56,14 +56,18 @@ void Sphere::build(GLfloat r, GLsizei discLat, GLsizei discLong) {
     for(GLsizei j = 0; j < discLong; ++j) {
         GLsizei offset = j * (discLat + 1);
         for(GLsizei i = 0; i < discLat; ++i) {
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + (i + 1)]);
-            m_Vertices.push_back(data[offset + discLat + 1 + (i + 1)]);
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + discLat + 1 + (i + 1)]);
-            m_Vertices.push_back(data[offset + i + discLat + 1]);
+            GLuint triangles[] = {
+                GLuint(offset + i), GLuint(offset + (i + 1)), GLuint(offset + discLat + 1 + (i + 1)),
+                GLuint(offset + i), GLuint(offset + discLat + 1 + (i + 1)), GLuint(offset + i + discLat + 1)
+            };
+            for(GLuint index: triangles) {
+                m_Vertices.push_back(data[index]);
+                m_Indices.push_back(index);
+            }
         }
     }
+
+    m_UniqueVertices.swap(data);
 }
 
 }
@@ -0,0 +1,14 @@
+#version 410 core
+
+#define FRAG_COLOR	0
+
+precision highp int;
+
+layout(location = FRAG_COLOR) out vec4 FragColor;
+
+in vec3 Color;
+
+void main()
+{
+	FragColor = vec4(Color, 1);
+}
@@ -0,0 +1,24 @@
+#version 410 core
+
+#define POSITION	0
+#define BOX_CENTER	1
+#define BOX_EXTENT	2
+#define BOX_COLOR	3
+
+precision highp float;
+precision highp int;
+
+layout(location = POSITION) in vec3 Position;
+layout(location = BOX_CENTER) in vec3 BoxCenter;
+layout(location = BOX_EXTENT) in vec3 BoxExtent;
+layout(location = BOX_COLOR) in vec3 BoxColor;
+
+out vec3 Color;
+
+uniform mat4 MVP;
+
+void main()
+{
+	Color = BoxColor;
+	gl_Position = MVP * vec4(BoxCenter + BoxExtent * Position, 1);
+}
@@ -9,17 +9,37 @@
 
 precision highp int;
 
-uniform sampler2D Diffuse;
-uniform sampler2D Specular;
-uniform sampler2D NormalMap;
-uniform int IsNormalMapActive;
+// Features are #defined by ShaderPermutations (see MainShaderFeature):
+// TEXTURE_ARRAY	the textures of every material are packed in arrays (see MaterialArray), In.Layer selects one
+// NORMAL_MAP		the normal is perturbed by NormalMap
+// SPECULAR_MAP		the specular intensity is read from Specular
+
+#ifdef TEXTURE_ARRAY
+#define SAMPLER sampler2DArray
+#define UV(texcoord) vec3(texcoord, In.Layer)
+#else
+#define SAMPLER sampler2D
+#define UV(texcoord) texcoord
+#endif
+
+uniform SAMPLER Diffuse;
+#ifdef SPECULAR_MAP
+uniform SAMPLER Specular;
+#endif
+#ifdef NORMAL_MAP
+uniform SAMPLER NormalMap;
+#endif
 
 uniform float SpecularPower;
 
-uniform vec3 CamPos;
-
-uniform mat4 MV;
-uniform mat4 MVNormal;
+// Rewritten every frame in a streamed UBO, shared by every variant
+layout(std140) uniform Camera
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 MVNormal;
+	vec3 CamPos;
+};
 
 layout(location = 0) out vec4 Color;
 layout(location = 1) out vec4 Normal;
@@ -30,6 +50,9 @@ in block
 	vec2 TexCoord;
 	vec3 Normal;
 	vec3 Position;
+#ifdef TEXTURE_ARRAY
+	flat int Layer;
+#endif
 } In;
 
 vec3 encodeNormal(vec4 n)
@@ -41,6 +64,7 @@ vec3 encodeNormal(vec4 n)
     return vec3(enc, 0);
 }
 
+#ifdef NORMAL_MAP
 // http://www.thetenthplanet.de/archives/1180
 mat3 cotangent_frame(vec3 N, vec3 p, vec2 uv)
 {
@@ -65,29 +89,30 @@ vec3 perturb_normal( vec3 N, vec3 V, vec2 texcoord )
 {
     // N, la normale interpolée et
     // V, le vecteur vue (vertex dirigé vers l'œil)
-    vec3 map = texture(NormalMap, texcoord ).xyz;
-    map = map * 255./127. - 128./127.;
+    // z est reconstruit : les normal maps compressées en BC5 ne gardent que x et y
+    vec3 map;
+    map.xy = texture(NormalMap, UV(texcoord)).xy * 255./127. - 128./127.;
+    map.z = sqrt(max(0., 1. - dot(map.xy, map.xy)));
     mat3 TBN = cotangent_frame(N, -V, texcoord);
     return normalize(TBN * map);
 }
+#endif
 
 void main()
 {
-	vec3 diffuse = texture(Diffuse, In.TexCoord).rgb;
-	// vec3 specular = texture(Specular, In.TexCoord).rgb;
-
-	// //compute normal map
-	// vec3 normalMap = texture(NormalMap, In.TexCoord).rgb;
-	// vec3 normal = In.Normal;
-	// normal = normalize(normal);
- //    vec3 v = normalize(CamPos - In.Position);
- //    if(IsNormalMapActive == 1)
- //         normal = perturb_normal(normal, v, In.TexCoord);
-
-	// vec4 normalFinal = transpose(inverse(MV)) * vec4(normal, 0);
-	// Normal = vec4(encodeNormal(normalFinal), SpecularPower/100);
-    Color = vec4(diffuse, 1.0);
-    // Color = vec4(1,0,0, 1.0);
-    // Color = vec4(0,0,1,1);
-    Position = MV * vec4(In.Position, 1);
+	vec3 diffuse = texture(Diffuse, UV(In.TexCoord)).rgb;
+
+	float specular = SpecularPower / 100.;
+#ifdef SPECULAR_MAP
+	specular *= texture(Specular, UV(In.TexCoord)).r;
+#endif
+
+	vec3 normal = normalize(In.Normal);
+#ifdef NORMAL_MAP
+	normal = perturb_normal(normal, CamPos - In.Position, In.TexCoord);
+#endif
+
+	Color = vec4(diffuse, 1.0);
+	Normal = vec4(encodeNormal(MVNormal * vec4(normal, 0)), specular);
+	Position = MV * vec4(In.Position, 1);
 }
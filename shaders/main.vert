@@ -4,34 +4,82 @@
 #define NORMAL		       1
 #define TEXCOORD	       2
 #define INSTANCE_TRANSFORM 3
+#define INSTANCE_LAYER     7
 #define FRAG_COLOR	       0
 
 precision highp float;
 precision highp int;
 
+// Features are #defined by ShaderPermutations (see MainShaderFeature):
+// PACKED_VERTEX	COMPACT_VERTEX and PACKED_VERTEX buffers: half floats are converted by the vertex fetch,
+//					the normal comes as an octahedral encoded snorm pair
+// INSTANCED		the instance matrix of a MeshInstance places the mesh
+// TEXTURE_ARRAY	the instance layer selects the material in the texture arrays of main.frag
+
 layout(location = POSITION) in vec3 Position;
+#ifdef PACKED_VERTEX
+layout(location = NORMAL) in vec2 Normal;
+#else
 layout(location = NORMAL) in vec3 Normal;
+#endif
 layout(location = TEXCOORD) in vec2 TexCoord;
+#ifdef INSTANCED
 layout(location = INSTANCE_TRANSFORM) in mat4 InstanceTransform;
+#endif
+#ifdef TEXTURE_ARRAY
+layout(location = INSTANCE_LAYER) in float InstanceLayer;
+#endif
 
 out block
 {
 	vec2 TexCoord;
 	vec3 Normal;
 	vec3 Position;
+#ifdef TEXTURE_ARRAY
+	flat int Layer;
+#endif
 } Out;
 
-// If there is geometry shader, comment this
-uniform mat4 MVP;
-uniform mat4 MV;
+// Rewritten every frame in a streamed UBO, shared by every variant
+layout(std140) uniform Camera
+{
+	mat4 MVP;
+	mat4 MV;
+	mat4 MVNormal;
+	vec3 CamPos;
+};
+
+#ifdef PACKED_VERTEX
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+#endif
 
 void main()
-{	
+{
 	Out.TexCoord = TexCoord;
-	Out.Normal = Normal;
-	Out.Position = (vec4(Position,1)).xyz;
+#ifdef PACKED_VERTEX
+	vec3 normal = decodeOctahedral(Normal);
+#else
+	vec3 normal = Normal;
+#endif
+
+#ifdef INSTANCED
+	Out.Normal = mat3(InstanceTransform) * normal;
+	Out.Position = (InstanceTransform * vec4(Position,1)).xyz;
+#else
+	Out.Normal = normal;
+	Out.Position = Position;
+#endif
+
+#ifdef TEXTURE_ARRAY
+	Out.Layer = int(InstanceLayer + 0.5);
+#endif
 
-	// If there is geometry shader, comment this
 	gl_Position = MVP*vec4(Out.Position, 1);
 }
-
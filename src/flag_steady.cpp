@@ -1,26 +1,38 @@
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 
 #include <PartyKel/glm.hpp>
 #include <PartyKel/WindowManager.hpp>
 
 #include <PartyKel/renderer/FlagRenderer3D.hpp>
+#include <PartyKel/GridNormalGenerator.hpp>
+#include <PartyKel/TripleBuffer.hpp>
+#include <PartyKel/CommandQueue.hpp>
+#include <PartyKel/SimulationThread.hpp>
 #include <PartyKel/renderer/TrackballCamera.hpp>
 #include <PartyKel/atb.hpp>
 #include <PartyKel/octree.hpp>
 
 #include "graphics/ShaderProgram.hpp"
-#include "graphics/Scene.h"
+#include "graphics/ShaderPermutations.hpp"
 #include "graphics/Texture.h"
 #include "graphics/TextureHandler.h"
 #include "graphics/VertexDescriptor.h"
 #include "graphics/VertexBufferObject.h"
 #include "graphics/VertexArrayObject.h"
 #include "graphics/Mesh.h"
+#include "graphics/UBO.hpp"
 #include "graphics/UBO_keys.hpp"
 #include "graphics/MeshInstance.h"
 #include "graphics/DebugDrawer.h"
+#include "graphics/BoxBatch.hpp"
+#include "graphics/GLState.hpp"
+#include "graphics/TextureArray.hpp"
+#include "graphics/RenderQueue.hpp"
 
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include <GL/glut.h>
@@ -67,6 +79,25 @@ inline glm::vec3 repulsiveForce(float dist, const glm::vec3& P1, const glm::vec3
 
 
 
+// Paramètres du drapeau réglables depuis l'interface. L'interface modifie une copie, transmise au drapeau
+// entre deux pas de simulation: la simulation peut ainsi tourner sur un autre thread que l'interface.
+struct FlagParameters {
+    glm::vec2 L0;
+    float L1;
+    glm::vec2 L2;
+
+    float K0, K1, K2;
+    float V0, V1, V2;
+
+    float epsilonDistance;
+};
+
+// État du drapeau publié par la simulation pour le rendu
+struct FlagSnapshot {
+    std::vector<glm::vec3> positionArray;
+    std::vector<glm::vec3> normalArray;
+};
+
 // Structure permettant de simuler un drapeau à l'aide un système masse-ressort
 struct Flag {
     int gridWidth, gridHeight; // Dimensions de la grille de points
@@ -79,6 +110,9 @@ struct Flag {
     std::vector<glm::vec3> velocityArray;
     std::vector<float> massArray;
     std::vector<glm::vec3> forceArray;
+    // Normales par sommet, calculées une fois par pas et partagées entre la simulation et le rendu
+    std::vector<glm::vec3> normalArray;
+    GridNormalGenerator normalGenerator;
     Octree<int> octree;
 
     // Paramètres des forces interne de simulation
@@ -102,6 +136,8 @@ struct Flag {
         // massArray(gridWidth * gridHeight, mass / (gridWidth * gridHeight)),
         massArray(gridWidth * gridHeight, 10),
         forceArray(gridWidth * gridHeight, glm::vec3(0.f)), 
+        normalArray(gridWidth * gridHeight, glm::vec3(0.f, 0.f, 1.f)),
+        normalGenerator(gridWidth, gridHeight),
         origin(-0.5f * width, -0.5f * height, 0.f),
         scale(width / (gridWidth - 1), height / (gridHeight - 1), 1.f),
         octree(depth, position, dim),
@@ -134,6 +170,12 @@ struct Flag {
         V1 = 0.005;
         V2 = 0.06;
 
+        computeNormals();
+    }
+
+    // Met à jour normalArray à partir des positions courantes
+    void computeNormals() {
+        normalGenerator.compute(positionArray.data(), normalArray.data());
     }
 
 
@@ -456,6 +498,17 @@ struct Flag {
 
     }
 
+    // Applique le vent W sur chaque point du drapeau SAUF les points fixes: seule sa composante normale au tissu pousse le point.
+    // Les normales sont celles de normalArray, calculées à la fin du pas précédent pour le rendu
+    void applyWindForce(const glm::vec3& W) {
+        for(int j = 0; j < gridHeight; ++j) {
+            for(int i = 1; i < gridWidth; ++i) {
+                int k = i + j * gridWidth;
+                forceArray[k] += glm::dot(normalArray[k], W) * normalArray[k];
+            }
+        }
+    }
+
     // Applique une force externe sur chaque point du drapeau SAUF les points fixes
     void applyExternalForce(const glm::vec3& F) {
     
@@ -481,6 +534,7 @@ struct Flag {
 
             }  
         }
+        computeNormals();
     }
 
     void leapFrog(float dt){
@@ -504,6 +558,36 @@ struct Flag {
             forceArray[s] = glm::vec3(0.f);
         }
 
+        computeNormals();
+
+    }
+
+    FlagParameters getParameters() const {
+        FlagParameters parameters;
+        parameters.L0 = L0;
+        parameters.L1 = L1;
+        parameters.L2 = L2;
+        parameters.K0 = K0;
+        parameters.K1 = K1;
+        parameters.K2 = K2;
+        parameters.V0 = V0;
+        parameters.V1 = V1;
+        parameters.V2 = V2;
+        parameters.epsilonDistance = epsilonDistance;
+        return parameters;
+    }
+
+    void setParameters(const FlagParameters& parameters) {
+        L0 = parameters.L0;
+        L1 = parameters.L1;
+        L2 = parameters.L2;
+        K0 = parameters.K0;
+        K1 = parameters.K1;
+        K2 = parameters.K2;
+        V0 = parameters.V0;
+        V1 = parameters.V1;
+        V2 = parameters.V2;
+        epsilonDistance = parameters.epsilonDistance;
     }
 
     // Remplit l'octree avec toutes nos particules
@@ -545,6 +629,11 @@ int main() {
     float epsilonD = 0.3;
     bool sphereDraw = true; 
     bool octreeDraw = false;
+    // Textures de la sphère lues dans des tableaux de textures, le matériau étant choisi par la couche de l'instance
+    bool textureArrays = false;
+    int sphereMaterial = 0;
+    // La simulation tourne sur son propre thread, une frame en avance sur le rendu (l'octree n'est alors pas affiché)
+    bool pipelinedSimulation = true;
     float radius = 3.f;
     float centerX = -1.5;
     glm::vec3 center = glm::vec3(centerX,-4.0, 0);
@@ -564,131 +653,251 @@ int main() {
     int mouseLastX, mouseLastY;
 
     // SHADER
-    Graphics::ShaderProgram drawProgram("../shaders/debug.vert", "", "../shaders/debug.frag");
-    Graphics::ShaderProgram mainShader("../shaders/main.vert", "", "../shaders/main.frag");
+    Graphics::ShaderProgram boxProgram("../shaders/box.vert", "", "../shaders/box.frag");
+    Graphics::BoxBatch octreeBoxes;
+    // Une variante de main.vert / main.frag par combinaison de fonctionnalités, compilée à la première demande
+    Graphics::ShaderPermutations mainShaders("../shaders/main.vert", "", "../shaders/main.frag", Graphics::mainShaderFeatureNames());
+
+    // Les textures doivent survivre aux meshes qui gardent leurs handles
+    Graphics::TextureHandler texHandler;
 
     //SPHERE
 
     // Create Sphere -------------------------------------------------------------------------------------------------------------------------------
 
-        Graphics::VertexBufferObject sphereVerticesVbo(Graphics::VERTEX_DESCRIPTOR);
-        Graphics::VertexBufferObject sphereIdsVbo(Graphics::ELEMENT_ARRAY_BUFFER);
+        Graphics::VertexBufferObject sphereVerticesVbo(Graphics::COMPACT_VERTEX, 0, true, Graphics::IMMUTABLE_USAGE);
+        Graphics::VertexBufferObject sphereIdsVbo(Graphics::ELEMENT_ARRAY_BUFFER, 0, true, Graphics::IMMUTABLE_USAGE);
+        Graphics::VertexBufferObject sphereInstancesVbo(Graphics::INSTANCE_TRANSFORMATION_BUFFER, 3, true, Graphics::DYNAMIC_USAGE);
+        Graphics::VertexBufferObject sphereLayersVbo(Graphics::INSTANCE_FLOAT_BUFFER, 7, true, Graphics::DYNAMIC_USAGE);
 
         Graphics::VertexArrayObject sphereVAO;
         sphereVAO.addVBO(&sphereVerticesVbo);
         sphereVAO.addVBO(&sphereIdsVbo);
+        sphereVAO.addVBO(&sphereInstancesVbo);
+        sphereVAO.addVBO(&sphereLayersVbo);
         sphereVAO.init();
 
-        Graphics::Mesh sphereMesh(Graphics::Mesh::genSphere(30,30,radius, center));
+        // Centrée sur l'origine: sa matrice d'instance la place
+        Graphics::Mesh sphereMesh(Graphics::Mesh::genSphere(30,30,radius));
 
-        sphereVerticesVbo.updateData(sphereMesh.getVertices());
-        sphereIdsVbo.updateData(sphereMesh.getElementIndex());
+        sphereVerticesVbo.updateData(Graphics::packVertices<Graphics::CompactVertex>(sphereMesh.getVertices()));
+        if(sphereMesh.getIndexType() == GL_UNSIGNED_SHORT)
+            sphereIdsVbo.updateData(sphereMesh.getShortElementIndex());
+        else
+            sphereIdsVbo.updateData(sphereMesh.getElementIndex());
 
         // unbind everything
         Graphics::VertexArrayObject::unbindAll();
         Graphics::VertexBufferObject::unbindAll();
 
+        // Sa boîte englobante sert au test de visibilité: la sphère n'est pas envoyée quand elle sort du champ
+        Graphics::MeshInstance sphereInstance(&sphereMesh);
+        sphereInstance.addInstance(center);
+        std::vector<glm::vec3> visibleSpherePositions;
+        std::vector<glm::vec4> visibleSphereRotations;
+
         // Textures
-            Graphics::TextureHandler texHandler;
+            // Décodées en arrière-plan, envoyées au GPU par morceaux à chaque frame
+            // Compressées au premier lancement, relues ensuite depuis leur cache .ltex
+            Graphics::TextureHandle bricksDiff = texHandler.load("../assets/textures/spnza_bricks_a_diff.tga", Graphics::COMPRESSION_BC1);
+            Graphics::TextureHandle bricksSpec = texHandler.load("../assets/textures/spnza_bricks_a_spec.tga", Graphics::COMPRESSION_BC4, glm::u8vec3(0));
+            Graphics::TextureHandle bricksNormal = texHandler.load("../assets/textures/spnza_bricks_a_normal.tga", Graphics::COMPRESSION_BC5, glm::u8vec3(128, 128, 255));
 
-            std::string TexBricksDiff = "bricks_diff";
-            texHandler.add(Graphics::Texture("../assets/textures/spnza_bricks_a_diff.tga"), TexBricksDiff);
-            std::string TexBricksSpec = "bricks_spec";
-            texHandler.add(Graphics::Texture("../assets/textures/spnza_bricks_a_spec.tga"), TexBricksSpec);
-            std::string TexBricksNormal = "bricks_normal";
-            texHandler.add(Graphics::Texture("../assets/textures/spnza_bricks_a_normal.tga"), TexBricksNormal);
+            sphereMesh.attachTexture(bricksDiff, GL_TEXTURE0);
+            sphereMesh.attachTexture(bricksSpec, GL_TEXTURE1);
+            sphereMesh.attachTexture(bricksNormal, GL_TEXTURE2);
+            sphereMesh.setMaterialFeatures(Graphics::MAIN_NORMAL_MAP | Graphics::MAIN_SPECULAR_MAP);
 
-            sphereMesh.attachTexture(&texHandler[TexBricksDiff], GL_TEXTURE0);
-            sphereMesh.attachTexture(&texHandler[TexBricksSpec], GL_TEXTURE1);
-            sphereMesh.attachTexture(&texHandler[TexBricksNormal], GL_TEXTURE2);
+        // La variante est choisie par le matériau de la sphère, ses sommets sont compactés
+        Graphics::ShaderProgram& mainShader = mainShaders.program(Graphics::MAIN_PACKED_VERTEX | Graphics::MAIN_INSTANCED | sphereMesh.getMaterialFeatures());
 
             // for geometry shading
             mainShader.updateUniform(Graphics::UBO_keys::DIFFUSE, 0);
             mainShader.updateUniform(Graphics::UBO_keys::SPECULAR, 1);
             mainShader.updateUniform(Graphics::UBO_keys::NORMAL_MAP, 2);
+            mainShader.updateUniform(Graphics::UBO_keys::SPECULAR_POWER, 30.f);
+
+        // Même matériau lu dans les tableaux de sphereMaterials, remplis à la première activation de textureArrays
+        Graphics::ShaderProgram& arrayShader = mainShaders.program(Graphics::MAIN_PACKED_VERTEX | Graphics::MAIN_INSTANCED | Graphics::MAIN_TEXTURE_ARRAY
+                                                                   | sphereMesh.getMaterialFeatures());
+        std::unique_ptr<Graphics::MaterialArray> sphereMaterials;
+
+            arrayShader.updateUniform(Graphics::UBO_keys::DIFFUSE, 0);
+            arrayShader.updateUniform(Graphics::UBO_keys::SPECULAR, 1);
+            arrayShader.updateUniform(Graphics::UBO_keys::NORMAL_MAP, 2);
+            arrayShader.updateUniform(Graphics::UBO_keys::SPECULAR_POWER, 30.f);
+
+        // Emplacements résolus une fois pour toutes
+        Graphics::Uniform<glm::mat4> boxMVP = boxProgram.uniform<glm::mat4>(Graphics::UBO_keys::MVP);
+
+        // Bloc Camera de main.vert / main.frag: réécrit à chaque frame dans le buffer de streaming, partagé par toutes les variantes
+        struct CameraBlock{
+            glm::mat4 MVP;
+            glm::mat4 MV;
+            glm::mat4 MVNormal;
+            glm::vec4 camPos;   // vec3 complété à 16 octets, comme en std140
+        };
+        Graphics::UBO cameraUBO(0, sizeof(CameraBlock), true);
+        mainShader.updateBindingPointUBO(Graphics::UBO_keys::STRUCT_BINDING_POINT_CAMERA, cameraUBO.bindingPoint());
+        arrayShader.updateBindingPointUBO(Graphics::UBO_keys::STRUCT_BINDING_POINT_CAMERA, cameraUBO.bindingPoint());
 
         // !/SPHERE
 
+    // Dessins de la frame, triés par programme et matériau avant d'être envoyés
+    Graphics::RenderQueue renderQueue;
+
     // Temps s'écoulant entre chaque frame
     float dt = 0.f;
 
     bool done = false;
     bool wireframe = true;
 
+    // Simulation
+    // Les modifications venant de l'interface sont appliquées au début d'un pas, via la file de commandes
+    CommandQueue simulationCommands;
+
+    FlagSnapshot initialSnapshot = { flag.positionArray, flag.normalArray };
+    TripleBuffer<FlagSnapshot> snapshots(initialSnapshot);
+
+    // L'octree reste rempli entre deux pas pour pouvoir être affiché
+    flag.fillOctree();
+
+    auto simulationStep = [&](float dt) {
+        simulationCommands.execute();
+
+        if(dt > 0.f) {
+            flag.applyExternalForce(GRAVITY); // Applique la gravité
+            flag.applyWindForce(WIND); // Applique un "vent" de direction aléatoire et de force 0.1 Newtons, selon la normale du tissu
+            flag.applyInternalForces(dt); // Applique les forces internes
+            flag.autoCollisions(dt);
+            if(sphereDraw) flag.sphereCollisions(center, radius, dt);
+            flag.emptyOctree(); // clear octree
+            flag.update(dt); // Mise à jour du système à partir des forces appliquées
+            flag.fillOctree(); // update octree with new particles position
+        }
+
+        // Les vecteurs du snapshot gardent leur capacité: pas d'allocation une fois le premier tour des buffers fait
+        FlagSnapshot& snapshot = snapshots.back();
+        snapshot.positionArray = flag.positionArray;
+        snapshot.normalArray = flag.normalArray;
+        snapshots.publish();
+    };
+
+    // Déclaré après tout ce que simulationStep utilise: le thread est arrêté avant leur destruction
+    SimulationThread simulationThread(simulationStep);
+
+    FlagParameters guiParameters = flag.getParameters();
+    FlagParameters appliedParameters = guiParameters;
+
     // GUI
     TwBar* gui = TwNewBar("Parametres");
 
-        atb::addVarRW(gui, ATB_VAR(flag.L0.x), "step=0.01");
-        atb::addVarRW(gui, ATB_VAR(flag.L0.y), "step=0.01");
-        atb::addVarRW(gui, ATB_VAR(flag.L1), "step=0.01");
-        atb::addVarRW(gui, ATB_VAR(flag.L2.x), "step=0.01");
-        atb::addVarRW(gui, ATB_VAR(flag.L2.y), "step=0.01");
-        atb::addVarRW(gui, ATB_VAR(flag.K0), "step=0.1");
-        atb::addVarRW(gui, ATB_VAR(flag.K1), "step=0.1");
-        atb::addVarRW(gui, ATB_VAR(flag.K2), "step=0.1");
-        atb::addVarRW(gui, ATB_VAR(flag.V0), "step=0.1");
-        atb::addVarRW(gui, ATB_VAR(flag.V1), "step=0.1");
-        atb::addVarRW(gui, ATB_VAR(flag.V2), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.L0.x), "step=0.01");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.L0.y), "step=0.01");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.L1), "step=0.01");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.L2.x), "step=0.01");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.L2.y), "step=0.01");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.K0), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.K1), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.K2), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.V0), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.V1), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.V2), "step=0.1");
         atb::addVarRW(gui, ATB_VAR(depth), "step=1");
-        atb::addVarRW(gui, ATB_VAR(flag.epsilonDistance), "step=0.05");
+        atb::addVarRW(gui, ATB_VAR(guiParameters.epsilonDistance), "step=0.05");
+        atb::addVarRW(gui, ATB_VAR(pipelinedSimulation), "");
         atb::addButton(gui, "reset", [&]() {
-            renderer.clear(); 
-            renderer.setViewMatrix(camera.getViewMatrix());
-            // renderer.setProjMatrix(glm::perspective(70.f, float(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 10000.f));
-            renderer.drawGrid(flag.positionArray.data(), wireframe);
-
-            flag.reset();
+            simulationCommands.push([&]() {
+                flag.emptyOctree();
+                flag.reset();
+                flag.fillOctree();
+            });
         });
         atb::addVarRW(gui, ATB_VAR(centerX), "step=0.1");
+        atb::addVarRW(gui, ATB_VAR(textureArrays), "");
+        atb::addVarRW(gui, ATB_VAR(sphereMaterial), "min=0 max=1");
         atb::addButton(gui, "simu1", [&]() {
-            WIND = glm::sphericalRand(0.004f);
-            GRAVITY = glm::vec3(0.00f, -0.005, 0.f);
+            simulationCommands.push([&]() {
+                WIND = glm::sphericalRand(0.004f);
+                GRAVITY = glm::vec3(0.00f, -0.005, 0.f);
+            });
         });
         atb::addButton(gui, "simu2", [&]() {
-            WIND = glm::sphericalRand(0.04f);
+            simulationCommands.push([&]() {
+                WIND = glm::sphericalRand(0.04f);
+            });
         });
         atb::addButton(gui, "simu3", [&]() {
-            WIND = glm::sphericalRand(0.08f);
+            simulationCommands.push([&]() {
+                WIND = glm::sphericalRand(0.08f);
+            });
         });
         atb::addButton(gui, "simu4", [&]() {
-            WIND = glm::sphericalRand(0.05f);
-            GRAVITY = glm::vec3(0.00f, -0.005, 0.f);
+            simulationCommands.push([&]() {
+                WIND = glm::sphericalRand(0.05f);
+                GRAVITY = glm::vec3(0.00f, -0.005, 0.f);
+            });
         });
         atb::addButton(gui, "w/ wind", [&]() {
-            WIND = glm::sphericalRand(0.0f);
+            simulationCommands.push([&]() {
+                WIND = glm::sphericalRand(0.0f);
+            });
         });
         atb::addButton(gui, "w/ gravity", [&]() {
-            GRAVITY = glm::vec3(0.00f, 0.0f, 0.f);
+            simulationCommands.push([&]() {
+                GRAVITY = glm::vec3(0.00f, 0.0f, 0.f);
+            });
         });
         atb::addButton(gui, "left gravity", [&]() {
-            GRAVITY = glm::vec3(-0.05f, 0.0f, 0.f);
+            simulationCommands.push([&]() {
+                GRAVITY = glm::vec3(-0.05f, 0.0f, 0.f);
+            });
         });
         atb::addButton(gui, "down gravity", [&]() {
-            GRAVITY = glm::vec3(0.00f, -0.05f, 0.f);
+            simulationCommands.push([&]() {
+                GRAVITY = glm::vec3(0.00f, -0.05f, 0.f);
+            });
         });
 
+        // Appels d'état GL de la frame précédente, envoyés au driver ou évités par le cache
+        const Graphics::GLState::Counters& glCalls = Graphics::GLState::global().lastFrameCounters();
+        atb::addVarRO(gui, "GL calls issued", glCalls.issued);
+        atb::addVarRO(gui, "GL calls skipped", glCalls.skipped);
+
 
 
     while(!done) {
         wm.startMainLoop();
+        texHandler.update();
+
+        // Lance le pas suivant, qui se calcule pendant qu'on dessine le dernier état complet
+        if(pipelinedSimulation) {
+            simulationThread.requestStep(dt);
+        } else {
+            // Un pas peut encore être en cours si on vient de quitter le mode pipeline
+            simulationThread.wait();
+        }
 
         // Render
+        snapshots.update();
+        const FlagSnapshot& snapshot = snapshots.front();
+
         renderer.clear();
         renderer.setViewMatrix(camera.getViewMatrix());
-        renderer.drawGrid(flag.positionArray.data(), wireframe);
-
-        // update octree with new particles position
-        flag.fillOctree();
+        renderer.submitGrid(renderQueue, snapshot.positionArray.data(), snapshot.normalArray.data(), wireframe);
 
         // Draw Octree
-        if(octreeDraw){     
+        if(octreeDraw && !pipelinedSimulation){     
             glm::mat4 projection = glm::perspective(70.f, float(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 10000.f);
-            drawProgram.updateUniform("MVP", projection * camera.getViewMatrix());
-            flag.octree.draw(drawProgram);
-            flag.octree.drawRecursive(drawProgram);
-            glBindVertexArray(0);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            // Envoyé par glProgramUniform, sans activer le programme.
+            // Il doit cependant être lié: uniform() l'a fait en résolvant l'emplacement
+            boxMVP.set(projection * camera.getViewMatrix());
+
+            // Toutes les cases occupées en un seul appel instancié
+            octreeBoxes.clear();
+            flag.octree.addBoxes(octreeBoxes, glm::vec3(0.6f, 0.f, 0.f));
+            flag.octree.addBoxesRecursive(octreeBoxes, glm::vec3(0.6f, 0.f, 0.f));
+            octreeBoxes.submit(renderQueue, boxProgram);
         }
 
         // Render Sphere
@@ -702,32 +911,87 @@ int main() {
             glm::mat4 vp = proj * camera.getViewMatrix();
             mvp = proj * camera.getViewMatrix();
 
-            mainShader.useProgram();
-            mainShader.updateUniform(Graphics::UBO_keys::MVP, mvp);
-            mainShader.updateUniform(Graphics::UBO_keys::MV, mv);
+            glm::vec3 cameraPosition = glm::vec3(glm::inverse(worldToView * objectToWorld)[3]);
+
+            // Chargés d'un bloc depuis les caches .ltex: le second matériau ne change que la texture diffuse
+            if(textureArrays && !sphereMaterials){
+                try{
+                    sphereMaterials.reset(new Graphics::MaterialArray(1024, 1024, 2, {{GL_TEXTURE0, Graphics::COMPRESSION_BC1},
+                                                                                      {GL_TEXTURE1, Graphics::COMPRESSION_BC4},
+                                                                                      {GL_TEXTURE2, Graphics::COMPRESSION_BC5}}));
+                    sphereMaterials->addMaterial({"../assets/textures/spnza_bricks_a_diff.tga", "../assets/textures/spnza_bricks_a_spec.tga",
+                                                  "../assets/textures/spnza_bricks_a_normal.tga"});
+                    sphereMaterials->addMaterial({"../assets/textures/spnza_bricks_b_diff.tga", "../assets/textures/spnza_bricks_a_spec.tga",
+                                                  "../assets/textures/spnza_bricks_a_normal.tga"});
+                }
+                catch(const std::runtime_error& e){
+                    std::cerr << e.what() << std::endl;
+                    sphereMaterials.reset();
+                    textureArrays = false;
+                }
+            }
 
-            sphereVAO.bind();
-            sphereMesh.bindTextures();
-            glDrawElements(GL_TRIANGLES, sphereMesh.getVertexCount() * 1000, GL_UNSIGNED_INT, (void*)0);
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glBindVertexArray(0); //debind vao
+            Graphics::ShaderProgram& sphereShader = textureArrays ? arrayShader : mainShader;
+
+            // Une copie dans la région de la frame du buffer de streaming, liée sur le point du bloc Camera
+            CameraBlock cameraBlock = { mvp, mv, glm::transpose(glm::inverse(mv)), glm::vec4(cameraPosition, 1.f) };
+            cameraUBO.updateBuffer(&cameraBlock, sizeof(cameraBlock));
+
+            // Le curseur centerX déplace la sphère: seule sa matrice est renvoyée au GPU
+            glm::vec3 spherePosition = sphereInstance.getPosition(0);
+            if(spherePosition.x != centerX){
+                spherePosition.x = centerX;
+                sphereInstance.setPosition(0, spherePosition);
+                simulationCommands.push([&center, spherePosition]() { center = spherePosition; });
+            }
+            sphereInstance.uploadTransformations(sphereInstancesVbo);
+
+            if(sphereInstance.getMaterialLayer(0) != sphereMaterial)
+                sphereInstance.setMaterialLayer(0, glm::clamp(sphereMaterial, 0, 1));
+            sphereInstance.uploadMaterialLayers(sphereLayersVbo);
+
+            visibleSpherePositions.clear();
+            visibleSphereRotations.clear();
+            sphereInstance.cull(Geometry::Frustum(vp), visibleSpherePositions, visibleSphereRotations);
+
+            if(!visibleSpherePositions.empty()){
+                Graphics::RenderPacket spherePacket;
+                spherePacket.program = sphereShader.id();
+                spherePacket.key = Graphics::RenderQueue::makeKey(Graphics::RENDER_PASS_OPAQUE, spherePacket.program, Graphics::RENDER_DEPTH_TEST,
+                                                                  textureArrays ? sphereMaterials->array(0).glId() : sphereMesh.getMaterialFeatures(),
+                                                                  glm::distance(cameraPosition, spherePosition) / 10000.f);
+                spherePacket.vertexArray = sphereVAO.glId();
+                spherePacket.indexType = sphereMesh.getIndexType();
+                spherePacket.count = sphereMesh.getElementIndex().size();
+                spherePacket.instanceCount = sphereInstance.getInstanceNumber();
+                if(textureArrays){
+                    // Une seule liaison par tableau, quel que soit le matériau des instances
+                    spherePacket.setup = [](void* materials) { static_cast<Graphics::MaterialArray*>(materials)->bind(); };
+                    spherePacket.setupData = sphereMaterials.get();
+                }
+                else{
+                    spherePacket.setup = [](void* mesh) { static_cast<Graphics::Mesh*>(mesh)->bindTextures(); };
+                    spherePacket.setupData = &sphereMesh;
+                }
+                renderQueue.submit(spherePacket);
+            }
         }
 
+        Graphics::DebugDrawer::submit(renderQueue);
+        renderQueue.execute();
+        renderer.endFrame();
+
         // -----------------
 
 
         // Simulation
-        if(dt > 0.f) {
-            flag.applyExternalForce(GRAVITY); // Applique la gravité
-            flag.applyExternalForce(WIND); // Applique un "vent" de direction aléatoire et de force 0.1 Newtons
-            flag.applyInternalForces(dt); // Applique les forces internes
-            flag.autoCollisions(dt);
-            if(sphereDraw) flag.sphereCollisions(center, radius, dt);
-            flag.emptyOctree(); // clear octree
-            flag.update(dt); // Mise à jour du système à partir des forces appliquées
+        if(!pipelinedSimulation) {
+            simulationStep(dt);
         }
 
         TwDraw();
+        // AntTweakBar change l'état GL sans passer par le cache
+        Graphics::GLState::global().invalidate();
 
 
         // Gestion des evenements
@@ -774,6 +1038,14 @@ int main() {
         }
 
 
+        // Transmet les paramètres modifiés dans l'interface
+        if(std::memcmp(&guiParameters, &appliedParameters, sizeof(FlagParameters)) != 0) {
+            appliedParameters = guiParameters;
+            simulationCommands.push([&flag, appliedParameters]() {
+                flag.setParameters(appliedParameters);
+            });
+        }
+
         // Mise à jour de la fenêtre
         dt = wm.update();
         // dt = 0.3;
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cmath>
 #include <cstdlib>
 
 #include <PartyKel/glm.hpp>
@@ -7,7 +8,11 @@
 #include <PartyKel/renderer/Renderer3D.hpp>
 #include <PartyKel/renderer/TrackballCamera.hpp>
 
+#include "graphics/RenderQueue.hpp"
+#include "graphics/ThreadPool.hpp"
+
 #include <vector>
+#include <random>
 
 static const Uint32 WINDOW_WIDTH = 1024;
 static const Uint32 WINDOW_HEIGHT = 768;
@@ -20,6 +25,8 @@ class StaticParticleManager {
     std::vector<float> m_MassArray;
     std::vector<glm::vec3> m_ColorArray;
 
+    uint32_t m_nMoveCount = 0;
+
 public:
     void addCircleParticles(float radius, uint32_t count) {
         float delta = 2 * 3.14f / count; // 2pi / nombre de particules
@@ -29,39 +36,72 @@ public:
         }
     }
 
+    // Répartit uniformément count particules dans une boule de rayon radius
+    void addRandomParticles(float radius, uint32_t count, float mass) {
+        m_PositionArray.reserve(m_PositionArray.size() + count);
+        m_MassArray.reserve(m_MassArray.size() + count);
+        m_ColorArray.reserve(m_ColorArray.size() + count);
+
+        for(uint32_t i = 0; i < count; ++i) {
+            glm::vec3 position = glm::ballRand(radius);
+            addParticle(position, mass, 0.5f + 0.5f * position / radius);
+        }
+    }
+
     void addParticle(glm::vec3 position, float mass, glm::vec3 color) {
         m_PositionArray.push_back(position);
         m_MassArray.push_back(mass);
         m_ColorArray.push_back(color);
     }
 
-    void drawParticles(Renderer3D& renderer) {
-        renderer.drawParticles(m_PositionArray.size(),
-                               m_PositionArray.data(),
-                               m_MassArray.data(),
-                               m_ColorArray.data(),
-                               0.05);
+    void submitParticles(Renderer3D& renderer, Graphics::RenderQueue& queue) {
+        renderer.submitParticles(queue,
+                                 m_PositionArray.size(),
+                                 m_PositionArray.data(),
+                                 m_MassArray.data(),
+                                 m_ColorArray.data(),
+                                 0.05);
     }
 
     void move(float maxDist) {
-        // Déplace aléatoirement les particules
-        for(uint32_t i = 0; i < m_PositionArray.size(); ++i) {
-            m_PositionArray[i] += glm::sphericalRand(maxDist);
-        }
+        // Déplace aléatoirement les particules (direction uniforme sur la sphère, comme glm::sphericalRand).
+        // Les blocs sont répartis sur le ThreadPool, chacun avec son propre générateur.
+        uint32_t seed = m_nMoveCount++;
+        Graphics::ThreadPool::global().parallelFor(0, m_PositionArray.size(), 16384, [this, maxDist, seed](int begin, int end) {
+            std::minstd_rand generator(seed * 7919u + begin + 1);
+            std::uniform_real_distribution<float> zDistribution(-1.f, 1.f);
+            std::uniform_real_distribution<float> angleDistribution(0.f, 2.f * glm::pi<float>());
+
+            for(int i = begin; i < end; ++i) {
+                float z = zDistribution(generator);
+                float angle = angleDistribution(generator);
+                float r = std::sqrt(1.f - z * z);
+                m_PositionArray[i] += maxDist * glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+            }
+        });
     }
 };
 
-int main() {
+// Usage: particle_3d [nombre de particules]
+// Sans argument, affiche une particule entourée d'un cercle de 128 particules
+int main(int argc, char** argv) {
     WindowManager wm(WINDOW_WIDTH, WINDOW_HEIGHT, "Newton was a Geek");
     wm.setFramerate(30);
 
     // Création des particules
     StaticParticleManager particleManager;
-    particleManager.addParticle(glm::vec3(0), 1, glm::vec3(1, 1, 1));
-    particleManager.addCircleParticles(0.5f, 128);
+    if(argc > 1) {
+        particleManager.addRandomParticles(1.f, std::strtoul(argv[1], nullptr, 10), 0.1f);
+    } else {
+        particleManager.addParticle(glm::vec3(0), 1, glm::vec3(1, 1, 1));
+        particleManager.addCircleParticles(0.5f, 128);
+    }
 
+    // Les imposteurs coûtent un quad par particule; la touche i bascule sur les sphères à niveaux de détail
     Renderer3D renderer;
+    renderer.setParticleMode(Renderer3D::PARTICLE_IMPOSTOR);
     renderer.setProjMatrix(glm::perspective(70.f, float(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 100.f));
+    Graphics::RenderQueue renderQueue;
 
     TrackballCamera camera;
     int mouseLastX, mouseLastY;
@@ -78,7 +118,8 @@ int main() {
         renderer.clear();
 
         renderer.setViewMatrix(camera.getViewMatrix());
-        particleManager.drawParticles(renderer);
+        particleManager.submitParticles(renderer, renderQueue);
+        renderQueue.execute();
 
         // Simulation
         particleManager.move(dt * 0.01f);
@@ -95,6 +136,9 @@ int main() {
                 case SDL_KEYDOWN:
                     if(e.key.keysym.sym == SDLK_SPACE) {
                         wireframe = !wireframe;
+                    } else if(e.key.keysym.sym == SDLK_i) {
+                        renderer.setParticleMode(renderer.getParticleMode() == Renderer3D::PARTICLE_IMPOSTOR ?
+                                                 Renderer3D::PARTICLE_MESH : Renderer3D::PARTICLE_IMPOSTOR);
                     }
                 case SDL_MOUSEBUTTONDOWN:
                     if(e.button.button == SDL_BUTTON_WHEELUP) {
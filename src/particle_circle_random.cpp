@@ -5,6 +5,7 @@
 #include <PartyKel/WindowManager.hpp>
 #include <PartyKel/renderer/Renderer2D.hpp>
 #include <PartyKel/atb.hpp>
+#include "graphics/GLState.hpp"
 
 #include <vector>
 
@@ -98,6 +99,8 @@ int main() {
         particleManager.move(dt * randomMoveScale);
 
         TwDraw();
+        // AntTweakBar change l'état GL sans passer par le cache
+        Graphics::GLState::global().invalidate();
 
         // Gestion des evenements
         SDL_Event e;